@@ -1,69 +1,134 @@
 #include "Allocator.h"
 #include "VM.h"
+#include <algorithm>
 
 namespace CynicScript
 {
+    // the mark worker the current thread runs as
+    static thread_local size_t tMarkWorkerIndex = 0;
+
     void Allocator::Init()
     {
-        if (mObjectChain)
+        if (mObjectChain || mYoungObjectChain)
             FreeObjects();
 
         mBytesAllocated = 0;
-        mNextGCByteSize = 256;
+        mNextGCByteSize = GC_NURSERY_SIZE;
         mObjectChain = nullptr;
+        mMarkEpoch = 1;
+
+        mYoungBytesAllocated = 0;
+        mYoungObjectChain = nullptr;
+        mRememberedObjects.clear();
+
+        mGCPhase = GCPhase::IDLE;
+        mStepBytesAllocated = 0;
+        mSweepCursor = nullptr;
+
+        mValueStack.assign(STACK_INIT_SIZE, Value());
+        mCallFrameStack.assign(CALL_FRAME_INIT_SIZE, CallFrame());
 
-        mCallFrameTop = mCallFrameStack;
-        mStackTop = mValueStack;
+        mCallFrameTop = mCallFrameStack.data();
+        mStackTop = mValueStack.data();
 
         mOpenUpValues = nullptr;
 
-        memset(mGlobalVariableList, 0, sizeof(Value) * GLOBAL_VARIABLE_MAX);
+        mGlobalVariableList.assign(GLOBAL_VARIABLE_MAX, Value());
     }
 
     void Allocator::Destroy()
     {
+        StopMarkThreads();
         FreeObjects();
+        StopSweepThread();
     }
 
     void Allocator::ResetStackPointer()
     {
-        mStackTop = mValueStack;
+        mStackTop = mValueStack.data();
     }
     void Allocator::ResetCallFramePointer()
     {
-        mCallFrameTop = mCallFrameStack;
+        mCallFrameTop = mCallFrameStack.data();
+    }
+
+    void Allocator::ParkExecutionContext(ExecutionContext *context)
+    {
+        // swapping the vectors keeps their buffers,so frame slots,open upvalues and refs into the parked stack stay valid
+        std::swap(mValueStack, context->valueStack);
+        std::swap(mStackTop, context->stackTop);
+        std::swap(mCallFrameStack, context->callFrameStack);
+        std::swap(mCallFrameTop, context->callFrameTop);
+        std::swap(mOpenUpValues, context->openUpValues);
+
+        if (mValueStack.empty())
+            mValueStack.assign(STACK_INIT_SIZE, Value());
+        if (mCallFrameStack.empty())
+            mCallFrameStack.assign(CALL_FRAME_INIT_SIZE, CallFrame());
+        mStackTop = mValueStack.data();
+        mCallFrameTop = mCallFrameStack.data();
+        mOpenUpValues = nullptr;
+
+        mParkedContexts.emplace_back(context);
+    }
+
+    void Allocator::RestoreExecutionContext(ExecutionContext *context)
+    {
+        auto iter = std::find(mParkedContexts.begin(), mParkedContexts.end(), context);
+        if (iter == mParkedContexts.end())
+            CYS_LOG_ERROR(TEXT("Restore an execution context that is not parked."));
+        if (!IsCallFrameStackEmpty())
+            CYS_LOG_ERROR(TEXT("Restore an execution context while another script is running."));
+        mParkedContexts.erase(iter);
+
+        std::swap(mValueStack, context->valueStack);
+        std::swap(mStackTop, context->stackTop);
+        std::swap(mCallFrameStack, context->callFrameStack);
+        std::swap(mCallFrameTop, context->callFrameTop);
+        std::swap(mOpenUpValues, context->openUpValues);
     }
 
     void Allocator::FreeObjects()
     {
-        auto bytes = mBytesAllocated;
-        Object *object = mObjectChain;
+        if (mIsSweepingConcurrently)
+            FinishConcurrentSweep(true);
+
+        auto bytes = mBytesAllocated + mYoungBytesAllocated;
+        FreeObjectChain(mObjectChain);
+        FreeObjectChain(mYoungObjectChain);
+        mObjectChain = nullptr;
+        mYoungObjectChain = nullptr;
+        mBytesAllocated = 0;
+        mYoungBytesAllocated = 0;
+        mRememberedObjects.clear();
+        mGrayObjects.clear();
+        mGCPhase = GCPhase::IDLE;
+        mSweepCursor = nullptr;
+
+#ifndef NDEBUG
+        if (Config::GetInstance()->IsDebugGC())
+            CYS_LOG_INFO(TEXT("collected {} bytes (from {} to {}) next gc bytes {}"), bytes, bytes, 0, mNextGCByteSize);
+#endif
+    }
+
+    void Allocator::FreeObjectChain(Object *object)
+    {
         while (object != nullptr)
         {
             Object *next = object->next;
-            size_t objBytes = sizeof(*object);
             FreeObject(object);
             object = next;
         }
-
-#ifndef NDEBUG
-        if (Config::GetInstance()->IsDebugGC())
-            CYS_LOG_INFO(TEXT("collected {} bytes (from {} to {}) next gc bytes {}"), bytes - mBytesAllocated, bytes, mNextGCByteSize);
-#endif
     }
 
     void Allocator::PushStack(const Value &value)
     {
-#ifndef NDEBUG
-        if (mStackTop - mValueStack >= STACK_MAX)
-            CYS_LOG_ERROR(TEXT("Stack overflow."));
-#endif
         *(mStackTop++) = value;
     }
     Value Allocator::PopStack()
     {
 #ifndef NDEBUG
-        if (mStackTop - mValueStack <= 0)
+        if (mStackTop - mValueStack.data() <= 0)
             CYS_LOG_ERROR(TEXT("Stack underflow."));
 #endif
         return *(--mStackTop);
@@ -75,6 +140,14 @@ namespace CynicScript
 
     void Allocator::PushCallFrame(const CallFrame &callFrame)
     {
+        if (mCallFrameTop == mCallFrameStack.data() + mCallFrameStack.size())
+        {
+            auto count = CallFrameCount();
+            if (count >= CALL_FRAME_MAX)
+                CYS_LOG_ERROR(TEXT("Stack overflow,call depth exceeds {}."), CALL_FRAME_MAX);
+            mCallFrameStack.resize(std::min<size_t>(count * 2, CALL_FRAME_MAX));
+            mCallFrameTop = mCallFrameStack.data() + count;
+        }
         *(mCallFrameTop++) = callFrame;
     }
 
@@ -90,12 +163,12 @@ namespace CynicScript
 
     bool Allocator::IsCallFrameStackEmpty()
     {
-        return mCallFrameTop == mCallFrameStack;
+        return mCallFrameTop == mCallFrameStack.data();
     }
 
     size_t Allocator::CallFrameCount()
     {
-        return mCallFrameTop - mCallFrameStack;
+        return mCallFrameTop - mCallFrameStack.data();
     }
 
     UpValueObject *Allocator::CaptureUpValue(Value *location)
@@ -130,6 +203,7 @@ namespace CynicScript
             upvalue->closed = *upvalue->location;
             upvalue->location = &upvalue->closed;
             mOpenUpValues = upvalue->nextUpValue;
+            WriteBarrier(upvalue);
         }
     }
 
@@ -145,7 +219,57 @@ namespace CynicScript
 
     Value *Allocator::Stack()
     {
-        return mValueStack;
+        return mValueStack.data();
+    }
+
+    Value *Allocator::StackEnd() const
+    {
+        return const_cast<Value *>(mValueStack.data() + mValueStack.size());
+    }
+
+    Value *Allocator::GrowStack(Value *top, size_t count)
+    {
+        Value *oldBase = mValueStack.data();
+        Value *oldEnd = oldBase + mValueStack.size();
+        size_t used = top - oldBase;
+
+        if (used + count > STACK_MAX)
+            CYS_LOG_ERROR(TEXT("Stack overflow,stack size exceeds {}."), STACK_MAX);
+
+        size_t capacity = mValueStack.size();
+        while (capacity < used + count)
+            capacity *= 2;
+        mValueStack.resize(std::min<size_t>(capacity, STACK_MAX), Value());
+
+        Value *newBase = mValueStack.data();
+        if (newBase == oldBase)
+            return top;
+
+        auto relocate = [=](Value *&pointer)
+        {
+            if (pointer >= oldBase && pointer < oldEnd)
+                pointer = newBase + (pointer - oldBase);
+        };
+
+        for (CallFrame *frame = mCallFrameStack.data(); frame < mCallFrameTop; ++frame)
+            relocate(frame->slots);
+        for (UpValueObject *upvalue = mOpenUpValues; upvalue != nullptr; upvalue = upvalue->nextUpValue)
+            relocate(upvalue->location);
+        // the sweep thread rewrites the links of the old generation
+        if (mIsSweepingConcurrently)
+            FinishConcurrentSweep(true);
+        // refs to locals are rare,walking the object chains only happens when the stack grows
+        for (Object *chain : {mObjectChain, mYoungObjectChain})
+        {
+            for (Object *object = chain; object != nullptr; object = object->next)
+            {
+                if (CYS_IS_REF_OBJ(object))
+                    relocate(CYS_TO_REF_OBJ(object)->pointer);
+            }
+        }
+
+        mStackTop = newBase + (mStackTop - oldBase);
+        return newBase + used;
     }
 
     void Allocator::MoveStackTop(int32_t offset)
@@ -168,6 +292,17 @@ namespace CynicScript
         mGlobalVariableList[idx] = v;
     }
 
+    void Allocator::EnsureGlobalVariableCount(size_t count)
+    {
+        if (count > mGlobalVariableList.size())
+            mGlobalVariableList.resize(count, Value());
+    }
+
+    size_t Allocator::GlobalVariableCount() const
+    {
+        return mGlobalVariableList.size();
+    }
+
     void Allocator::StopGC()
     {
         m_IsStopGC = true;
@@ -185,71 +320,507 @@ namespace CynicScript
         if (Config::GetInstance()->IsDebugGC())
         {
             CYS_LOG_INFO(TEXT("begin gc"));
-            bytes = mBytesAllocated;
+            bytes = mBytesAllocated + mYoungBytesAllocated;
         }
 #endif
 
-        MarkRootObjects();
+        // a sweep in progress belongs to the last collection,the marks it reads are gone once the epoch moves on
+        if (mGCPhase == GCPhase::SWEEP)
+            Sweep();
+        if (mGCPhase == GCPhase::IDLE)
+            BeginMark();
         MarkGrayObjects();
-        Sweep();
-        mNextGCByteSize = mBytesAllocated * GC_HEAP_GROW_FACTOR;
+        FinishMark();
+        if (!mIsSweepingConcurrently)
+            Sweep();
 
 #ifndef NDEBUG
         if (Config::GetInstance()->IsDebugGC())
         {
             CYS_LOG_INFO(TEXT("end gc"));
-            CYS_LOG_INFO(TEXT("    collected {} bytes (from {} to {}) next gc bytes {}"), bytes - mBytesAllocated, bytes, mNextGCByteSize);
+            CYS_LOG_INFO(TEXT("    collected {} bytes (from {} to {}) next gc bytes {}"), bytes - mBytesAllocated, bytes, mBytesAllocated, mNextGCByteSize);
         }
 #endif
     }
 
+    void Allocator::MinorGC()
+    {
+#ifndef NDEBUG
+        size_t bytes = 0;
+        size_t oldBytes = 0;
+        if (Config::GetInstance()->IsDebugGC())
+        {
+            CYS_LOG_INFO(TEXT("begin minor gc"));
+            bytes = mYoungBytesAllocated;
+            oldBytes = mBytesAllocated;
+        }
+#endif
+
+        // old objects still carry the mark epoch,so tracing stops at them and only the live young objects are visited
+        MarkRootObjects();
+        MarkRememberedObjects();
+        MarkGrayObjects();
+        SweepYoung();
+
+#ifndef NDEBUG
+        if (Config::GetInstance()->IsDebugGC())
+        {
+            CYS_LOG_INFO(TEXT("end minor gc"));
+            CYS_LOG_INFO(TEXT("    promoted {} of {} young bytes,old generation {} bytes"), mBytesAllocated - oldBytes, bytes, mBytesAllocated);
+        }
+#endif
+
+        if (mGCPhase == GCPhase::IDLE && mBytesAllocated > mNextGCByteSize)
+        {
+            if (Config::GetInstance()->GetGCPauseBudget() == 0)
+                GC();
+            else
+                BeginMark();
+        }
+    }
+
+    void Allocator::StepGC()
+    {
+        mStepBytesAllocated = 0;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(Config::GetInstance()->GetGCPauseBudget());
+        if (mGCPhase == GCPhase::MARK)
+        {
+            if (!MarkGrayObjects(deadline))
+                return;
+            FinishMark();
+        }
+        if (mGCPhase == GCPhase::SWEEP)
+            Sweep(deadline);
+    }
+
+#ifndef NDEBUG
+    void Allocator::StressGC()
+    {
+        // alternate,so both the remembered set and the full trace get exercised
+        mIsNextStressGCMajor = !mIsNextStressGCMajor;
+        if (!mIsNextStressGCMajor && mGCPhase != GCPhase::MARK)
+            MinorGC();
+        else if (mGCPhase != GCPhase::IDLE)
+            StepGC();
+        else if (Config::GetInstance()->GetGCPauseBudget() == 0)
+            GC();
+        else
+            BeginMark();
+    }
+#endif
+
+    void Allocator::BeginMark()
+    {
+#ifndef NDEBUG
+        if (Config::GetInstance()->IsDebugGC())
+            CYS_LOG_INFO(TEXT("begin gc marking"));
+#endif
+
+        // every object is white again,0 is left for objects no collection has reached yet
+        if (++mMarkEpoch == 0)
+            mMarkEpoch = 1;
+
+        // a full trace reaches every young object an old one points to,the remembered set is not needed
+        for (auto object : mRememberedObjects)
+            object->isRemembered = false;
+        mRememberedObjects.clear();
+
+        MarkRootObjects();
+        mGCPhase = GCPhase::MARK;
+        mStepBytesAllocated = 0;
+    }
+
+    void Allocator::FinishMark()
+    {
+        // the roots and the black objects written to since the marking began are traced again without a break,
+        // nothing reachable is left white afterwards
+        MarkRootObjects();
+        MarkRememberedObjects();
+        MarkGrayObjects();
+        // the young objects reached are promoted,the rest of the nursery is freed
+        SweepYoung();
+
+        mGCPhase = GCPhase::SWEEP;
+        // the sweep thread never writes the gc log
+        bool isConcurrent = Config::GetInstance()->IsGCConcurrentSweep() && mObjectChain != nullptr;
+#ifndef NDEBUG
+        isConcurrent = isConcurrent && !Config::GetInstance()->IsDebugGC();
+#endif
+        if (isConcurrent)
+            BeginConcurrentSweep();
+        else
+            mSweepCursor = &mObjectChain;
+
+#ifndef NDEBUG
+        if (Config::GetInstance()->IsDebugGC())
+            CYS_LOG_INFO(TEXT("end gc marking"));
+#endif
+    }
+
     void Allocator::MarkRootObjects()
     {
-        for (Value *slot = mValueStack; slot < mStackTop; ++slot)
+        for (Value *slot = mValueStack.data(); slot < mStackTop; ++slot)
             slot->Mark();
-        for (CallFrame *slot = mCallFrameStack; slot < mCallFrameTop; ++slot)
+        for (CallFrame *slot = mCallFrameStack.data(); slot < mCallFrameTop; ++slot)
             slot->closure->Mark();
         for (UpValueObject *upvalue = mOpenUpValues; upvalue != nullptr; upvalue = upvalue->nextUpValue)
             upvalue->Mark();
 
-        for (int32_t i = 0; i < GLOBAL_VARIABLE_MAX; ++i)
+        for (auto context : mParkedContexts)
+        {
+            for (Value *slot = context->valueStack.data(); slot < context->stackTop; ++slot)
+                slot->Mark();
+            for (CallFrame *slot = context->callFrameStack.data(); slot < context->callFrameTop; ++slot)
+                slot->closure->Mark();
+            for (UpValueObject *upvalue = context->openUpValues; upvalue != nullptr; upvalue = upvalue->nextUpValue)
+                upvalue->Mark();
+        }
+
+        for (size_t i = 0; i < mGlobalVariableList.size(); ++i)
             if (mGlobalVariableList[i] != Value())
                 mGlobalVariableList[i].Mark();
     }
 
-    void Allocator::MarkGrayObjects()
+    void Allocator::MarkRememberedObjects()
+    {
+        // every young object they point to is promoted below,so they hold no young pointers afterwards
+        for (auto object : mRememberedObjects)
+        {
+            object->isRemembered = false;
+            object->Blacken();
+        }
+        mRememberedObjects.clear();
+    }
+
+    bool Allocator::MarkGrayObjects(std::chrono::steady_clock::time_point deadline)
     {
+        // the gc log is written from the vm thread only
+        bool isParallel = deadline == std::chrono::steady_clock::time_point::max() && mGCPhase == GCPhase::MARK && Config::GetInstance()->GetGCMarkThreadCount() > 1;
+#ifndef NDEBUG
+        isParallel = isParallel && !Config::GetInstance()->IsDebugGC();
+#endif
+        if (isParallel)
+        {
+            MarkGrayObjectsInParallel();
+            return true;
+        }
+
+        // reading the clock costs more than blackening most objects,it is only read every 64 of them
+        size_t count = 0;
         while (mGrayObjects.size() > 0)
         {
+            if ((++count & 63) == 0 && std::chrono::steady_clock::now() >= deadline)
+                return false;
             auto object = mGrayObjects.back();
             mGrayObjects.pop_back();
             object->Blacken();
         }
+        return true;
     }
 
-    void Allocator::Sweep()
+    void Allocator::MarkGrayObjectsInParallel()
     {
-        Object *previous = nullptr;
-        Object *object = mObjectChain;
-        while (object)
+        if (mMarkWorkers.size() != Config::GetInstance()->GetGCMarkThreadCount())
+            StartMarkThreads(Config::GetInstance()->GetGCMarkThreadCount());
+
+        // the vm thread starts with every gray object,the others steal from it
+        mMarkWorkers[0]->grayObjects.swap(mGrayObjects);
+        mIdleMarkWorkers.store(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mMarkThreadMutex);
+            mIsParallelMarking = true;
+            mRunningMarkThreads = mMarkThreads.size();
+            ++mMarkRound;
+        }
+        mMarkThreadWakeUp.notify_all();
+
+        RunMarkWorker(0);
+
+        std::unique_lock<std::mutex> lock(mMarkThreadMutex);
+        while (mRunningMarkThreads > 0)
+            mMarkThreadDone.wait(lock);
+        mIsParallelMarking = false;
+        mMarkWorkers[0]->grayObjects.swap(mGrayObjects);
+    }
+
+    void Allocator::MarkInParallel(Object *object)
+    {
+        std::atomic_ref<uint8_t> marked(object->marked);
+        if (marked.load(std::memory_order_relaxed) != mMarkEpoch && marked.exchange(mMarkEpoch, std::memory_order_relaxed) != mMarkEpoch)
+            mMarkWorkers[tMarkWorkerIndex]->grayObjects.emplace_back(object);
+    }
+
+    void Allocator::RunMarkWorker(size_t index)
+    {
+        tMarkWorkerIndex = index;
+        auto worker = mMarkWorkers[index].get();
+        for (;;)
         {
-            if (object->marked)
+            while (!worker->grayObjects.empty())
             {
-                object->UnMark();
-                previous = object;
-                object = object->next;
+                if (mIdleMarkWorkers.load(std::memory_order_relaxed) > 0 && worker->grayObjects.size() > GC_MARK_SHARE_SIZE && !worker->hasStealableObjects.load(std::memory_order_relaxed))
+                    ShareGrayObjects(worker);
+                auto object = worker->grayObjects.back();
+                worker->grayObjects.pop_back();
+                object->Blacken();
             }
+            if (StealGrayObjects(index))
+                continue;
+
+            // a worker only goes idle with nothing to trace and nothing handed out,so once all of them are idle at
+            // the same time no gray object is left anywhere
+            mIdleMarkWorkers.fetch_add(1, std::memory_order_acq_rel);
+            for (;;)
+            {
+                if (mIdleMarkWorkers.load(std::memory_order_acquire) == mMarkWorkers.size())
+                    return;
+                bool hasStealableObjects = false;
+                for (auto &other : mMarkWorkers)
+                    hasStealableObjects = hasStealableObjects || other->hasStealableObjects.load(std::memory_order_acquire);
+                if (hasStealableObjects)
+                {
+                    mIdleMarkWorkers.fetch_sub(1, std::memory_order_acq_rel);
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void Allocator::ShareGrayObjects(MarkWorker *worker)
+    {
+        // the older half,objects reached early tend to lead to the larger subgraphs
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        auto half = worker->grayObjects.begin() + worker->grayObjects.size() / 2;
+        worker->stealableObjects.assign(worker->grayObjects.begin(), half);
+        worker->grayObjects.erase(worker->grayObjects.begin(), half);
+        worker->hasStealableObjects.store(true, std::memory_order_release);
+    }
+
+    bool Allocator::StealGrayObjects(size_t index)
+    {
+        // what it handed out itself first,then the other workers in turn
+        auto thief = mMarkWorkers[index].get();
+        for (size_t i = 0; i < mMarkWorkers.size(); ++i)
+        {
+            auto victim = mMarkWorkers[(index + i) % mMarkWorkers.size()].get();
+            if (!victim->hasStealableObjects.load(std::memory_order_acquire))
+                continue;
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            if (victim->stealableObjects.empty())
+                continue;
+            thief->grayObjects.swap(victim->stealableObjects);
+            victim->hasStealableObjects.store(false, std::memory_order_release);
+            return true;
+        }
+        return false;
+    }
+
+    void Allocator::StartMarkThreads(size_t count)
+    {
+        StopMarkThreads();
+        for (size_t i = 0; i < count; ++i)
+            mMarkWorkers.emplace_back(std::make_unique<MarkWorker>());
+        for (size_t i = 1; i < count; ++i)
+            mMarkThreads.emplace_back(&Allocator::RunMarkThread, this, i, mMarkRound);
+    }
+
+    void Allocator::RunMarkThread(size_t index, uint64_t round)
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mMarkThreadMutex);
+                while (!mIsStoppingMarkThreads && mMarkRound == round)
+                    mMarkThreadWakeUp.wait(lock);
+                if (mIsStoppingMarkThreads)
+                    return;
+                round = mMarkRound;
+            }
+
+            RunMarkWorker(index);
+
+            std::lock_guard<std::mutex> lock(mMarkThreadMutex);
+            if (--mRunningMarkThreads == 0)
+                mMarkThreadDone.notify_one();
+        }
+    }
+
+    void Allocator::StopMarkThreads()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMarkThreadMutex);
+            mIsStoppingMarkThreads = true;
+        }
+        mMarkThreadWakeUp.notify_all();
+        for (auto &thread : mMarkThreads)
+            thread.join();
+        mMarkThreads.clear();
+        mMarkWorkers.clear();
+        mIsStoppingMarkThreads = false;
+    }
+
+    bool Allocator::Sweep(std::chrono::steady_clock::time_point deadline)
+    {
+        if (mIsSweepingConcurrently)
+            return FinishConcurrentSweep(deadline == std::chrono::steady_clock::time_point::max());
+
+        // survivors keep the mark epoch,they are old.objects promoted meanwhile are linked in front of
+        // the cursor or carry the epoch,the sweep never frees them
+        size_t count = 0;
+        while (*mSweepCursor != nullptr)
+        {
+            if ((++count & 63) == 0 && std::chrono::steady_clock::now() >= deadline)
+                return false;
+
+            Object *object = *mSweepCursor;
+            if (object->marked == mMarkEpoch)
+                mSweepCursor = &object->next;
             else
             {
-                Object *unreached = object;
-                object = object->next;
-                if (previous != nullptr)
-                    previous->next = object;
+                *mSweepCursor = object->next;
+                mBytesAllocated -= object->size;
+                FreeObject(object);
+            }
+        }
+
+        mSweepCursor = nullptr;
+        EndSweep();
+        return true;
+    }
+
+    void Allocator::EndSweep()
+    {
+        mGCPhase = GCPhase::IDLE;
+        mNextGCByteSize = std::max<size_t>(mBytesAllocated * GC_HEAP_GROW_FACTOR, GC_NURSERY_SIZE);
+    }
+
+    void Allocator::BeginConcurrentSweep()
+    {
+        if (!mSweepThread.joinable())
+            mSweepThread = std::thread(&Allocator::RunSweepThread, this);
+
+        {
+            std::lock_guard<std::mutex> lock(mSweepThreadMutex);
+            mUnsweptObjects = mObjectChain;
+        }
+        mSweepThreadWakeUp.notify_one();
+
+        mIsSweepingConcurrently = true;
+        mObjectChain = nullptr;
+        mBytesAllocated = 0;
+    }
+
+    bool Allocator::FinishConcurrentSweep(bool isWaiting)
+    {
+        std::unique_lock<std::mutex> lock(mSweepThreadMutex);
+        if (!isWaiting && !mIsSweepDone)
+            return false;
+        while (!mIsSweepDone)
+            mSweepThreadDone.wait(lock);
+
+        if (mSweptObjects != nullptr)
+        {
+            mSweptObjectsTail->next = mObjectChain;
+            mObjectChain = mSweptObjects;
+        }
+        mBytesAllocated += mSweptBytes;
+        // a class's destructor invalidates the vm's inline caches,see ClassObject::sEpoch
+        for (auto object : mDeferredObjects)
+            FreeObject(object);
+
+        mDeferredObjects.clear();
+        mSweptObjects = nullptr;
+        mSweptObjectsTail = nullptr;
+        mSweptBytes = 0;
+        mIsSweepDone = false;
+        mIsSweepingConcurrently = false;
+        EndSweep();
+        return true;
+    }
+
+    void Allocator::RunSweepThread()
+    {
+        for (;;)
+        {
+            Object *object = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mSweepThreadMutex);
+                while (!mIsStoppingSweepThread && mUnsweptObjects == nullptr)
+                    mSweepThreadWakeUp.wait(lock);
+                if (mIsStoppingSweepThread)
+                    return;
+                object = mUnsweptObjects;
+                mUnsweptObjects = nullptr;
+            }
+
+            // the vm only reaches live objects meanwhile and no collection moves the mark epoch on before this is done
+            Object *survivors = nullptr;
+            Object *tail = nullptr;
+            size_t bytes = 0;
+            std::vector<Object *> deferredObjects;
+            while (object)
+            {
+                Object *next = object->next;
+                if (object->marked == mMarkEpoch)
+                {
+                    if (tail != nullptr)
+                        tail->next = object;
+                    else
+                        survivors = object;
+                    tail = object;
+                    bytes += object->size;
+                }
+                else if (CYS_IS_CLASS_OBJ(object))
+                    deferredObjects.emplace_back(object);
                 else
-                    mObjectChain = object;
+                    FreeObject(object);
+                object = next;
+            }
+            if (tail != nullptr)
+                tail->next = nullptr;
+
+            std::lock_guard<std::mutex> lock(mSweepThreadMutex);
+            mSweptObjects = survivors;
+            mSweptObjectsTail = tail;
+            mSweptBytes = bytes;
+            mDeferredObjects = std::move(deferredObjects);
+            mIsSweepDone = true;
+            mSweepThreadDone.notify_one();
+        }
+    }
 
-                FreeObject(unreached);
+    void Allocator::StopSweepThread()
+    {
+        if (!mSweepThread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mSweepThreadMutex);
+            mIsStoppingSweepThread = true;
+        }
+        mSweepThreadWakeUp.notify_one();
+        mSweepThread.join();
+        mIsStoppingSweepThread = false;
+    }
+
+    void Allocator::SweepYoung()
+    {
+        // survivors keep their mark and move to the old generation,the nursery is empty afterwards
+        Object *object = mYoungObjectChain;
+        while (object)
+        {
+            Object *next = object->next;
+            if (object->marked == mMarkEpoch)
+            {
+                object->next = mObjectChain;
+                mObjectChain = object;
+                mBytesAllocated += object->size;
             }
+            else
+                FreeObject(object);
+            object = next;
         }
+        mYoungObjectChain = nullptr;
+        mYoungBytesAllocated = 0;
     }
 }
\ No newline at end of file
@@ -1,5 +1,11 @@
 #pragma once
 #include <vector>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "Object.h"
 #include "Value.h"
 #include "Common.h"
@@ -12,11 +18,26 @@ namespace CynicScript
         ClosureObject *closure = nullptr;
         uint8_t *ip = nullptr;
         Value *slots = nullptr;
+        // the dynamic call depth(the call frame count before tail calls),not the lexical nesting of the function.
+        // OP_CLOSURE compares it with the depth of a captured variable,a tail call reuses the frame but still counts one level deeper
+        size_t depth = 0;
 
         // ++ Function cache relative
         size_t argumentsHash;
         // -- Function cache relative
     };
+
+    // the value stack,call frame stack and open upvalues of one script.the allocator runs on one of them,
+    // a vm parks the ones of its suspended script in its own context until Resume() swaps them back in
+    struct ExecutionContext
+    {
+        std::vector<Value> valueStack;
+        Value *stackTop{nullptr};
+        std::vector<CallFrame> callFrameStack;
+        CallFrame *callFrameTop{nullptr};
+        UpValueObject *openUpValues{nullptr};
+    };
+
     class CYS_API Allocator : public Singleton<Allocator>
     {
     public:
@@ -26,9 +47,22 @@ namespace CynicScript
         void ResetStackPointer();
         void ResetCallFramePointer();
 
+        // move the stacks of the running script into context and go on with empty ones,
+        // the parked values stay gc roots until RestoreExecutionContext() moves them back
+        void ParkExecutionContext(ExecutionContext *context);
+        // the running stacks have to be empty,they are kept in context for the next ParkExecutionContext()
+        void RestoreExecutionContext(ExecutionContext *context);
+
+        // new objects start young in the nursery,a minor collection frees the dead ones and promotes the survivors
+        // to the old generation,which only a major collection sweeps.with a gc pause budget(see Config) the major
+        // collection is marked and swept in slices between allocations instead of all at once
         template <class T, typename... Args>
         T *CreateObject(Args &&...params);
+        // never triggers a collection,for allocations made while the vm state may not be synced
+        template <class T, typename... Args>
+        T *CreateObjectWithoutGC(Args &&...params);
 
+        // no capacity check,the vm reserves a frame's maxStackDepth(see Verifier.h) before the frame starts pushing
         void PushStack(const Value &value);
         Value PopStack();
         Value PeekStack(int32_t distance);
@@ -36,7 +70,11 @@ namespace CynicScript
         void SetStackTop(Value *top);
         Value *StackTop() const;
         Value *Stack();
+        Value *StackEnd() const;
         void MoveStackTop(int32_t offset);
+        // grow the value stack so count more values fit above top,returns top relocated into the new stack,
+        // call frame slots,open upvalues and refs to stack slots are fixed up
+        Value *GrowStack(Value *top, size_t count);
 
         void PushCallFrame(const CallFrame &callFrame);
         CallFrame *PopCallFrame();
@@ -52,6 +90,15 @@ namespace CynicScript
 
         Value *GetGlobalVariable(size_t idx);
         void SetGlobalVariable(size_t idx, const Value &v);
+        // only grows between compilation and execution,pointers into the global list are not stable across it
+        void EnsureGlobalVariableCount(size_t count);
+        size_t GlobalVariableCount() const;
+
+        // call after storing a value into object's fields.an old object that may now point to a young one is kept
+        // in the remembered set,a minor collection traces it like a root instead of walking the old generation.
+        // while a major collection marks,the same set holds the black objects that may now point to a white one,
+        // they are traced again before the marking finishes
+        void WriteBarrier(Object *object);
 
     private:
         friend class VM;
@@ -65,46 +112,153 @@ namespace CynicScript
         template <class T>
         void FreeObject(T *object);
         void FreeObjects();
+        void FreeObjectChain(Object *object);
+        // runs a whole major collection,the rest of the one in progress included
         void GC();
+        void MinorGC();
+        // one slice of the major collection in progress,stops once the gc pause budget is used up
+        void StepGC();
+#ifndef NDEBUG
+        void StressGC();
+#endif
 
+        void BeginMark();
+        void FinishMark();
         void MarkRootObjects();
-        void MarkGrayObjects();
-        void Sweep();
+        void MarkRememberedObjects();
+        // false if the deadline passed before the gray objects ran out.without a deadline a major collection
+        // marks on Config::GetGCMarkThreadCount() threads
+        bool MarkGrayObjects(std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+        // false if the deadline passed before the old generation was swept to the end,
+        // a sweep on the sweep thread is only waited for without a deadline
+        bool Sweep(std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+        void SweepYoung();
+        void EndSweep();
 
-        Value mGlobalVariableList[GLOBAL_VARIABLE_MAX];
+        std::vector<Value> mGlobalVariableList;
 
+        // both stacks start small and are reallocated on demand,never cache pointers into them across a call
         Value *mStackTop;
-        Value mValueStack[STACK_MAX];
+        std::vector<Value> mValueStack;
 
         CallFrame *mCallFrameTop;
-        CallFrame mCallFrameStack[STACK_MAX];
+        std::vector<CallFrame> mCallFrameStack;
 
         UpValueObject *mOpenUpValues;
 
+        std::vector<ExecutionContext *> mParkedContexts;
+
         friend struct Object;
 
+        // an object is old once it survived a collection,old objects keep the mark epoch of the last major collection
+        // so a minor collection stops at them,a major collection starts by moving to the next epoch,which turns every
+        // old object white without touching it
         Object *mObjectChain;
         std::vector<Object *> mGrayObjects;
-        size_t mBytesAllocated;
+        size_t mBytesAllocated; // old generation
         size_t mNextGCByteSize;
+        uint8_t mMarkEpoch;
+
+        // ++ Nursery relative
+        Object *mYoungObjectChain;
+        size_t mYoungBytesAllocated;
+        std::vector<Object *> mRememberedObjects;
+#ifndef NDEBUG
+        bool mIsNextStressGCMajor{false};
+#endif
+        // -- Nursery relative
+
+        // ++ Incremental collection relative
+        enum class GCPhase : uint8_t
+        {
+            IDLE,
+            MARK,  // minor collections wait,the nursery grows until the marking finishes
+            SWEEP, // the old generation is swept lazily,minor collections go on
+        };
+        GCPhase mGCPhase;
+        size_t mStepBytesAllocated; // since the last slice
+        Object **mSweepCursor;      // the link to the next old object the sweep looks at
+        // -- Incremental collection relative
+
+        // ++ Parallel mark relative
+        // the gray objects of one marking thread,the vm thread is worker 0.a busy worker hands the older half of its
+        // gray objects out once another one runs idle,the idle one steals them and traces them with the same Blacken()
+        struct MarkWorker
+        {
+            std::vector<Object *> grayObjects; // only its own thread touches them
+            std::mutex mutex;
+            std::vector<Object *> stealableObjects; // guarded by mutex
+            std::atomic<bool> hasStealableObjects{false};
+        };
+
+        void MarkGrayObjectsInParallel();
+        // Object::Mark while the workers run,the first worker to move the mark to the epoch owns the object
+        void MarkInParallel(Object *object);
+        void RunMarkWorker(size_t index);
+        // the body of a mark thread,runs a worker for every round after the given one
+        void RunMarkThread(size_t index, uint64_t round);
+        void ShareGrayObjects(MarkWorker *worker);
+        bool StealGrayObjects(size_t index);
+        void StartMarkThreads(size_t count);
+        void StopMarkThreads();
+
+        std::vector<std::unique_ptr<MarkWorker>> mMarkWorkers;
+        std::vector<std::thread> mMarkThreads;
+        std::mutex mMarkThreadMutex;
+        std::condition_variable mMarkThreadWakeUp;
+        std::condition_variable mMarkThreadDone;
+        uint64_t mMarkRound{0};
+        size_t mRunningMarkThreads{0};
+        bool mIsStoppingMarkThreads{false};
+        bool mIsParallelMarking{false};
+        std::atomic<size_t> mIdleMarkWorkers{0};
+        // -- Parallel mark relative
+
+        // ++ Concurrent sweep relative
+        // the old generation as the marking left it is handed to the sweep thread,objects promoted meanwhile start
+        // a new chain and the survivors are linked back in front of it once the sweep thread is done
+        void BeginConcurrentSweep();
+        // false if isWaiting is false and the sweep thread is not done yet
+        bool FinishConcurrentSweep(bool isWaiting);
+        void RunSweepThread();
+        void StopSweepThread();
+
+        std::thread mSweepThread;
+        std::mutex mSweepThreadMutex;
+        std::condition_variable mSweepThreadWakeUp;
+        std::condition_variable mSweepThreadDone;
+        bool mIsStoppingSweepThread{false};
+        bool mIsSweepingConcurrently{false}; // the vm thread's view,the rest is guarded by mSweepThreadMutex
+        bool mIsSweepDone{false};
+        Object *mUnsweptObjects{nullptr};
+        Object *mSweptObjects{nullptr}; // the survivors
+        Object *mSweptObjectsTail{nullptr};
+        size_t mSweptBytes{0};
+        std::vector<Object *> mDeferredObjects; // dead objects whose destructors touch vm state,freed on the vm thread
+        // -- Concurrent sweep relative
     };
 
     template <class T, typename... Args>
     inline T *Allocator::CreateObject(Args &&...params)
     {
-        T *object = new T(std::forward<Args>(params)...);
-        size_t objBytes = sizeof(*object);
-        mBytesAllocated += objBytes;
+        // collect before the object exists,a collection would neither see an unlinked object nor free its bytes
+        constexpr size_t objBytes = sizeof(T);
 #ifndef NDEBUG
         if (Config::GetInstance()->IsStressGC())
-            GC();
+            StressGC();
 #endif
-        if (mBytesAllocated > mNextGCByteSize)
-            GC();
+        if (mGCPhase != GCPhase::IDLE && (mStepBytesAllocated += objBytes) > GC_STEP_SIZE)
+            StepGC();
+        if (mGCPhase != GCPhase::MARK && mYoungBytesAllocated + objBytes > GC_NURSERY_SIZE)
+            MinorGC();
+
+        T *object = new T(std::forward<Args>(params)...);
+        object->size = static_cast<uint32_t>(objBytes);
+        mYoungBytesAllocated += objBytes;
 
-        object->next = mObjectChain;
-        object->marked = false;
-        mObjectChain = object;
+        object->next = mYoungObjectChain;
+        object->marked = 0;
+        mYoungObjectChain = object;
 #ifndef NDEBUG
         if (Config::GetInstance()->IsDebugGC())
             CYS_LOG_INFO(TEXT("{} has been add to gc record chain {} for {}"), (void *)object, objBytes, object->kind);
@@ -113,6 +267,19 @@ namespace CynicScript
         return object;
     }
 
+    template <class T, typename... Args>
+    inline T *Allocator::CreateObjectWithoutGC(Args &&...params)
+    {
+        T *object = new T(std::forward<Args>(params)...);
+        object->size = static_cast<uint32_t>(sizeof(*object));
+        mYoungBytesAllocated += object->size;
+
+        object->next = mYoungObjectChain;
+        object->marked = 0;
+        mYoungObjectChain = object;
+        return object;
+    }
+
     template <class T>
     inline void Allocator::FreeObject(T *object)
     {
@@ -120,10 +287,18 @@ namespace CynicScript
         if (Config::GetInstance()->IsDebugGC())
             CYS_LOG_INFO(TEXT("delete object(0x{})"), (void *)object);
 #endif
-        mBytesAllocated -= sizeof(object);
         SAFE_DELETE(object);
     }
 
+    inline void Allocator::WriteBarrier(Object *object)
+    {
+        if (object != nullptr && object->marked == mMarkEpoch && !object->isRemembered)
+        {
+            object->isRemembered = true;
+            mRememberedObjects.emplace_back(object);
+        }
+    }
+
 #define GET_GLOBAL_VARIABLE(idx) (Allocator::GetInstance()->GetGlobalVariable(idx))
 
 #define PUSH_STACK(v) (Allocator::GetInstance()->PushStack(v))
@@ -131,6 +306,7 @@ namespace CynicScript
 #define PEEK_STACK(dist) (Allocator::GetInstance()->PeekStack(dist))
 #define STACK_TOP() (Allocator::GetInstance()->StackTop())
 #define STACK() (Allocator::GetInstance()->Stack())
+#define STACK_END() (Allocator::GetInstance()->StackEnd())
 #define SET_STACK_TOP(v) (Allocator::GetInstance()->SetStackTop(v))
 #define MOVE_STACK_TOP(idx) (Allocator::GetInstance()->MoveStackTop(idx))
 #define SET_VALUE_FROM_STACK_TOP_OFFSET(offset, v) (Allocator::GetInstance()->SetValueFromStackTopOffset(offset, v))
@@ -143,4 +319,6 @@ namespace CynicScript
 
 #define CAPTURE_UPVALUE(location) (Allocator::GetInstance()->CaptureUpValue(location))
 #define CLOSED_UPVALUES(end) (Allocator::GetInstance()->ClosedUpValues(end))
+
+#define WRITE_BARRIER(object) (Allocator::GetInstance()->WriteBarrier(object))
 }
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "Aot.h"
+#include <unordered_map>
+#include <unordered_set>
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#include "BytecodeOptimizePass.h"
+#include "Logger.h"
+namespace CynicScript
+{
+	// shared by every generated file,the names match the locals each generated function declares
+	constexpr const char *AOT_PRELUDE = R"(#include "Aot.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define CYS_AOT_EXPORT __declspec(dllexport)
+#else
+#define CYS_AOT_EXPORT __attribute__((visibility("default")))
+#endif
+
+using namespace CynicScript;
+
+#define PUSH(v) (*(stackTop++) = (v))
+#define STUB(opCode, ipOffset) CallStub(stubs, context, stackTop, opCode, opCodes + (ipOffset))
+#define EXIT(offset)                    \
+	do                                  \
+	{                                   \
+		context->stackTop = stackTop;   \
+		return offset;                  \
+	} while (false)
+
+#define INT_PAIR() (CYS_IS_INT_VALUE(stackTop[-2]) && CYS_IS_INT_VALUE(stackTop[-1]))
+#define REAL_PAIR() (CYS_IS_REAL_VALUE(stackTop[-2]) && CYS_IS_REAL_VALUE(stackTop[-1]))
+#define INT_BINARY(op) (stackTop[-2] = Value(CYS_TO_INT_VALUE(stackTop[-2]) op CYS_TO_INT_VALUE(stackTop[-1])), --stackTop)
+#define REAL_BINARY(op) (stackTop[-2] = Value(CYS_TO_REAL_VALUE(stackTop[-2]) op CYS_TO_REAL_VALUE(stackTop[-1])), --stackTop)
+
+static inline bool IsFalsey(const Value &v)
+{
+	return CYS_IS_NULL_VALUE(v) || (CYS_IS_BOOL_VALUE(v) && !CYS_TO_BOOL_VALUE(v));
+}
+
+static inline bool CallStub(const NativeStub *stubs, NativeContext *context, Value *&stackTop, uint8_t opCode, uint8_t *ip)
+{
+	context->stackTop = stackTop;
+	auto taken = stubs[opCode](context, ip);
+	stackTop = context->stackTop;
+	return taken;
+}
+)";
+
+	static void CollectFunctions(FunctionObject *function, std::unordered_set<FunctionObject *> &visited, std::vector<FunctionObject *> &result)
+	{
+		if (visited.contains(function))
+			return;
+		visited.insert(function);
+		result.emplace_back(function);
+
+		for (const auto &c : function->chunk.constants)
+		{
+			if (CYS_IS_FUNCTION_VALUE(c))
+				CollectFunctions(CYS_TO_FUNCTION_VALUE(c), visited, result);
+		}
+	}
+
+	static std::string Label(size_t offset)
+	{
+		return "L" + std::to_string(offset);
+	}
+
+	// the statement for one opcode,every fast path falls back to the opcode's stub when its operand kinds do not match
+	static std::string LowerOpCode(const Chunk &chunk, size_t offset, const NativeStub *stubs)
+	{
+		auto opCode = chunk.opCodes[offset];
+		auto operand = [&](size_t i) -> std::string
+		{ return std::to_string(chunk.opCodes[offset + 1 + i]); };
+		auto operandU16 = [&]() -> std::string
+		{ return std::to_string((chunk.opCodes[offset + 1] << 8) | chunk.opCodes[offset + 2]); };
+		auto stub = "STUB(" + std::to_string(opCode) + ", " + std::to_string(offset + 1) + ")";
+		auto jumpTarget = BytecodeOptimizePass::IsJumpOpCode(opCode) ? Label(BytecodeOptimizePass::GetJumpTarget(chunk, offset)) : std::string();
+
+		auto binary = [&](bool hasInt, bool hasReal, const std::string &op) -> std::string
+		{
+			std::string result;
+			if (hasInt)
+				result += "if (INT_PAIR()) INT_BINARY(" + op + "); else ";
+			if (hasReal)
+				result += "if (REAL_PAIR()) REAL_BINARY(" + op + "); else ";
+			return result + stub + ";";
+		};
+
+		auto store = [&](const std::string &slot, bool isPop) -> std::string
+		{
+			// a ref slot writes through its pointer,leave that to the stub
+			return "if (!CYS_IS_REF_VALUE(" + slot + ")) " + slot + " = " + (isPop ? "*--stackTop" : "stackTop[-1]") + "; else " + stub + ";";
+		};
+
+		switch (opCode)
+		{
+		case OP_JUMP:
+		case OP_JUMP_LONG:
+		case OP_LOOP:
+		case OP_LOOP_LONG:
+			return "goto " + jumpTarget + ";";
+		case OP_CONSTANT:
+			return "PUSH(constants[" + operand(0) + "]);";
+		case OP_CONSTANT_LONG:
+			return "PUSH(constants[" + operandU16() + "]);";
+		case OP_GET_LOCAL:
+			return "PUSH(slots[" + operand(0) + "]);";
+		case OP_GET_LOCAL_LONG:
+			return "PUSH(slots[" + operandU16() + "]);";
+		case OP_GET_GLOBAL:
+			return "PUSH(globals[" + operand(0) + "]);";
+		case OP_GET_GLOBAL_LONG:
+			return "PUSH(globals[" + operandU16() + "]);";
+		case OP_NULL:
+			return "PUSH(Value());";
+		case OP_POP:
+			return "--stackTop;";
+		case OP_SET_LOCAL:
+			return store("slots[" + operand(0) + "]", false);
+		case OP_SET_LOCAL_LONG:
+			return store("slots[" + operandU16() + "]", false);
+		case OP_SET_LOCAL_POP:
+			return store("slots[" + operand(0) + "]", true);
+		case OP_SET_LOCAL_LOAD:
+			return store("slots[" + operand(0) + "]", false);
+		case OP_SET_GLOBAL:
+			return store("globals[" + operand(0) + "]", false);
+		case OP_SET_GLOBAL_LONG:
+			return store("globals[" + operandU16() + "]", false);
+		case OP_SET_GLOBAL_POP:
+			return store("globals[" + operand(0) + "]", true);
+		case OP_ADD:
+			return binary(true, true, "+");
+		case OP_SUB:
+			return binary(true, true, "-");
+		case OP_MUL:
+			return binary(true, true, "*");
+		case OP_DIV:
+			return binary(false, true, "/"); // integer division by zero is reported by the stub
+		case OP_LESS:
+			return binary(true, true, "<");
+		case OP_GREATER:
+			return binary(true, true, ">");
+		case OP_ADD_I64:
+			return binary(true, false, "+");
+		case OP_SUB_I64:
+			return binary(true, false, "-");
+		case OP_MUL_I64:
+			return binary(true, false, "*");
+		case OP_LESS_I64:
+			return binary(true, false, "<");
+		case OP_GREATER_I64:
+			return binary(true, false, ">");
+		case OP_ADD_F64:
+			return binary(false, true, "+");
+		case OP_SUB_F64:
+			return binary(false, true, "-");
+		case OP_MUL_F64:
+			return binary(false, true, "*");
+		case OP_DIV_F64:
+			return binary(false, true, "/");
+		case OP_LESS_F64:
+			return binary(false, true, "<");
+		case OP_GREATER_F64:
+			return binary(false, true, ">");
+		case OP_EQUAL:
+			return binary(true, false, "==");
+		case OP_NOT:
+			return "if (CYS_IS_BOOL_VALUE(stackTop[-1])) stackTop[-1] = Value(!CYS_TO_BOOL_VALUE(stackTop[-1])); else " + stub + ";";
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_FALSE_LONG:
+			return "if (IsFalsey(stackTop[-1])) goto " + jumpTarget + ";";
+		case OP_JUMP_IF_FALSE_POP:
+			return "if (IsFalsey(*--stackTop)) goto " + jumpTarget + ";";
+		case OP_JUMP_IF_TRUE_POP:
+			return "if (CYS_IS_BOOL_VALUE(stackTop[-1])) { if (CYS_TO_BOOL_VALUE(*--stackTop)) goto " + jumpTarget + "; } else if (" + stub + ") goto " + jumpTarget + ";";
+		case OP_INC_LOCAL:
+		{
+			auto slot = "slots[" + operand(0) + "]", constant = "constants[" + operand(1) + "]";
+			return "if (CYS_IS_INT_VALUE(" + slot + ") && CYS_IS_INT_VALUE(" + constant + ")) " + slot + " = Value(CYS_TO_INT_VALUE(" + slot + ") + CYS_TO_INT_VALUE(" + constant + ")); else " + stub + ";";
+		}
+		case OP_LESS_LOCAL_CONST_JUMP:
+		{
+			auto slot = "slots[" + operand(0) + "]", constant = "constants[" + operand(1) + "]";
+			return "if (CYS_IS_INT_VALUE(" + slot + ") && CYS_IS_INT_VALUE(" + constant + ")) { if (CYS_TO_INT_VALUE(" + slot + ") >= CYS_TO_INT_VALUE(" + constant + ")) goto " + jumpTarget + "; } else if (" + stub + ") goto " + jumpTarget + ";";
+		}
+		case OP_FOR_RANGE_INT:
+		{
+			// counter,end,loop variable
+			auto state = "slots[" + operand(0) + "]", end = "slots[" + std::to_string(chunk.opCodes[offset + 1] + 1) + "]", variable = "slots[" + std::to_string(chunk.opCodes[offset + 1] + 2) + "]";
+			return "if (CYS_IS_INT_VALUE(" + state + ") && CYS_IS_INT_VALUE(" + end + ")) { if (CYS_TO_INT_VALUE(" + state + ") >= CYS_TO_INT_VALUE(" + end + ")) goto " + jumpTarget + "; " +
+				   variable + " = " + state + "; " + state + " = Value(CYS_TO_INT_VALUE(" + state + ") + 1); } else if (" + stub + ") goto " + jumpTarget + ";";
+		}
+		default:
+			if (!stubs[opCode])
+				return "EXIT(" + std::to_string(offset) + ");";
+			if (BytecodeOptimizePass::IsJumpOpCode(opCode))
+				return "if (" + stub + ") goto " + jumpTarget + ";";
+			return stub + ";";
+		}
+	}
+
+	static std::string EmitFunction(const std::string &name, FunctionObject *function, const NativeStub *stubs)
+	{
+		const auto &chunk = function->chunk;
+
+		std::string offsets;
+		std::string body;
+		for (size_t offset = 0; offset < chunk.opCodes.size(); offset += 1 + BytecodeOptimizePass::GetOperandSize(chunk, offset))
+		{
+			offsets += "\tcase " + std::to_string(offset) + ":\n\t\tgoto " + Label(offset) + ";\n";
+			body += Label(offset) + ":\n\t" + LowerOpCode(chunk, offset, stubs) + "\n";
+		}
+		// jumps to the end of chunk
+		body += Label(chunk.opCodes.size()) + ":\n\tEXIT(" + std::to_string(chunk.opCodes.size()) + ");\n";
+
+#ifdef CYS_UTF8_ENCODE
+		auto description = Utf8::Encode(function->name);
+#else
+		auto description = function->name;
+#endif
+		return "// fn " + description + "\n" +
+			   "static uint32_t " + name + "(NativeContext *context, uint32_t offset)\n{\n" +
+			   "\t[[maybe_unused]] auto stubs = VM::GetNativeStubs();\n" +
+			   "\t[[maybe_unused]] auto opCodes = context->frame->closure->function->chunk.opCodes.data();\n" +
+			   "\t[[maybe_unused]] auto slots = context->frame->slots;\n" +
+			   "\t[[maybe_unused]] auto constants = context->constants;\n" +
+			   "\t[[maybe_unused]] auto globals = context->globals;\n" +
+			   "\tauto stackTop = context->stackTop;\n\n" +
+			   "\tswitch (offset)\n\t{\n" + offsets + "\tdefault:\n\t\tEXIT(offset);\n\t}\n\n" +
+			   body + "}\n\n";
+	}
+
+	std::string Aot::EmitCpp(FunctionObject *mainFunc)
+	{
+		std::unordered_set<FunctionObject *> visited;
+		std::vector<FunctionObject *> functions;
+		CollectFunctions(mainFunc, visited, functions);
+
+		auto stubs = VM::GetNativeStubs();
+
+		// the value layout and FunctionObject's members depend on these,the module must be built with the library's options
+		std::string result = "// generated by CynicScript --emit-cpp,build it as a shared library against the headers in the CynicScript inc directory:\n"
+							 "//     c++ -std=c++20 -O2 -shared -fPIC -I<inc> <this file> -o <module>\n"
+							 "// and run the same script with --load-native <module>\n";
+#ifdef CYS_UTF8_ENCODE
+		result += "#define CYS_UTF8_ENCODE\n";
+#endif
+#ifdef CYS_NAN_BOXING
+		result += "#define CYS_NAN_BOXING\n";
+#endif
+#ifdef CYS_JIT
+		result += "#define CYS_JIT\n";
+#endif
+		result += AOT_PRELUDE;
+		result += "\n";
+
+		std::unordered_map<uint64_t, std::string> emitted; // identical chunks share one function
+		std::string table;
+		for (auto function : functions)
+		{
+			auto hash = HashChunk(function->chunk);
+			if (emitted.contains(hash))
+				continue;
+
+			auto name = "Function" + std::to_string(emitted.size());
+			emitted[hash] = name;
+			result += EmitFunction(name, function, stubs);
+			table += "\t{" + std::to_string(hash) + "ull, " + std::to_string(function->chunk.opCodes.size()) + "u, " + name + "},\n";
+		}
+
+		result += "extern \"C\" CYS_AOT_EXPORT const AotFunction gCysAotFunctions[] = {\n" + table + "};\n";
+		result += "extern \"C\" CYS_AOT_EXPORT const uint32_t gCysAotFunctionCount = " + std::to_string(emitted.size()) + ";\n";
+		return result;
+	}
+
+	void Aot::Load(std::string_view path, FunctionObject *mainFunc)
+	{
+		std::string pathStr(path);
+#ifdef CYS_UTF8_ENCODE
+		auto displayPath = Utf8::Decode(pathStr);
+#else
+		auto displayPath = pathStr;
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+		auto module = LoadLibraryA(pathStr.c_str());
+		auto symbol = [module](const char *name)
+		{ return module ? reinterpret_cast<void *>(GetProcAddress(module, name)) : nullptr; };
+#else
+		auto module = dlopen(pathStr.c_str(), RTLD_NOW | RTLD_LOCAL);
+		auto symbol = [module](const char *name)
+		{ return module ? dlsym(module, name) : nullptr; };
+#endif
+		auto functions = static_cast<const AotFunction *>(symbol("gCysAotFunctions"));
+		auto count = static_cast<const uint32_t *>(symbol("gCysAotFunctionCount"));
+		if (!functions || !count)
+			CYS_LOG_ERROR(TEXT("Failed to load native module:{},not a module generated by --emit-cpp."), displayPath);
+
+		// the module stays loaded for the rest of the process,compiled functions may point into it at any time
+		std::unordered_map<uint64_t, const AotFunction *> table;
+		for (uint32_t i = 0; i < *count; ++i)
+			table[functions[i].hash] = functions + i;
+
+		std::unordered_set<FunctionObject *> visited;
+		std::vector<FunctionObject *> scriptFunctions;
+		CollectFunctions(mainFunc, visited, scriptFunctions);
+		for (auto function : scriptFunctions)
+		{
+			auto iter = table.find(HashChunk(function->chunk));
+			if (iter != table.end() && iter->second->size == function->chunk.opCodes.size())
+				function->aotEntry = iter->second->entry;
+		}
+	}
+
+	// fnv-1a over the opcodes,the generated code reads constants through the running chunk so only the opcodes have to match
+	uint64_t Aot::HashChunk(const Chunk &chunk)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (auto opCode : chunk.opCodes)
+		{
+			hash ^= opCode;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "VM.h"
+namespace CynicScript
+{
+    // one chunk compiled by an aot module,matched to a FunctionObject by the content of its opcodes
+    struct AotFunction
+    {
+        uint64_t hash;
+        uint32_t size;
+        uint32_t (*entry)(NativeContext *context, uint32_t offset);
+    };
+
+    // ahead of time compilation:EmitCpp lowers every chunk reachable from mainFunc into a C++ function that works on the
+    // vm stack like the jit does,the system compiler turns the file into a shared library and Load attaches it to the freshly
+    // compiled script.the bytecode stays,opcodes the generated code leaves to the interpreter(calls,returns,classes...) still run from it
+    class CYS_API Aot
+    {
+    public:
+        static std::string EmitCpp(FunctionObject *mainFunc);
+        static void Load(std::string_view path, FunctionObject *mainFunc);
+
+        static uint64_t HashChunk(const Chunk &chunk);
+    };
+}
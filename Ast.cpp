@@ -645,6 +645,30 @@ namespace CynicScript
 	}
 #endif
 
+	ForInStmt::ForInStmt(Token *tagToken)
+		: Stmt(tagToken, AstKind::FOR_IN), permission(Permission::MUTABLE), variable(nullptr), iterable(nullptr), rangeBegin(nullptr), rangeEnd(nullptr), body(nullptr)
+	{
+	}
+	ForInStmt::~ForInStmt()
+	{
+		SAFE_DELETE(variable);
+		SAFE_DELETE(iterable);
+		SAFE_DELETE(rangeBegin);
+		SAFE_DELETE(rangeEnd);
+		SAFE_DELETE(body);
+	}
+#ifndef NDEBUG
+	STRING ForInStmt::ToString()
+	{
+		STRING result = TEXT("for(let ") + variable->ToString() + TEXT(" in ");
+		if (iterable)
+			result += iterable->ToString();
+		else
+			result += TEXT("range(") + (rangeBegin ? rangeBegin->ToString() + TEXT(",") : TEXT("")) + rangeEnd->ToString() + TEXT(")");
+		return result + TEXT(")") + body->ToString();
+	}
+#endif
+
 	BreakStmt::BreakStmt(Token *tagToken)
 		: Stmt(tagToken, AstKind::BREAK)
 	{
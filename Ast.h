@@ -41,6 +41,7 @@ namespace CynicScript
 		IF,
 		SCOPE,
 		WHILE,
+		FOR_IN,
 		BREAK,
 		CONTINUE,
 		ENUM,
@@ -433,6 +434,23 @@ namespace CynicScript
 		ScopeStmt *increment;
 	};
 
+	// for(let x in array) or for(let i in range(begin,end)),range is recognized by the parser and never builds an array
+	struct ForInStmt : public Stmt
+	{
+		ForInStmt(Token *tagToken);
+		~ForInStmt() override;
+#ifndef NDEBUG
+		STRING ToString() override;
+#endif
+
+		Permission permission;
+		VarDescExpr *variable;
+		Expr *iterable;	  // nullptr for the range form
+		Expr *rangeBegin; // nullptr means 0
+		Expr *rangeEnd;
+		ScopeStmt *body;
+	};
+
 	struct BreakStmt : public Stmt
 	{
 		BreakStmt(Token *tagToken);
@@ -38,6 +38,8 @@ namespace CynicScript
                 return ExecuteScopeStmt((ScopeStmt *)stmt);
             case AstKind::WHILE:
                 return ExecuteWhileStmt((WhileStmt *)stmt);
+            case AstKind::FOR_IN:
+                return ExecuteForInStmt((ForInStmt *)stmt);
             case AstKind::BREAK:
                 return ExecuteBreakStmt((BreakStmt *)stmt);
             case AstKind::CONTINUE:
@@ -86,6 +88,7 @@ namespace CynicScript
         virtual Stmt *ExecuteIfStmt(IfStmt *stmt) { return stmt; }
         virtual Stmt *ExecuteScopeStmt(ScopeStmt *stmt) { return stmt; }
         virtual Stmt *ExecuteWhileStmt(WhileStmt *stmt) { return stmt; }
+        virtual Stmt *ExecuteForInStmt(ForInStmt *stmt) { return stmt; }
         virtual Stmt *ExecuteBreakStmt(BreakStmt *stmt) { return stmt; }
         virtual Stmt *ExecuteContinueStmt(ContinueStmt *stmt) { return stmt; }
 
@@ -98,13 +101,15 @@ namespace CynicScript
             case AstKind::IDENTIFIER:
                 return ExecuteIdentifierExpr((IdentifierExpr *)expr);
             case AstKind::VAR_DESC:
-                return ExecuteVarArgExpr((VarArgExpr *)expr);
+                return ExecuteVarDescExpr((VarDescExpr *)expr);
             case AstKind::GROUP:
                 return ExecuteGroupExpr((GroupExpr *)expr);
             case AstKind::ARRAY:
                 return ExecuteArrayExpr((ArrayExpr *)expr);
             case AstKind::DICT:
                 return ExecuteDictExpr((DictExpr *)expr);
+            case AstKind::INDEX:
+                return ExecuteIndexExpr((IndexExpr *)expr);
             case AstKind::PREFIX:
                 return ExecutePrefixExpr((PrefixExpr *)expr);
             case AstKind::INFIX:
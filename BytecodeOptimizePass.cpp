@@ -0,0 +1,348 @@
+#include "BytecodeOptimizePass.h"
+#include "Logger.h"
+namespace CynicScript
+{
+	uint32_t BytecodeOptimizePass::GetOperandSize(const Chunk &chunk, size_t offset)
+	{
+		switch (chunk.opCodes[offset])
+		{
+		case OP_RETURN:
+		case OP_CONSTANT:
+		case OP_SET_GLOBAL:
+		case OP_GET_GLOBAL:
+		case OP_SET_LOCAL:
+		case OP_GET_LOCAL:
+		case OP_SET_UPVALUE:
+		case OP_GET_UPVALUE:
+		case OP_ARRAY:
+		case OP_DICT:
+		case OP_REF_GLOBAL:
+		case OP_REF_LOCAL:
+		case OP_REF_UPVALUE:
+		case OP_REF_INDEX_GLOBAL:
+		case OP_REF_INDEX_LOCAL:
+		case OP_REF_INDEX_UPVALUE:
+		case OP_CALL:
+		case OP_TAIL_CALL:
+		case OP_STRUCT:
+		case OP_APPREGATE_RESOLVE:
+		case OP_APPREGATE_RESOLVE_VAR_ARG:
+		case OP_INIT_VAR_ARG:
+		case OP_SET_GLOBAL_POP:
+		case OP_SET_LOCAL_POP:
+		case OP_SET_LOCAL_LOAD:
+			return 1;
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP:
+		case OP_LOOP:
+		case OP_JUMP_IF_FALSE_POP:
+		case OP_JUMP_IF_TRUE_POP:
+		case OP_INC_LOCAL:
+		case OP_MODULE:
+			return 2;
+		case OP_FOR_RANGE_INT:
+		case OP_FOR_EACH_ARRAY:
+			return 3;
+		case OP_LESS_LOCAL_CONST_JUMP:
+			return 4;
+		case OP_CONSTANT_LONG:
+		case OP_SET_GLOBAL_LONG:
+		case OP_GET_GLOBAL_LONG:
+		case OP_SET_LOCAL_LONG:
+		case OP_GET_LOCAL_LONG:
+			return 2;
+		case OP_JUMP_IF_FALSE_LONG:
+		case OP_JUMP_LONG:
+		case OP_LOOP_LONG:
+			return 4;
+		case OP_CLASS:
+			return 6;
+		case OP_CLOSURE:
+			return 1 + CYS_TO_FUNCTION_VALUE(chunk.constants[chunk.opCodes[offset + 1]])->upValueCount * 2;
+		case OP_CLOSURE_LONG:
+			return 2 + CYS_TO_FUNCTION_VALUE(chunk.constants[(chunk.opCodes[offset + 1] << 8) | chunk.opCodes[offset + 2]])->upValueCount * 2;
+		default:
+			return 0;
+		}
+	}
+
+	static bool IsLongJumpOpCode(uint8_t opCode)
+	{
+		return opCode == OP_JUMP_IF_FALSE_LONG || opCode == OP_JUMP_LONG || opCode == OP_LOOP_LONG;
+	}
+
+	static bool IsBackwardJumpOpCode(uint8_t opCode)
+	{
+		return opCode == OP_LOOP || opCode == OP_LOOP_LONG;
+	}
+
+	// returns the opcode itself if there is no long form
+	static uint8_t GetLongJumpOpCode(uint8_t opCode)
+	{
+		switch (opCode)
+		{
+		case OP_JUMP_IF_FALSE:
+			return OP_JUMP_IF_FALSE_LONG;
+		case OP_JUMP:
+			return OP_JUMP_LONG;
+		case OP_LOOP:
+			return OP_LOOP_LONG;
+		default:
+			return opCode;
+		}
+	}
+
+	static uint32_t GetJumpOffsetSize(uint8_t opCode)
+	{
+		return IsLongJumpOpCode(opCode) ? 4 : 2;
+	}
+
+	size_t BytecodeOptimizePass::GetJumpTarget(const Chunk &chunk, size_t offset)
+	{
+		auto opCode = chunk.opCodes[offset];
+		auto next = offset + 1 + GetOperandSize(chunk, offset);
+		uint32_t address = 0;
+		for (size_t j = next - GetJumpOffsetSize(opCode); j < next; ++j)
+			address = (address << 8) | chunk.opCodes[j];
+		return IsBackwardJumpOpCode(opCode) ? next - address : next + address;
+	}
+
+	void BytecodeOptimizePass::Execute(FunctionObject *function)
+	{
+		std::unordered_set<FunctionObject *> visited;
+		ExecuteFunction(function, visited);
+	}
+
+	bool BytecodeOptimizePass::IsJumpOpCode(uint8_t opCode)
+	{
+		return opCode == OP_JUMP ||
+			   opCode == OP_JUMP_IF_FALSE ||
+			   opCode == OP_LOOP ||
+			   opCode == OP_JUMP_IF_FALSE_POP ||
+			   opCode == OP_JUMP_IF_TRUE_POP ||
+			   opCode == OP_LESS_LOCAL_CONST_JUMP ||
+			   opCode == OP_FOR_RANGE_INT ||
+			   opCode == OP_FOR_EACH_ARRAY ||
+			   IsLongJumpOpCode(opCode);
+	}
+
+	InstructionList BytecodeOptimizePass::Decode(const Chunk &chunk, const std::unordered_map<uint32_t, uint32_t> &farJumpTargets)
+	{
+		InstructionList result;
+		std::unordered_map<size_t, int64_t> offsetToIndex;
+		std::vector<size_t> targetOffsets;
+
+		for (size_t offset = 0; offset < chunk.opCodes.size();)
+		{
+			Instruction instruction;
+			instruction.opCode = chunk.opCodes[offset];
+			instruction.token = chunk.GetRelatedToken(static_cast<uint32_t>(offset));
+
+			auto operandSize = GetOperandSize(chunk, offset);
+			auto next = offset + 1 + operandSize;
+			if (IsJumpOpCode(instruction.opCode))
+			{
+				auto offsetSize = GetJumpOffsetSize(instruction.opCode);
+				instruction.operands.assign(chunk.opCodes.begin() + offset + 1, chunk.opCodes.begin() + next - offsetSize);
+
+				auto iter = farJumpTargets.find(static_cast<uint32_t>(offset));
+				if (iter != farJumpTargets.end())
+					targetOffsets.emplace_back(iter->second);
+				else
+					targetOffsets.emplace_back(GetJumpTarget(chunk, offset));
+			}
+			else
+			{
+				instruction.operands.assign(chunk.opCodes.begin() + offset + 1, chunk.opCodes.begin() + next);
+				targetOffsets.emplace_back(SIZE_MAX);
+			}
+
+			offsetToIndex[offset] = static_cast<int64_t>(result.size());
+			result.emplace_back(instruction);
+			offset = next;
+		}
+
+		offsetToIndex[chunk.opCodes.size()] = static_cast<int64_t>(result.size()); // jump to the end of chunk
+
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			if (targetOffsets[i] == SIZE_MAX)
+				continue;
+			auto iter = offsetToIndex.find(targetOffsets[i]);
+			if (iter == offsetToIndex.end())
+				CYS_LOG_ERROR_WITH_LOC(result[i].token, TEXT("Invalid jump target:{},not at an instruction boundary."), targetOffsets[i]);
+			result[i].jumpTarget = iter->second;
+		}
+
+		return result;
+	}
+
+	// a jump without a long form keeps its 16 bit offset and lands on a long jump right behind it instead:
+	// X far -> X trampoline; JUMP next; trampoline: JUMP_LONG far; next: ...
+	static void InsertTrampolines(InstructionList &instructions, const std::vector<bool> &isFarJumps)
+	{
+		std::vector<int64_t> newIndices(instructions.size() + 1);
+		int64_t count = 0;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			newIndices[i] = count;
+			count += isFarJumps[i] ? 3 : 1;
+		}
+		newIndices[instructions.size()] = count;
+
+		InstructionList result;
+		result.reserve(static_cast<size_t>(count));
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			auto instruction = instructions[i];
+			if (BytecodeOptimizePass::IsJumpOpCode(instruction.opCode))
+				instruction.jumpTarget = newIndices[instruction.jumpTarget];
+
+			if (!isFarJumps[i])
+			{
+				result.emplace_back(instruction);
+				continue;
+			}
+
+			Instruction skip;
+			skip.opCode = OP_JUMP;
+			skip.token = instruction.token;
+			skip.jumpTarget = newIndices[i + 1];
+
+			Instruction trampoline;
+			trampoline.opCode = OP_JUMP_LONG;
+			trampoline.token = instruction.token;
+			trampoline.jumpTarget = instruction.jumpTarget;
+
+			instruction.jumpTarget = newIndices[i] + 2;
+			result.emplace_back(instruction);
+			result.emplace_back(skip);
+			result.emplace_back(trampoline);
+		}
+
+		instructions = std::move(result);
+	}
+
+	void BytecodeOptimizePass::Encode(InstructionList &instructions, Chunk &chunk)
+	{
+		std::vector<size_t> offsets;
+
+		// promoting a jump only ever grows the code,so repeat until no more jump needs to be promoted
+		bool isPromoted = true;
+		while (isPromoted)
+		{
+			isPromoted = false;
+			offsets.resize(instructions.size() + 1);
+			std::vector<bool> isFarJumps(instructions.size(), false);
+			bool hasFarJump = false;
+
+			size_t offset = 0;
+			for (size_t i = 0; i < instructions.size(); ++i)
+			{
+				offsets[i] = offset;
+				if (instructions[i].isRemoved)
+					continue;
+				offset += 1 + instructions[i].operands.size() + (IsJumpOpCode(instructions[i].opCode) ? GetJumpOffsetSize(instructions[i].opCode) : 0);
+			}
+			offsets[instructions.size()] = offset;
+
+			for (size_t i = 0; i < instructions.size(); ++i)
+			{
+				auto &instruction = instructions[i];
+				if (instruction.isRemoved || !IsJumpOpCode(instruction.opCode) || IsLongJumpOpCode(instruction.opCode))
+					continue;
+
+				auto next = offsets[i] + 1 + instruction.operands.size() + 2;
+				auto target = offsets[instruction.jumpTarget];
+				size_t address = IsBackwardJumpOpCode(instruction.opCode) ? next - target : target - next;
+				if (address <= UINT16_MAX)
+					continue;
+
+				if (GetLongJumpOpCode(instruction.opCode) != instruction.opCode)
+					instruction.opCode = GetLongJumpOpCode(instruction.opCode);
+				else // the fused jumps(JUMP_IF_FALSE_POP,LESS_LOCAL_CONST_JUMP,FOR_RANGE_INT...) have no long form
+				{
+					isFarJumps[i] = true;
+					hasFarJump = true;
+				}
+				isPromoted = true;
+			}
+
+			if (hasFarJump)
+				InsertTrampolines(instructions, isFarJumps);
+		}
+
+		chunk.opCodes.clear();
+		chunk.opCodeRelatedTokens.clear();
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			const auto &instruction = instructions[i];
+			if (instruction.isRemoved)
+				continue;
+
+			chunk.AddRelatedToken(static_cast<uint32_t>(chunk.opCodes.size()), instruction.token);
+			chunk.opCodes.emplace_back(instruction.opCode);
+			chunk.opCodes.insert(chunk.opCodes.end(), instruction.operands.begin(), instruction.operands.end());
+
+			if (IsJumpOpCode(instruction.opCode))
+			{
+				auto offsetSize = GetJumpOffsetSize(instruction.opCode);
+				auto next = chunk.opCodes.size() + offsetSize;
+				auto target = offsets[instruction.jumpTarget];
+				size_t address = IsBackwardJumpOpCode(instruction.opCode) ? next - target : target - next;
+				if (address > (offsetSize == 2 ? UINT16_MAX : UINT32_MAX))
+					CYS_LOG_ERROR_WITH_LOC(instruction.token, TEXT("Jump offset out of range:{}."), address);
+				for (int32_t shift = (offsetSize - 1) * 8; shift >= 0; shift -= 8)
+					chunk.opCodes.emplace_back((address >> shift) & 0xFF);
+			}
+		}
+	}
+
+	std::vector<uint32_t> BytecodeOptimizePass::StatsJumpTargets(const InstructionList &instructions)
+	{
+		std::vector<uint32_t> result(instructions.size() + 1, 0);
+		for (const auto &instruction : instructions)
+		{
+			if (!instruction.isRemoved && IsJumpOpCode(instruction.opCode))
+				result[instruction.jumpTarget]++;
+		}
+		return result;
+	}
+
+	bool BytecodeOptimizePass::MatchSequence(const InstructionList &instructions, size_t start, const std::vector<uint8_t> &opCodes, std::vector<size_t> &indices)
+	{
+		indices.clear();
+		for (size_t i = start; i < instructions.size() && indices.size() < opCodes.size(); i = NextLiveInstruction(instructions, i))
+		{
+			if (instructions[i].isRemoved || instructions[i].opCode != opCodes[indices.size()])
+				return false;
+			indices.emplace_back(i);
+		}
+		return indices.size() == opCodes.size();
+	}
+
+	size_t BytecodeOptimizePass::NextLiveInstruction(const InstructionList &instructions, size_t idx)
+	{
+		do
+			++idx;
+		while (idx < instructions.size() && instructions[idx].isRemoved);
+		return idx;
+	}
+
+	void BytecodeOptimizePass::ExecuteFunction(FunctionObject *function, std::unordered_set<FunctionObject *> &visited)
+	{
+		if (visited.contains(function))
+			return;
+		visited.insert(function);
+
+		auto instructions = Decode(function->chunk);
+		ExecuteInstructions(instructions);
+		Encode(instructions, function->chunk);
+
+		for (const auto &c : function->chunk.constants)
+		{
+			if (CYS_IS_FUNCTION_VALUE(c))
+				ExecuteFunction(CYS_TO_FUNCTION_VALUE(c), visited);
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
+#include "Chunk.h"
+#include "Object.h"
+namespace CynicScript
+{
+    // a decoded opcode,jump opcodes refer to their target by instruction index instead of a byte offset
+    // so passes can insert,fuse or remove instructions without patching offsets by hand
+    struct Instruction
+    {
+        uint8_t opCode{0};
+        std::vector<uint8_t> operands; // all operands except the trailing 16(or 32 for the long forms) bit jump offset
+        const Token *token{nullptr};
+        int64_t jumpTarget{-1};
+        bool isRemoved{false};
+    };
+
+    using InstructionList = std::vector<Instruction>;
+
+    class BytecodeOptimizePass;
+    template <typename T>
+    concept IsChildOfBytecodeOptimizePass = !std::is_same_v<T, void> &&
+                                            !std::is_abstract_v<T> &&
+                                            std::is_base_of_v<BytecodeOptimizePass, T>;
+
+    class CYS_API BytecodeOptimizePass
+    {
+    public:
+        BytecodeOptimizePass() noexcept = default;
+        virtual ~BytecodeOptimizePass() = default;
+
+        void Execute(FunctionObject *function);
+
+        static bool IsJumpOpCode(uint8_t opCode);
+        static uint32_t GetOperandSize(const Chunk &chunk, size_t offset);
+        // byte offset the jump opcode at offset lands on
+        static size_t GetJumpTarget(const Chunk &chunk, size_t offset);
+        // farJumpTargets:jump opcode offset -> target offset,for jumps whose encoded 16 bit offset was truncated
+        static InstructionList Decode(const Chunk &chunk, const std::unordered_map<uint32_t, uint32_t> &farJumpTargets = {});
+        // jumps that do not fit in 16 bits are promoted to their long forms,the ones without a long form go through a JUMP_LONG trampoline
+        static void Encode(InstructionList &instructions, Chunk &chunk);
+
+    protected:
+        virtual void ExecuteInstructions(InstructionList &instructions) = 0;
+
+        // count how many jumps land on each instruction,a fused sequence must not swallow a jump target
+        static std::vector<uint32_t> StatsJumpTargets(const InstructionList &instructions);
+        // collect the live instructions starting at start if their opcodes match the sequence exactly
+        static bool MatchSequence(const InstructionList &instructions, size_t start, const std::vector<uint8_t> &opCodes, std::vector<size_t> &indices);
+        static size_t NextLiveInstruction(const InstructionList &instructions, size_t idx);
+
+    private:
+        void ExecuteFunction(FunctionObject *function, std::unordered_set<FunctionObject *> &visited);
+    };
+
+    class CYS_API BytecodeOptimizePassManager
+    {
+    public:
+        BytecodeOptimizePassManager() noexcept = default;
+        ~BytecodeOptimizePassManager() noexcept = default;
+
+        template <typename T, typename... Args>
+        requires IsChildOfBytecodeOptimizePass<T>
+            BytecodeOptimizePassManager *Add(Args &&...params) noexcept
+        {
+            for (size_t pos = 0; pos < mPasses.size(); ++pos)
+            {
+                if (dynamic_cast<T *>(mPasses[pos].get())) // ignore already exists pass
+                    return this;
+            }
+
+            mPasses.emplace_back(std::make_unique<T>(std::forward<Args>(params)...));
+            return this;
+        }
+
+        FunctionObject *Execute(FunctionObject *function)
+        {
+            for (auto &pass : mPasses)
+                pass->Execute(function);
+            return function;
+        }
+
+    private:
+        std::vector<std::unique_ptr<BytecodeOptimizePass>> mPasses;
+    };
+}
@@ -1,5 +1,6 @@
 #include "Chunk.h"
 #include <iomanip>
+#include <algorithm>
 #include <sstream>
 #include "Version.h"
 #include "Common.h"
@@ -7,11 +8,137 @@
 #include "Logger.h"
 namespace CynicScript
 {
+	const CHAR_T *GetOpCodeName(uint8_t opCode)
+	{
+#define NAME(opCode) \
+	case opCode:     \
+		return TEXT(#opCode)
+
+		switch (opCode)
+		{
+		NAME(OP_CONSTANT);
+		NAME(OP_NULL);
+		NAME(OP_ADD);
+		NAME(OP_SUB);
+		NAME(OP_MUL);
+		NAME(OP_DIV);
+		NAME(OP_MOD);
+		NAME(OP_EQUAL);
+		NAME(OP_GREATER);
+		NAME(OP_LESS);
+		NAME(OP_NOT);
+		NAME(OP_MINUS);
+		NAME(OP_BIT_AND);
+		NAME(OP_BIT_OR);
+		NAME(OP_BIT_XOR);
+		NAME(OP_BIT_NOT);
+		NAME(OP_BIT_LEFT_SHIFT);
+		NAME(OP_BIT_RIGHT_SHIFT);
+		NAME(OP_RETURN);
+		NAME(OP_FACTORIAL);
+		NAME(OP_ARRAY);
+		NAME(OP_DICT);
+		NAME(OP_GET_INDEX);
+		NAME(OP_SET_INDEX);
+		NAME(OP_JUMP_IF_FALSE);
+		NAME(OP_JUMP);
+		NAME(OP_LOOP);
+		NAME(OP_POP);
+		NAME(OP_SET_GLOBAL);
+		NAME(OP_GET_GLOBAL);
+		NAME(OP_SET_LOCAL);
+		NAME(OP_GET_LOCAL);
+		NAME(OP_GET_UPVALUE);
+		NAME(OP_SET_UPVALUE);
+		NAME(OP_CLOSE_UPVALUE);
+		NAME(OP_REF_GLOBAL);
+		NAME(OP_REF_LOCAL);
+		NAME(OP_REF_INDEX_GLOBAL);
+		NAME(OP_REF_INDEX_LOCAL);
+		NAME(OP_REF_UPVALUE);
+		NAME(OP_REF_INDEX_UPVALUE);
+		NAME(OP_CALL);
+		NAME(OP_CLASS);
+		NAME(OP_CLASS_INSTANCE);
+		NAME(OP_STRUCT);
+		NAME(OP_SET_PROPERTY);
+		NAME(OP_GET_PROPERTY);
+		NAME(OP_GET_BASE);
+		NAME(OP_CLOSURE);
+		NAME(OP_APPREGATE_RESOLVE);
+		NAME(OP_APPREGATE_RESOLVE_VAR_ARG);
+		NAME(OP_MODULE);
+		NAME(OP_INIT_VAR_ARG);
+		NAME(OP_SET_GLOBAL_POP);
+		NAME(OP_SET_LOCAL_POP);
+		NAME(OP_JUMP_IF_FALSE_POP);
+		NAME(OP_INC_LOCAL);
+		NAME(OP_LESS_LOCAL_CONST_JUMP);
+		NAME(OP_ADD_I64);
+		NAME(OP_SUB_I64);
+		NAME(OP_MUL_I64);
+		NAME(OP_DIV_I64);
+		NAME(OP_LESS_I64);
+		NAME(OP_GREATER_I64);
+		NAME(OP_ADD_F64);
+		NAME(OP_SUB_F64);
+		NAME(OP_MUL_F64);
+		NAME(OP_DIV_F64);
+		NAME(OP_LESS_F64);
+		NAME(OP_GREATER_F64);
+		NAME(OP_ADD_INT_QUICK);
+		NAME(OP_ADD_REAL_QUICK);
+		NAME(OP_SUB_INT_QUICK);
+		NAME(OP_SUB_REAL_QUICK);
+		NAME(OP_MUL_INT_QUICK);
+		NAME(OP_MUL_REAL_QUICK);
+		NAME(OP_LESS_INT_QUICK);
+		NAME(OP_LESS_REAL_QUICK);
+		NAME(OP_GREATER_INT_QUICK);
+		NAME(OP_GREATER_REAL_QUICK);
+		NAME(OP_EQUAL_INT_QUICK);
+		NAME(OP_EQUAL_REAL_QUICK);
+		NAME(OP_CONSTANT_LONG);
+		NAME(OP_SET_GLOBAL_LONG);
+		NAME(OP_GET_GLOBAL_LONG);
+		NAME(OP_SET_LOCAL_LONG);
+		NAME(OP_GET_LOCAL_LONG);
+		NAME(OP_CLOSURE_LONG);
+		NAME(OP_JUMP_IF_FALSE_LONG);
+		NAME(OP_JUMP_LONG);
+		NAME(OP_LOOP_LONG);
+		NAME(OP_TAIL_CALL);
+		NAME(OP_FOR_RANGE_INT);
+		NAME(OP_FOR_EACH_ARRAY);
+		NAME(OP_JUMP_IF_TRUE_POP);
+		NAME(OP_SET_LOCAL_LOAD);
+		default:
+			return TEXT("OP_UNKNOWN");
+		}
+#undef NAME
+	}
+
 	Chunk::Chunk(const OpCodeList &opcodes, const std::vector<Value> &constants)
 		: opCodes(opcodes), constants(constants)
 	{
 	}
 
+	void Chunk::AddRelatedToken(uint32_t opCodeOffset, const Token *token)
+	{
+		if (!opCodeRelatedTokens.empty() && opCodeRelatedTokens.back().token == token)
+			return;
+		opCodeRelatedTokens.emplace_back(OpCodeRelatedToken{opCodeOffset, token});
+	}
+
+	const Token *Chunk::GetRelatedToken(uint32_t opCodeOffset) const
+	{
+		auto iter = std::upper_bound(opCodeRelatedTokens.begin(), opCodeRelatedTokens.end(), opCodeOffset, [](uint32_t offset, const OpCodeRelatedToken &entry)
+									 { return offset < entry.opCodeOffset; });
+		if (iter == opCodeRelatedTokens.begin())
+			return nullptr;
+		return (iter - 1)->token;
+	}
+
 #ifndef NDEBUG
 	STRING Chunk::ToString() const
 	{
@@ -33,7 +160,7 @@ namespace CynicScript
 		auto magNumberBytes = ByteConverter::ToU32ByteList(CYS_BINARY_FILE_MAGIC_NUMBER);
 		result.insert(result.end(), magNumberBytes.begin(), magNumberBytes.end());
 
-		auto versionBytes = ByteConverter::ToU32ByteList(CYS_VERSION_BINARY);
+		auto versionBytes = ByteConverter::ToU32ByteList(CYS_BINARY_FORMAT_VERSION);
 		result.insert(result.end(), versionBytes.begin(), versionBytes.end());
 
 		auto opCodeCount = ByteConverter::ToU32ByteList(opCodes.size());
@@ -64,8 +191,8 @@ namespace CynicScript
 			CYS_LOG_ERROR(TEXT("Invalid CynicScript binary file,cannot deserialize from this file"));
 
 		auto versionNumber = ByteConverter::GetU32Integer(data, 4);
-		if (versionNumber != CYS_VERSION_BINARY)
-			CYS_LOG_ERROR(TEXT("Invalid CynicScript binary file version of {},current version is {}"), versionNumber, CYS_VERSION_BINARY);
+		if (versionNumber != CYS_BINARY_FORMAT_VERSION)
+			CYS_LOG_ERROR(TEXT("Invalid CynicScript binary file format version of {},current version is {}"), versionNumber, CYS_BINARY_FORMAT_VERSION);
 
 		auto opCodesCount = ByteConverter::GetU32Integer(data, 8);
 
@@ -95,7 +222,7 @@ namespace CynicScript
 	case opCode:                                                                                                              \
 	{                                                                                                                         \
 		auto instrLoc = i;                                                                                                    \
-		auto tok = opCodeRelatedTokens[opcodes[++i]];                                                                         \
+		auto tok = GetRelatedToken(i);                                                                                        \
 		auto tokStr = tok->ToString();                                                                                        \
 		STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));                                                          \
 		tokStr += tokGap;                                                                                                     \
@@ -107,12 +234,27 @@ namespace CynicScript
 	case opCode:                                                                                                                                                                   \
 	{                                                                                                                                                                              \
 		auto instrLoc = i;                                                                                                                                                         \
-		auto tok = opCodeRelatedTokens[opcodes[++i]];                                                                                                                              \
-		uint16_t addressOffset = opcodes[++i] << 8 | opcodes[++i];                                                                                                                 \
+		auto tok = GetRelatedToken(i);                                                                                                                                             \
+		uint16_t addressOffset = opcodes[i + 1] << 8 | opcodes[i + 2];                                                                                                             \
+		i += 2;                                                                                                                                                                    \
+		auto tokStr = tok->ToString();                                                                                                                                             \
+		STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));                                                                                                               \
+		tokStr += tokGap;                                                                                                                                                          \
+		stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << TEXT("\t") << TEXT(#opCode) << TEXT("\t") << i << "->" << i + 1 op addressOffset << std::endl; \
+		break;                                                                                                                                                                     \
+	}
+
+#define CASE_JUMP_LONG(opCode, op)                                                                                                                                                 \
+	case opCode:                                                                                                                                                                   \
+	{                                                                                                                                                                              \
+		auto instrLoc = i;                                                                                                                                                         \
+		auto tok = GetRelatedToken(i);                                                                                                                                             \
+		uint32_t addressOffset = opcodes[i + 1] << 24 | opcodes[i + 2] << 16 | opcodes[i + 3] << 8 | opcodes[i + 4];                                                               \
+		i += 4;                                                                                                                                                                    \
 		auto tokStr = tok->ToString();                                                                                                                                             \
 		STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));                                                                                                               \
 		tokStr += tokGap;                                                                                                                                                          \
-		stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << TEXT("\t") << TEXT(#opCode) << TEXT("\t") << i << "->" << i op addressOffset + 3 << std::endl; \
+		stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << TEXT("\t") << TEXT(#opCode) << TEXT("\t") << i << "->" << i + 1 op addressOffset << std::endl; \
 		break;                                                                                                                                                                     \
 	}
 
@@ -120,7 +262,7 @@ namespace CynicScript
 	case opCode:                                                                                                                                   \
 	{                                                                                                                                              \
 		auto instrLoc = i;                                                                                                                         \
-		auto tok = opCodeRelatedTokens[opcodes[++i]];                                                                                              \
+		auto tok = GetRelatedToken(i);                                                                                                             \
 		auto pos = opcodes[++i];                                                                                                                   \
 		auto tokStr = tok->ToString();                                                                                                             \
 		STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));                                                                               \
@@ -129,6 +271,20 @@ namespace CynicScript
 		break;                                                                                                                                     \
 	}
 
+#define CASE_2(opCode)                                                                                                                             \
+	case opCode:                                                                                                                                   \
+	{                                                                                                                                              \
+		auto instrLoc = i;                                                                                                                         \
+		auto tok = GetRelatedToken(i);                                                                                                             \
+		uint16_t pos = opcodes[i + 1] << 8 | opcodes[i + 2];                                                                                       \
+		i += 2;                                                                                                                                    \
+		auto tokStr = tok->ToString();                                                                                                             \
+		STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));                                                                               \
+		tokStr += tokGap;                                                                                                                          \
+		stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << TEXT("\t") << TEXT(#opCode) << TEXT("\t") << pos << std::endl; \
+		break;                                                                                                                                     \
+	}
+
 		const uint32_t maxTokenShowSize = GetBiggestTokenLength() + 4; // 4 for a gap "    "
 		STRING_STREAM stream;
 		for (int32_t i = 0; i < opcodes.size(); ++i)
@@ -160,9 +316,38 @@ namespace CynicScript
 				CASE(OP_SET_PROPERTY)
 				CASE(OP_GET_PROPERTY)
 				CASE(OP_CLASS_INSTANCE)
+				CASE(OP_ADD_I64)
+				CASE(OP_SUB_I64)
+				CASE(OP_MUL_I64)
+				CASE(OP_DIV_I64)
+				CASE(OP_LESS_I64)
+				CASE(OP_GREATER_I64)
+				CASE(OP_ADD_F64)
+				CASE(OP_SUB_F64)
+				CASE(OP_MUL_F64)
+				CASE(OP_DIV_F64)
+				CASE(OP_LESS_F64)
+				CASE(OP_GREATER_F64)
+				CASE(OP_ADD_INT_QUICK)
+				CASE(OP_ADD_REAL_QUICK)
+				CASE(OP_SUB_INT_QUICK)
+				CASE(OP_SUB_REAL_QUICK)
+				CASE(OP_MUL_INT_QUICK)
+				CASE(OP_MUL_REAL_QUICK)
+				CASE(OP_LESS_INT_QUICK)
+				CASE(OP_LESS_REAL_QUICK)
+				CASE(OP_GREATER_INT_QUICK)
+				CASE(OP_GREATER_REAL_QUICK)
+				CASE(OP_EQUAL_INT_QUICK)
+				CASE(OP_EQUAL_REAL_QUICK)
 				CASE_JUMP(OP_JUMP_IF_FALSE, +)
 				CASE_JUMP(OP_JUMP, +)
 				CASE_JUMP(OP_LOOP, -)
+				CASE_JUMP(OP_JUMP_IF_FALSE_POP, +)
+				CASE_JUMP(OP_JUMP_IF_TRUE_POP, +)
+				CASE_JUMP_LONG(OP_JUMP_IF_FALSE_LONG, +)
+				CASE_JUMP_LONG(OP_JUMP_LONG, +)
+				CASE_JUMP_LONG(OP_LOOP_LONG, -)
 				CASE_1(OP_RETURN)
 				CASE_1(OP_ARRAY)
 				CASE_1(OP_DICT)
@@ -179,27 +364,38 @@ namespace CynicScript
 				CASE_1(OP_REF_UPVALUE)
 				CASE_1(OP_REF_INDEX_UPVALUE)
 				CASE_1(OP_CALL)
+				CASE_1(OP_TAIL_CALL)
 				CASE_1(OP_STRUCT)
 				CASE_1(OP_APPREGATE_RESOLVE)
 				CASE_1(OP_APPREGATE_RESOLVE_VAR_ARG)
 				CASE_1(OP_INIT_VAR_ARG)
+				CASE_1(OP_SET_GLOBAL_POP)
+				CASE_1(OP_SET_LOCAL_POP)
+				CASE_1(OP_SET_LOCAL_LOAD)
+				CASE_2(OP_SET_GLOBAL_LONG)
+				CASE_2(OP_GET_GLOBAL_LONG)
+				CASE_2(OP_SET_LOCAL_LONG)
+				CASE_2(OP_GET_LOCAL_LONG)
 			case OP_CONSTANT:
+			case OP_CONSTANT_LONG:
 			{
 				auto instrLoc = i;
-				auto tok = opCodeRelatedTokens[opcodes[++i]];
-				auto pos = opcodes[++i];
+				auto tok = GetRelatedToken(i);
+				auto isLong = opcodes[i] == OP_CONSTANT_LONG;
+				uint32_t pos = isLong ? (opcodes[i + 1] << 8 | opcodes[i + 2]) : opcodes[i + 1];
+				i += isLong ? 2 : 1;
 				STRING constantStr = constants[pos].ToString();
 
 				auto tokStr = tok->ToString();
 				STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));
 				tokStr += tokGap;
-				stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << TEXT("\tOP_CONSTANT\t") << pos << TEXT("\t'") << constantStr << TEXT("'") << std::endl;
+				stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << (isLong ? TEXT("\tOP_CONSTANT_LONG\t") : TEXT("\tOP_CONSTANT\t")) << pos << TEXT("\t'") << constantStr << TEXT("'") << std::endl;
 				break;
 			}
 			case OP_CLASS:
 			{
 				auto instrLoc = i;
-				auto tok = opCodeRelatedTokens[opcodes[++i]];
+				auto tok = GetRelatedToken(i);
 				auto constructorCount = opcodes[++i];
 				auto parentClassCount = opcodes[++i];
 				auto varCount = opcodes[++i];
@@ -213,17 +409,20 @@ namespace CynicScript
 				break;
 			}
 			case OP_CLOSURE:
+			case OP_CLOSURE_LONG:
 			{
 				auto instrLoc = i;
-				auto tok = opCodeRelatedTokens[opcodes[++i]];
-				auto pos = opcodes[++i];
+				auto tok = GetRelatedToken(i);
+				auto isLong = opcodes[i] == OP_CLOSURE_LONG;
+				uint32_t pos = isLong ? (opcodes[i + 1] << 8 | opcodes[i + 2]) : opcodes[i + 1];
+				i += isLong ? 2 : 1;
 				STRING funcStr = (TEXT("<fn ") + CYS_TO_FUNCTION_VALUE(constants[pos])->name + TEXT(":0x") + PointerAddressToString((void *)CYS_TO_FUNCTION_VALUE(constants[pos])) + TEXT(">"));
 
 				auto tokStr = tok->ToString();
 				STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));
 				tokStr += tokGap;
 
-				stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << i << TEXT("\tOP_CLOSURE\t") << pos << TEXT("\t") << funcStr << std::endl;
+				stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << i << (isLong ? TEXT("\tOP_CLOSURE_LONG\t") : TEXT("\tOP_CLOSURE\t")) << pos << TEXT("\t") << funcStr << std::endl;
 
 				auto upvalueCount = CYS_TO_FUNCTION_VALUE(constants[pos])->upValueCount;
 				if (upvalueCount > 0)
@@ -238,10 +437,51 @@ namespace CynicScript
 				}
 				break;
 			}
+			case OP_INC_LOCAL:
+			{
+				auto instrLoc = i;
+				auto tok = GetRelatedToken(i);
+				auto slot = opcodes[++i];
+				auto pos = opcodes[++i];
+				auto tokStr = tok->ToString();
+				STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));
+				tokStr += tokGap;
+				stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << TEXT("\tOP_INC_LOCAL\t") << slot << TEXT("\t") << pos << TEXT("\t'") << constants[pos].ToString() << TEXT("'") << std::endl;
+				break;
+			}
+			case OP_LESS_LOCAL_CONST_JUMP:
+			{
+				auto instrLoc = i;
+				auto tok = GetRelatedToken(i);
+				auto slot = opcodes[i + 1];
+				auto pos = opcodes[i + 2];
+				uint16_t addressOffset = opcodes[i + 3] << 8 | opcodes[i + 4];
+				i += 4;
+				auto tokStr = tok->ToString();
+				STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));
+				tokStr += tokGap;
+				stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << TEXT("\tOP_LESS_LOCAL_CONST_JUMP\t") << slot << TEXT("\t") << pos << TEXT("\t'") << constants[pos].ToString() << TEXT("'\t") << i << "->" << i + 1 + addressOffset << std::endl;
+				break;
+			}
+			case OP_FOR_RANGE_INT:
+			case OP_FOR_EACH_ARRAY:
+			{
+				auto instrLoc = i;
+				auto tok = GetRelatedToken(i);
+				uint32_t slot = opcodes[i + 1];
+				uint16_t addressOffset = opcodes[i + 2] << 8 | opcodes[i + 3];
+				auto opName = opcodes[i] == OP_FOR_RANGE_INT ? TEXT("\tOP_FOR_RANGE_INT\t") : TEXT("\tOP_FOR_EACH_ARRAY\t");
+				i += 3;
+				auto tokStr = tok->ToString();
+				STRING tokGap(maxTokenShowSize - tokStr.size(), TCHAR(' '));
+				tokStr += tokGap;
+				stream << tokStr << std::setfill(TCHAR('0')) << std::setw(8) << instrLoc << opName << slot << TEXT("\t") << i << "->" << i + 1 + addressOffset << std::endl;
+				break;
+			}
 			case OP_MODULE:
 			{
 				auto instrLoc = i;
-				auto tok = opCodeRelatedTokens[opcodes[++i]];
+				auto tok = GetRelatedToken(i);
 				auto varCount = opcodes[++i];
 				auto constCount = opcodes[++i];
 				auto tokStr = tok->ToString();
@@ -263,7 +503,7 @@ namespace CynicScript
 		uint32_t length = 0;
 		for (const auto &t : opCodeRelatedTokens)
 		{
-			auto l = (uint32_t)t->ToString().size();
+			auto l = (uint32_t)t.token->ToString().size();
 			if (length < l)
 				length = l;
 		}
@@ -59,10 +59,85 @@ namespace CynicScript
         OP_APPREGATE_RESOLVE_VAR_ARG,
         OP_MODULE,
         OP_INIT_VAR_ARG,
+        // super instructions,only emitted by SuperInstructionPass
+        OP_SET_GLOBAL_POP,
+        OP_SET_LOCAL_POP,
+        OP_JUMP_IF_FALSE_POP,
+        OP_INC_LOCAL,
+        OP_LESS_LOCAL_CONST_JUMP,
+        // type specialized arithmetic,only emitted when TypeCheckAndResolvePass proved both operand kinds
+        OP_ADD_I64,
+        OP_SUB_I64,
+        OP_MUL_I64,
+        OP_DIV_I64,
+        OP_LESS_I64,
+        OP_GREATER_I64,
+        OP_ADD_F64,
+        OP_SUB_F64,
+        OP_MUL_F64,
+        OP_DIV_F64,
+        OP_LESS_F64,
+        OP_GREATER_F64,
+        // quickened opcodes,only written by the vm at runtime in place of a hot generic opcode of the same size
+        OP_ADD_INT_QUICK,
+        OP_ADD_REAL_QUICK,
+        OP_SUB_INT_QUICK,
+        OP_SUB_REAL_QUICK,
+        OP_MUL_INT_QUICK,
+        OP_MUL_REAL_QUICK,
+        OP_LESS_INT_QUICK,
+        OP_LESS_REAL_QUICK,
+        OP_GREATER_INT_QUICK,
+        OP_GREATER_REAL_QUICK,
+        OP_EQUAL_INT_QUICK,
+        OP_EQUAL_REAL_QUICK,
+        // long forms,the compiler only picks them when an index does not fit in 8 bits(read as 16 bits)
+        // or a jump offset does not fit in 16 bits(read as 32 bits)
+        OP_CONSTANT_LONG,
+        OP_SET_GLOBAL_LONG,
+        OP_GET_GLOBAL_LONG,
+        OP_SET_LOCAL_LONG,
+        OP_GET_LOCAL_LONG,
+        OP_CLOSURE_LONG,
+        OP_JUMP_IF_FALSE_LONG,
+        OP_JUMP_LONG,
+        OP_LOOP_LONG,
+        OP_TAIL_CALL, // a call in tail position,reuses the caller's frame
+        OP_FOR_RANGE_INT,
+        OP_FOR_EACH_ARRAY,
+        // only emitted by PeepholePass
+        OP_JUMP_IF_TRUE_POP, // NOT JUMP_IF_FALSE_POP,the condition has to be a bool just like for NOT
+        OP_SET_LOCAL_LOAD,   // SET_LOCAL_POP GET_LOCAL of the same slot
     };
 
     using OpCodeList = std::vector<uint8_t>;
 
+    // the enumerator's name,like TEXT("OP_ADD"),or TEXT("OP_UNKNOWN") for bytes that are not an opcode
+    CYS_API const CHAR_T *GetOpCodeName(uint8_t opCode);
+
+    // run-length encoded line table,one entry covers every opcode from opCodeOffset up to the next entry's opCodeOffset
+    struct OpCodeRelatedToken
+    {
+        uint32_t opCodeOffset{0};
+        const Token *token{nullptr};
+    };
+
+    // an opcode unpacked for the interpreter,see VM::Predecode.the operand bytes are copied in encoded order,
+    // so the 8 bit counts(CALL,RETURN,ARRAY,CLASS...) are read from operands directly
+    struct DecodedInstruction
+    {
+        uint8_t opCode{0};
+        uint8_t operands[7]{};
+        uint32_t offset{0};             // of the opcode in Chunk::opCodes
+        uint32_t index{0};              // the 8 or 16 bit constant,global,local or upvalue index,or the quicken site/property cache of the opcode
+        const Value *constant{nullptr}; // constant operand of CONSTANT,CLOSURE,INC_LOCAL and LESS_LOCAL_CONST_JUMP
+        union
+        {
+            DecodedInstruction *target{nullptr}; // jumps land here instead of at a relative byte offset
+            const uint8_t *upvalues;             // the index,depth pairs of CLOSURE
+        };
+    };
+
     class CYS_API Chunk
     {
     public:
@@ -72,12 +147,15 @@ namespace CynicScript
 #ifndef NDEBUG
         STRING ToString() const;
 #endif
+        void AddRelatedToken(uint32_t opCodeOffset, const Token *token);
+        const Token *GetRelatedToken(uint32_t opCodeOffset) const;
+
         std::vector<uint8_t> Serialize() const;
         void Deserialize(const std::vector<uint8_t> &data);
 
         OpCodeList opCodes;
         std::vector<Value> constants;
-        std::vector<const Token *> opCodeRelatedTokens;
+        std::vector<OpCodeRelatedToken> opCodeRelatedTokens;
 
     private:
         STRING OpCodeToString(const OpCodeList &opcodes) const;
@@ -4,6 +4,7 @@
 #include <codecvt>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 #include "Allocator.h"
 #include "LibraryManager.h"
 
@@ -230,6 +231,140 @@ namespace CynicScript
         return mSerializeBinaryFilePath;
     }
 
+    void Config::SetEmitCppFilePath(std::string_view path)
+    {
+        mEmitCppFilePath = path;
+    }
+
+    std::string_view Config::GetEmitCppFilePath() const
+    {
+        return mEmitCppFilePath;
+    }
+
+    void Config::SetNativeModulePath(std::string_view path)
+    {
+        mNativeModulePath = path;
+    }
+
+    std::string_view Config::GetNativeModulePath() const
+    {
+        return mNativeModulePath;
+    }
+
+    void Config::SetProfileSampleFrequency(uint32_t frequency)
+    {
+        mProfileSampleFrequency = frequency;
+    }
+
+    uint32_t Config::GetProfileSampleFrequency() const
+    {
+        return mProfileSampleFrequency;
+    }
+
+    void Config::SetProfileSampleFilePath(std::string_view path)
+    {
+        mProfileSampleFilePath = path;
+    }
+
+    std::string_view Config::GetProfileSampleFilePath() const
+    {
+        return mProfileSampleFilePath;
+    }
+
+    void Config::SetShowQuickenStats(bool toggle)
+    {
+        mShowQuickenStats = toggle;
+    }
+
+    bool Config::IsShowQuickenStats() const
+    {
+        return mShowQuickenStats;
+    }
+
+    void Config::SetBackend(Backend backend)
+    {
+        mBackend = backend;
+    }
+
+    Config::Backend Config::GetBackend() const
+    {
+        return mBackend;
+    }
+
+    void Config::SetGCPauseBudget(uint32_t microseconds)
+    {
+        mGCPauseBudget = microseconds;
+    }
+
+    uint32_t Config::GetGCPauseBudget() const
+    {
+        return mGCPauseBudget;
+    }
+
+    void Config::SetGCMarkThreadCount(uint32_t count)
+    {
+        mGCMarkThreadCount = std::max<uint32_t>(count, 1);
+    }
+
+    uint32_t Config::GetGCMarkThreadCount() const
+    {
+        return mGCMarkThreadCount;
+    }
+
+    void Config::SetGCConcurrentSweep(bool toggle)
+    {
+        mIsGCConcurrentSweep = toggle;
+    }
+
+    bool Config::IsGCConcurrentSweep() const
+    {
+        return mIsGCConcurrentSweep;
+    }
+
+#ifdef CYS_JIT
+    void Config::SetUseJit(bool toggle)
+    {
+        mUseJit = toggle;
+    }
+
+    bool Config::IsUseJit() const
+    {
+        return mUseJit;
+    }
+#endif
+
+#ifdef CYS_OPCODE_PROFILE
+    void Config::SetProfileOpCodes(bool toggle)
+    {
+        mProfileOpCodes = toggle;
+    }
+
+    bool Config::IsProfileOpCodes() const
+    {
+        return mProfileOpCodes;
+    }
+
+    void Config::SetProfileOpCodeCycles(bool toggle)
+    {
+        mProfileOpCodeCycles = toggle;
+    }
+
+    bool Config::IsProfileOpCodeCycles() const
+    {
+        return mProfileOpCodeCycles;
+    }
+
+    void Config::SetProfileOpCodesFilePath(std::string_view path)
+    {
+        mProfileOpCodesFilePath = path;
+    }
+
+    std::string_view Config::GetProfileOpCodesFilePath() const
+    {
+        return mProfileOpCodesFilePath;
+    }
+#endif
+
     std::string Config::ToFullPath(std::string_view filePath)
     {
         std::filesystem::path filesysPath = filePath;
@@ -5,12 +5,20 @@
 #include <vector>
 #include <array>
 
-#define STACK_MAX 1024
+#define STACK_INIT_SIZE 256
+#define STACK_MAX (1024 * 1024) // a deeper value stack is reported as a stack overflow
+#define CALL_FRAME_INIT_SIZE 64
+#define CALL_FRAME_MAX (256 * 1024)
 #define GLOBAL_VARIABLE_MAX 512
 
 #define UINT8_COUNT (UINT8_MAX + 1)
 
 #define GC_HEAP_GROW_FACTOR 2
+// a minor collection marks every global and the whole value stack,not only the frames pushed since the last one,
+// so its cost has a floor of the root set size.a small nursery makes that floor dominate for deep stacks or many globals
+#define GC_NURSERY_SIZE (256 * 1024) // bytes allocated between two minor collections
+#define GC_STEP_SIZE (16 * 1024)     // bytes allocated between two slices of an incremental major collection
+#define GC_MARK_SHARE_SIZE 64        // a parallel mark worker only hands gray objects out while it holds more than this
 
 #ifndef CYS_BUILD_STATIC
 #if defined(_WIN32) || defined(_WIN64)
@@ -163,6 +171,46 @@ namespace CynicScript
         void SetSerializeBinaryFilePath(std::string_view path);
         std::string_view GetSerializeBinaryFilePath() const;
 
+        void SetEmitCppFilePath(std::string_view path);
+        std::string_view GetEmitCppFilePath() const;
+
+        void SetNativeModulePath(std::string_view path);
+        std::string_view GetNativeModulePath() const;
+
+        // samples per second of cpu time,0 turns the sampling profiler off
+        void SetProfileSampleFrequency(uint32_t frequency);
+        uint32_t GetProfileSampleFrequency() const;
+
+        void SetProfileSampleFilePath(std::string_view path);
+        std::string_view GetProfileSampleFilePath() const;
+
+        void SetShowQuickenStats(bool toggle);
+        bool IsShowQuickenStats() const;
+
+        // which vm runs a function:always the stack vm,the register vm whenever the function translates,
+        // or the register vm only for the functions whose register code is clearly shorter
+        enum class Backend : uint8_t
+        {
+            STACK,
+            REGISTER,
+            AUTO,
+        };
+        void SetBackend(Backend backend);
+        Backend GetBackend() const;
+
+        // the most time a major collection may take at once,it is then spread over the allocations in slices this long.
+        // 0 runs every major collection to completion
+        void SetGCPauseBudget(uint32_t microseconds);
+        uint32_t GetGCPauseBudget() const;
+
+        // threads marking the heap in a major collection,the vm thread included.1 marks on the vm thread alone
+        void SetGCMarkThreadCount(uint32_t count);
+        uint32_t GetGCMarkThreadCount() const;
+
+        // sweep the old generation on a background thread,the vm goes on right after the marking
+        void SetGCConcurrentSweep(bool toggle);
+        bool IsGCConcurrentSweep() const;
+
         std::string ToFullPath(std::string_view filePath);
 
     private:
@@ -173,6 +221,47 @@ namespace CynicScript
         bool mIsSerializeBinaryChunk{false};
         std::string_view mSerializeBinaryFilePath;
 
+        std::string_view mEmitCppFilePath;
+        std::string_view mNativeModulePath;
+
+        uint32_t mProfileSampleFrequency{0};
+        std::string_view mProfileSampleFilePath{"profile.folded"};
+
+        bool mShowQuickenStats{false};
+
+        Backend mBackend{Backend::STACK};
+
+        uint32_t mGCPauseBudget{0};
+        uint32_t mGCMarkThreadCount{1};
+        bool mIsGCConcurrentSweep{false};
+
+#ifdef CYS_JIT
+    public:
+        void SetUseJit(bool toggle);
+        bool IsUseJit() const;
+
+    private:
+        bool mUseJit{true};
+#endif
+
+#ifdef CYS_OPCODE_PROFILE
+    public:
+        void SetProfileOpCodes(bool toggle);
+        bool IsProfileOpCodes() const;
+
+        void SetProfileOpCodeCycles(bool toggle);
+        bool IsProfileOpCodeCycles() const;
+
+        // the report is written here as json instead of printed as a table
+        void SetProfileOpCodesFilePath(std::string_view path);
+        std::string_view GetProfileOpCodesFilePath() const;
+
+    private:
+        bool mProfileOpCodes{false};
+        bool mProfileOpCodeCycles{false};
+        std::string_view mProfileOpCodesFilePath;
+#endif
+
 #ifndef NDEBUG
     public:
         void SetDebugGC(bool toggle);
@@ -4,6 +4,7 @@
 #include "LibraryManager.h"
 #include "Logger.h"
 #include "Allocator.h"
+#include "BytecodeOptimizePass.h"
 namespace CynicScript
 {
 	enum class SymbolLocation
@@ -31,7 +32,7 @@ namespace CynicScript
 		STRING name;
 		SymbolLocation location = SymbolLocation::GLOBAL;
 		Permission permission = Permission::IMMUTABLE;
-		uint8_t index = 0;
+		uint16_t index = 0;
 		int8_t scopeDepth = -1;
 		FunctionSymbolInfo functionSymInfo;
 		UpValue upvalue; // available only while type is SymbolLocation::UPVALUE
@@ -42,11 +43,11 @@ namespace CynicScript
 	{
 	public:
 		SymbolTable()
-			: mSymbolCount(0), mGlobalSymbolCount(0), mLocalSymbolCount(0), mUpValueCount(0), enclosing(nullptr), mScopeDepth(0), mTableDepth(0)
+			: mSymbols(UINT8_COUNT), mSymbolCount(0), mGlobalSymbolCount(0), mLocalSymbolCount(0), mUpValueCount(0), enclosing(nullptr), mScopeDepth(0), mTableDepth(0)
 		{
 		}
 		SymbolTable(SymbolTable *enclosing)
-			: mSymbolCount(0), mGlobalSymbolCount(0), mLocalSymbolCount(0), mUpValueCount(0), enclosing(enclosing)
+			: mSymbols(UINT8_COUNT), mSymbolCount(0), mGlobalSymbolCount(0), mLocalSymbolCount(0), mUpValueCount(0), enclosing(enclosing)
 		{
 			mScopeDepth = enclosing->mScopeDepth + 1;
 			mTableDepth = enclosing->mTableDepth + 1;
@@ -58,9 +59,11 @@ namespace CynicScript
 
 		Symbol Define(const Token *relatedToken, Permission permission, const STRING &name, const FunctionSymbolInfo &functionInfo = {})
 		{
-			if (mSymbolCount >= mSymbols.size())
+			if (mSymbolCount > UINT16_MAX)
 				CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Too many symbols in current scope."));
-			for (int16_t i = mSymbolCount - 1; i >= 0; --i)
+			if (mSymbolCount >= mSymbols.size())
+				mSymbols.resize(mSymbols.size() * 2);
+			for (int32_t i = mSymbolCount - 1; i >= 0; --i)
 			{
 				auto isSameParamCount = (mSymbols[i].functionSymInfo.paramCount < 0 || functionInfo.paramCount < 0) ? true : mSymbols[i].functionSymInfo.paramCount == functionInfo.paramCount;
 				if (mSymbols[i].scopeDepth == -1 || mSymbols[i].scopeDepth < mScopeDepth)
@@ -92,7 +95,7 @@ namespace CynicScript
 		Symbol Resolve(const Token *relatedToken, const STRING &name, int8_t paramCount = -1, int8_t d = 0)
 		{
 
-			for (int16_t i = mSymbolCount - 1; i >= 0; --i)
+			for (int32_t i = mSymbolCount - 1; i >= 0; --i)
 			{
 				auto isSameParamCount = (mSymbols[i].functionSymInfo.paramCount < 0 || paramCount < 0) ? true : mSymbols[i].functionSymInfo.paramCount == paramCount;
 
@@ -116,6 +119,8 @@ namespace CynicScript
 				Symbol result = enclosing->Resolve(relatedToken, name, paramCount, ++d);
 				if (d > 0 && result.location != SymbolLocation::GLOBAL)
 				{
+					if (result.index > UINT8_MAX)
+						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Cannot capture \"{}\",its slot index exceeds {}."), name, UINT8_MAX);
 					result.location = SymbolLocation::UPVALUE;
 					result.upvalue = AddUpValue(relatedToken, result.index, enclosing->mTableDepth);
 				}
@@ -126,10 +131,10 @@ namespace CynicScript
 			return Symbol(); // Return an empty symbol, this should never be reached
 		}
 
-		std::array<Symbol, UINT8_COUNT> mSymbols;
-		uint8_t mSymbolCount;
-		uint8_t mGlobalSymbolCount;
-		uint8_t mLocalSymbolCount;
+		std::vector<Symbol> mSymbols; // grows on demand,indices up to UINT16_MAX are addressable by the long opcodes
+		uint32_t mSymbolCount;
+		uint32_t mGlobalSymbolCount;
+		uint32_t mLocalSymbolCount;
 		std::array<UpValue, UINT8_COUNT> mUpValues;
 		int32_t mUpValueCount;
 		uint8_t mScopeDepth; // Depth of scope nesting(related to code {} scope)
@@ -180,6 +185,9 @@ namespace CynicScript
 			CompileDeclAndStmt(stmt);
 
 		EmitReturn(0, stmt->tagToken);
+		WidenFarJumps();
+
+		Allocator::GetInstance()->EnsureGlobalVariableCount(mSymbolTable->mGlobalSymbolCount);
 
 		return CurFunction();
 	}
@@ -190,6 +198,7 @@ namespace CynicScript
 
 		mCurContinueStmtAddress = -1;
 		mCurBreakStmtAddress = -1;
+		mCurLoopScopeDepth = 0;
 
 		mFunctionList.emplace_back(new FunctionObject(MAIN_ENTRY_FUNCTION_NAME));
 
@@ -338,6 +347,10 @@ namespace CynicScript
 		Emit(constCount);
 
 		EmitReturn(1, decl->tagToken);
+		WidenFarJumps();
+
+		if (mSymbolTable->mSymbolCount > UINT8_MAX)
+			CYS_LOG_ERROR_WITH_LOC(decl->tagToken, TEXT("Too many symbols in module:{}."), symbol.name);
 
 		auto function = mFunctionList.back();
 		function->arity = mSymbolTable->mSymbolCount;
@@ -399,6 +412,9 @@ namespace CynicScript
 		case AstKind::WHILE:
 			CompileWhileStmt((WhileStmt *)stmt);
 			break;
+		case AstKind::FOR_IN:
+			CompileForInStmt((ForInStmt *)stmt);
+			break;
 		case AstKind::RETURN:
 			CompileReturnStmt((ReturnStmt *)stmt);
 			break;
@@ -480,8 +496,12 @@ namespace CynicScript
 
 		EmitOpCode(OP_POP, stmt->condition->tagToken);
 
+		auto prevContinueStmtAddress = mCurContinueStmtAddress;
+		auto prevBreakStmtAddress = mCurBreakStmtAddress;
+		auto prevLoopScopeDepth = mCurLoopScopeDepth;
 		mCurContinueStmtAddress = -1;
 		mCurBreakStmtAddress = -1;
+		mCurLoopScopeDepth = mSymbolTable->mScopeDepth;
 
 		CompileStmt(stmt->body);
 
@@ -499,16 +519,96 @@ namespace CynicScript
 		if (mCurBreakStmtAddress != -1)
 			PatchJump(mCurBreakStmtAddress);
 
+		mCurContinueStmtAddress = prevContinueStmtAddress;
+		mCurBreakStmtAddress = prevBreakStmtAddress;
+		mCurLoopScopeDepth = prevLoopScopeDepth;
+	}
+	// the loop keeps its state in three consecutive hidden locals that the for opcode reads by the first slot:
+	// range:    counter,end,loop variable
+	// iterable: iterable,index,loop variable
+	void Compiler::CompileForInStmt(ForInStmt *stmt)
+	{
+		EnterScope();
+
+		OpCode forOpCode;
+		if (stmt->iterable)
+		{
+			forOpCode = OP_FOR_EACH_ARRAY;
+			CompileExpr(stmt->iterable);
+			mSymbolTable->Define(stmt->tagToken, Permission::IMMUTABLE, TEXT("(for iterable)"));
+			EmitConstant((int64_t)0, stmt->tagToken);
+			mSymbolTable->Define(stmt->tagToken, Permission::IMMUTABLE, TEXT("(for index)"));
+		}
+		else
+		{
+			forOpCode = OP_FOR_RANGE_INT;
+			if (stmt->rangeBegin)
+				CompileExpr(stmt->rangeBegin);
+			else
+				EmitConstant((int64_t)0, stmt->tagToken);
+			mSymbolTable->Define(stmt->tagToken, Permission::IMMUTABLE, TEXT("(for counter)"));
+			CompileExpr(stmt->rangeEnd);
+			mSymbolTable->Define(stmt->tagToken, Permission::IMMUTABLE, TEXT("(for end)"));
+		}
+
+		EmitOpCode(OP_NULL, stmt->variable->tagToken);
+		auto variable = mSymbolTable->Define(stmt->variable->tagToken, stmt->permission, ((IdentifierExpr *)stmt->variable->name)->literal);
+		auto variableSymbolIndex = mSymbolTable->mSymbolCount - 1;
+		auto stateSlot = variable.index - 2;
+		if (stateSlot > UINT8_MAX)
+			CYS_LOG_ERROR_WITH_LOC(stmt->tagToken, TEXT("Too many local variables before for-in stmt."));
+
+		auto loopAddress = CurOpCodeList().size();
+		EmitOpCode(forOpCode, stmt->tagToken);
+		Emit(static_cast<uint8_t>(stateSlot));
+		auto exitAddress = Emit(0xFF);
+		Emit(0xFF);
+
+		auto prevContinueStmtAddress = mCurContinueStmtAddress;
+		auto prevBreakStmtAddress = mCurBreakStmtAddress;
+		auto prevLoopScopeDepth = mCurLoopScopeDepth;
 		mCurContinueStmtAddress = -1;
 		mCurBreakStmtAddress = -1;
+		mCurLoopScopeDepth = mSymbolTable->mScopeDepth;
+
+		CompileStmt(stmt->body);
+
+		if (mCurContinueStmtAddress != -1)
+			PatchJump(mCurContinueStmtAddress);
+
+		// a captured loop variable is closed at the end of every iteration and replaced by a fresh slot,
+		// so each closure created in the body keeps the element of its own iteration
+		if (mSymbolTable->mSymbols[variableSymbolIndex].isCaptured)
+		{
+			EmitOpCode(OP_CLOSE_UPVALUE, stmt->variable->tagToken);
+			EmitOpCode(OP_NULL, stmt->variable->tagToken);
+		}
+
+		EmitLoop(loopAddress, stmt->tagToken);
+
+		PatchJump(exitAddress, 1);
+
+		if (mCurBreakStmtAddress != -1)
+			PatchJump(mCurBreakStmtAddress);
+
+		mCurContinueStmtAddress = prevContinueStmtAddress;
+		mCurBreakStmtAddress = prevBreakStmtAddress;
+		mCurLoopScopeDepth = prevLoopScopeDepth;
+
+		ExitScope();
 	}
+
 	void Compiler::CompileReturnStmt(ReturnStmt *stmt)
 	{
 		auto postfixExprs = StatsPostfixExprs(stmt);
 
 		if (stmt->expr)
 		{
-			CompileExpr(stmt->expr);
+			// the OP_RETURN stays behind the tail call for callees that cannot reuse the frame(native functions,constructors)
+			if (stmt->expr->kind == AstKind::CALL && postfixExprs.empty() && mFunctionList.size() > 1)
+				CompileCallExpr((CallExpr *)stmt->expr, true);
+			else
+				CompileExpr(stmt->expr);
 			EmitReturn(1, stmt->expr->tagToken);
 		}
 		else
@@ -523,10 +623,12 @@ namespace CynicScript
 
 	void Compiler::CompileBreakStmt(BreakStmt *stmt)
 	{
+		EmitLoopScopeExit(stmt->tagToken);
 		mCurBreakStmtAddress = EmitJump(OP_JUMP, stmt->tagToken);
 	}
 	void Compiler::CompileContinueStmt(ContinueStmt *stmt)
 	{
+		EmitLoopScopeExit(stmt->tagToken);
 		mCurContinueStmtAddress = EmitJump(OP_JUMP, stmt->tagToken);
 	}
 
@@ -616,7 +718,7 @@ namespace CynicScript
 
 				CompileExpr(expr->right);
 
-				uint64_t appregateOpCodeAddress = EmitOpCode((OpCode)0xFF, assignee->tagToken) - 1;
+				uint64_t appregateOpCodeAddress = EmitOpCode((OpCode)0xFF, assignee->tagToken);
 				uint64_t resolveAddress = Emit((OpCode)0xFF);
 
 				uint8_t resolveCount = static_cast<uint8_t>(assignee->elements.size());
@@ -681,13 +783,13 @@ namespace CynicScript
 			CompileExpr(expr->left);
 			CompileExpr(expr->right);
 			if (expr->op == TEXT("+"))
-				EmitOpCode(OP_ADD, expr->tagToken);
+				EmitArithmetic(OP_ADD, expr->left->type, expr->right->type, expr->tagToken);
 			else if (expr->op == TEXT("-"))
-				EmitOpCode(OP_SUB, expr->tagToken);
+				EmitArithmetic(OP_SUB, expr->left->type, expr->right->type, expr->tagToken);
 			else if (expr->op == TEXT("*"))
-				EmitOpCode(OP_MUL, expr->tagToken);
+				EmitArithmetic(OP_MUL, expr->left->type, expr->right->type, expr->tagToken);
 			else if (expr->op == TEXT("/"))
-				EmitOpCode(OP_DIV, expr->tagToken);
+				EmitArithmetic(OP_DIV, expr->left->type, expr->right->type, expr->tagToken);
 			else if (expr->op == TEXT("%"))
 				EmitOpCode(OP_MOD, expr->tagToken);
 			else if (expr->op == TEXT("&"))
@@ -695,21 +797,21 @@ namespace CynicScript
 			else if (expr->op == TEXT("|"))
 				EmitOpCode(OP_BIT_OR, expr->tagToken);
 			else if (expr->op == TEXT("<"))
-				EmitOpCode(OP_LESS, expr->tagToken);
+				EmitArithmetic(OP_LESS, expr->left->type, expr->right->type, expr->tagToken);
 			else if (expr->op == TEXT(">"))
-				EmitOpCode(OP_GREATER, expr->tagToken);
+				EmitArithmetic(OP_GREATER, expr->left->type, expr->right->type, expr->tagToken);
 			else if (expr->op == TEXT("<<"))
 				EmitOpCode(OP_BIT_LEFT_SHIFT, expr->tagToken);
 			else if (expr->op == TEXT(">>"))
 				EmitOpCode(OP_BIT_RIGHT_SHIFT, expr->tagToken);
 			else if (expr->op == TEXT("<="))
 			{
-				EmitOpCode(OP_GREATER, expr->tagToken);
+				EmitArithmetic(OP_GREATER, expr->left->type, expr->right->type, expr->tagToken);
 				EmitOpCode(OP_NOT, expr->tagToken);
 			}
 			else if (expr->op == TEXT(">="))
 			{
-				EmitOpCode(OP_LESS, expr->tagToken);
+				EmitArithmetic(OP_LESS, expr->left->type, expr->right->type, expr->tagToken);
 				EmitOpCode(OP_NOT, expr->tagToken);
 			}
 			else if (expr->op == TEXT("=="))
@@ -721,22 +823,22 @@ namespace CynicScript
 			}
 			else if (expr->op == TEXT("+="))
 			{
-				EmitOpCode(OP_ADD, expr->tagToken);
+				EmitArithmetic(OP_ADD, expr->left->type, expr->right->type, expr->tagToken);
 				CompileExpr(expr->left, RWState::WRITE);
 			}
 			else if (expr->op == TEXT("-="))
 			{
-				EmitOpCode(OP_SUB, expr->tagToken);
+				EmitArithmetic(OP_SUB, expr->left->type, expr->right->type, expr->tagToken);
 				CompileExpr(expr->left, RWState::WRITE);
 			}
 			else if (expr->op == TEXT("*="))
 			{
-				EmitOpCode(OP_MUL, expr->tagToken);
+				EmitArithmetic(OP_MUL, expr->left->type, expr->right->type, expr->tagToken);
 				CompileExpr(expr->left, RWState::WRITE);
 			}
 			else if (expr->op == TEXT("/="))
 			{
-				EmitOpCode(OP_DIV, expr->tagToken);
+				EmitArithmetic(OP_DIV, expr->left->type, expr->right->type, expr->tagToken);
 				CompileExpr(expr->left, RWState::WRITE);
 			}
 			else if (expr->op == TEXT("%="))
@@ -813,7 +915,7 @@ namespace CynicScript
 			while (expr->right->kind == AstKind::PREFIX && ((PrefixExpr *)expr->right)->op == TEXT("++") || ((PrefixExpr *)expr->right)->op == TEXT("--"))
 				expr = (PrefixExpr *)expr->right;
 			EmitConstant((int64_t)1, expr->tagToken);
-			EmitOpCode(OP_ADD, expr->tagToken);
+			EmitArithmetic(OP_ADD, expr->right->type, Type(TypeKind::I64, expr->tagToken->sourceLocation), expr->tagToken);
 			CompileExpr(expr->right, RWState::WRITE);
 		}
 		else if (expr->op == TEXT("--"))
@@ -821,7 +923,7 @@ namespace CynicScript
 			while (expr->right->kind == AstKind::PREFIX && ((PrefixExpr *)expr->right)->op == TEXT("++") || ((PrefixExpr *)expr->right)->op == TEXT("--"))
 				expr = (PrefixExpr *)expr->right;
 			EmitConstant((int64_t)1, expr->tagToken);
-			EmitOpCode(OP_SUB, expr->tagToken);
+			EmitArithmetic(OP_SUB, expr->right->type, Type(TypeKind::I64, expr->tagToken->sourceLocation), expr->tagToken);
 			CompileExpr(expr->right, RWState::WRITE);
 		}
 		else
@@ -833,10 +935,11 @@ namespace CynicScript
 		if (!isDelayCompile)
 		{
 			EmitConstant((int64_t)1, expr->tagToken);
+			Type one(TypeKind::I64, expr->tagToken->sourceLocation);
 			if (expr->op == TEXT("++"))
-				EmitOpCode(OP_ADD, expr->tagToken);
+				EmitArithmetic(OP_ADD, expr->left->type, one, expr->tagToken);
 			else if (expr->op == TEXT("--"))
-				EmitOpCode(OP_SUB, expr->tagToken);
+				EmitArithmetic(OP_SUB, expr->left->type, one, expr->tagToken);
 			else
 				CYS_LOG_ERROR_WITH_LOC(expr->tagToken, TEXT("No postfix op:{}"), expr->op);
 			CompileExpr(expr->left, RWState::WRITE);
@@ -966,22 +1069,26 @@ namespace CynicScript
 		{
 			if (symbol.permission == Permission::MUTABLE)
 			{
-				EmitOpCode(setOp, expr->tagToken);
 				if (symbol.location == SymbolLocation::UPVALUE)
+				{
+					EmitOpCode(setOp, expr->tagToken);
 					Emit(symbol.upvalue.index);
+				}
 				else
-					Emit(symbol.index);
+					EmitIndexed(setOp, symbol.index, expr->tagToken);
 			}
 			else
 				CYS_LOG_ERROR_WITH_LOC(expr->tagToken, TEXT("{} is a constant,which cannot be assigned!"), expr->ToString());
 		}
 		else
 		{
-			EmitOpCode(getOp, expr->tagToken);
 			if (symbol.location == SymbolLocation::UPVALUE)
+			{
+				EmitOpCode(getOp, expr->tagToken);
 				Emit(symbol.upvalue.index);
+			}
 			else
-				Emit(symbol.index);
+				EmitIndexed(getOp, symbol.index, expr->tagToken);
 		}
 	}
 	void Compiler::CompileLambdaExpr(LambdaExpr *expr)
@@ -1013,8 +1120,9 @@ namespace CynicScript
 
 		CompileScopeStmt(expr->body);
 
-		if (CurChunk().opCodes[CurChunk().opCodes.size() - 2] != OP_RETURN)
-			EmitReturn(0, expr->body->stmts.back()->tagToken);
+		// always close the body with an implicit return,the last instruction being OP_RETURN does not mean every path returns(e.g. if-else jumps past it)
+		EmitReturn(0, expr->body->stmts.back()->tagToken);
+		WidenFarJumps();
 
 		mSymbolTable = mSymbolTable->enclosing;
 
@@ -1033,12 +1141,12 @@ namespace CynicScript
 		ExitScope();
 	}
 
-	void Compiler::CompileCallExpr(CallExpr *expr)
+	void Compiler::CompileCallExpr(CallExpr *expr, bool isTailCall)
 	{
 		CompileExpr(expr->callee, RWState::READ, static_cast<int8_t>(expr->arguments.size()));
 		for (const auto &arg : expr->arguments)
 			CompileExpr(arg);
-		EmitOpCode(OP_CALL, expr->callee->tagToken);
+		EmitOpCode(isTailCall ? OP_TAIL_CALL : OP_CALL, expr->callee->tagToken);
 		Emit(static_cast<uint8_t>(expr->arguments.size()));
 	}
 	void Compiler::CompileDotExpr(DotExpr *expr, const RWState &state)
@@ -1058,6 +1166,8 @@ namespace CynicScript
 			auto refIdxExpr = ((IndexExpr *)expr->refExpr);
 			CompileExpr(refIdxExpr->index);
 			symbol = mSymbolTable->Resolve(refIdxExpr->ds->tagToken, refIdxExpr->ds->ToString());
+			if (symbol.location != SymbolLocation::UPVALUE && symbol.index > UINT8_MAX)
+				CYS_LOG_ERROR_WITH_LOC(refIdxExpr->ds->tagToken, TEXT("Cannot reference \"{}\",its slot index exceeds {}."), refIdxExpr->ds->ToString(), UINT8_MAX);
 			if (symbol.location == SymbolLocation::GLOBAL)
 			{
 				EmitOpCode(OP_REF_INDEX_GLOBAL, symbol.relatedToken);
@@ -1077,6 +1187,8 @@ namespace CynicScript
 		else
 		{
 			symbol = mSymbolTable->Resolve(expr->refExpr->tagToken, expr->refExpr->ToString());
+			if (symbol.location != SymbolLocation::UPVALUE && symbol.index > UINT8_MAX)
+				CYS_LOG_ERROR_WITH_LOC(expr->refExpr->tagToken, TEXT("Cannot reference \"{}\",its slot index exceeds {}."), expr->refExpr->ToString(), UINT8_MAX);
 			if (symbol.location == SymbolLocation::GLOBAL)
 			{
 				EmitOpCode(OP_REF_GLOBAL, symbol.relatedToken);
@@ -1160,6 +1272,8 @@ namespace CynicScript
 			EmitReturn(1, decl->tagToken);
 		}
 
+		WidenFarJumps();
+
 		mFunctionList.back()->upValueCount = mSymbolTable->mUpValueCount;
 
 		auto upvalues = mSymbolTable->mUpValues;
@@ -1202,7 +1316,7 @@ namespace CynicScript
 					{
 						CompileExpr(v);
 
-						appregateOpCodeAddress = EmitOpCode((OpCode)0xFF, arrayExpr->tagToken) - static_cast<uint64_t>(1);
+						appregateOpCodeAddress = EmitOpCode((OpCode)0xFF, arrayExpr->tagToken);
 						resolveAddress = Emit((OpCode)0xFF);
 					}
 
@@ -1241,8 +1355,7 @@ namespace CynicScript
 
 						if (symbol.location == SymbolLocation::GLOBAL)
 						{
-							EmitOpCode(OP_SET_GLOBAL, symbol.relatedToken);
-							Emit(symbol.index);
+							EmitIndexed(OP_SET_GLOBAL, symbol.index, symbol.relatedToken);
 							EmitOpCode(OP_POP, symbol.relatedToken);
 						}
 						else if (IsInClassOrModuleScope)
@@ -1283,8 +1396,7 @@ namespace CynicScript
 					auto symbol = mSymbolTable->Define(token, decl->permission, literal);
 					if (symbol.location == SymbolLocation::GLOBAL)
 					{
-						EmitOpCode(OP_SET_GLOBAL, symbol.relatedToken);
-						Emit(symbol.index);
+						EmitIndexed(OP_SET_GLOBAL, symbol.index, symbol.relatedToken);
 						EmitOpCode(OP_POP, symbol.relatedToken);
 					}
 					else if (IsInClassOrModuleScope)
@@ -1396,13 +1508,8 @@ namespace CynicScript
 
 	uint64_t Compiler::EmitOpCode(OpCode opCode, const Token *token)
 	{
-		Emit((uint8_t)opCode);
-
-		CurChunk().opCodeRelatedTokens.emplace_back(token);
-
-		Emit(static_cast<uint8_t>(CurChunk().opCodeRelatedTokens.size() - 1));
-
-		return CurOpCodeList().size() - 1;
+		CurChunk().AddRelatedToken(static_cast<uint32_t>(CurOpCodeList().size()), token);
+		return Emit((uint8_t)opCode);
 	}
 
 	uint64_t Compiler::Emit(uint8_t opcode)
@@ -1413,18 +1520,57 @@ namespace CynicScript
 
 	uint64_t Compiler::EmitConstant(const Value &value, const Token *token)
 	{
-		EmitOpCode(OP_CONSTANT, token);
-		uint8_t pos = AddConstant(value);
-		Emit(pos);
-		return CurOpCodeList().size() - 1;
+		auto pos = AddConstant(value, token);
+		return EmitIndexed(OP_CONSTANT, pos, token);
 	}
 
 	uint64_t Compiler::EmitClosure(FunctionObject *function, const Token *token)
 	{
-		uint8_t pos = AddConstant(function);
-		EmitOpCode(OP_CLOSURE, token);
-		Emit(pos);
-		return CurOpCodeList().size() - 1;
+		auto pos = AddConstant(function, token);
+		return EmitIndexed(OP_CLOSURE, pos, token);
+	}
+
+	// indices that do not fit in one byte switch to the long form of the opcode with a 16 bit operand
+	uint64_t Compiler::EmitIndexed(OpCode opCode, uint32_t index, const Token *token)
+	{
+		if (index <= UINT8_MAX)
+		{
+			EmitOpCode(opCode, token);
+			return Emit(static_cast<uint8_t>(index));
+		}
+
+		if (index > UINT16_MAX)
+			CYS_LOG_ERROR_WITH_LOC(token, TEXT("Operand index out of range:{}."), index);
+
+		OpCode longOpCode;
+		switch (opCode)
+		{
+		case OP_CONSTANT:
+			longOpCode = OP_CONSTANT_LONG;
+			break;
+		case OP_SET_GLOBAL:
+			longOpCode = OP_SET_GLOBAL_LONG;
+			break;
+		case OP_GET_GLOBAL:
+			longOpCode = OP_GET_GLOBAL_LONG;
+			break;
+		case OP_SET_LOCAL:
+			longOpCode = OP_SET_LOCAL_LONG;
+			break;
+		case OP_GET_LOCAL:
+			longOpCode = OP_GET_LOCAL_LONG;
+			break;
+		case OP_CLOSURE:
+			longOpCode = OP_CLOSURE_LONG;
+			break;
+		default:
+			CYS_LOG_ERROR_WITH_LOC(token, TEXT("Operand index out of range:{}."), index);
+			return CurOpCodeList().size() - 1;
+		}
+
+		EmitOpCode(longOpCode, token);
+		Emit((index >> 8) & 0xFF);
+		return Emit(index & 0xFF);
 	}
 
 	uint64_t Compiler::EmitReturn(uint8_t retCount, const Token *token)
@@ -1442,41 +1588,95 @@ namespace CynicScript
 		return CurOpCodeList().size() - 2;
 	}
 
-	void Compiler::EmitLoop(uint16_t opcode, const Token *token)
+	// + - * / < > on operands TypeCheckAndResolvePass proved to be both int or both real use the tag-check-free variant
+	uint64_t Compiler::EmitArithmetic(OpCode opCode, const Type &leftType, const Type &rightType, const Token *token)
 	{
-		EmitOpCode(OP_LOOP, token);
-		uint16_t offset = static_cast<uint16_t>(CurOpCodeList().size()) - opcode + 2;
+		auto isInteger = [](const Type &type)
+		{ return type.GetKind() >= TypeKind::I8 && type.GetKind() <= TypeKind::U64; };
 
+		bool isI64 = isInteger(leftType) && isInteger(rightType);
+		bool isF64 = leftType.IsFloating() && rightType.IsFloating();
+		if (isI64 || isF64)
+		{
+			switch (opCode)
+			{
+			case OP_ADD:
+				return EmitOpCode(isI64 ? OP_ADD_I64 : OP_ADD_F64, token);
+			case OP_SUB:
+				return EmitOpCode(isI64 ? OP_SUB_I64 : OP_SUB_F64, token);
+			case OP_MUL:
+				return EmitOpCode(isI64 ? OP_MUL_I64 : OP_MUL_F64, token);
+			case OP_DIV:
+				return EmitOpCode(isI64 ? OP_DIV_I64 : OP_DIV_F64, token);
+			case OP_LESS:
+				return EmitOpCode(isI64 ? OP_LESS_I64 : OP_LESS_F64, token);
+			case OP_GREATER:
+				return EmitOpCode(isI64 ? OP_GREATER_I64 : OP_GREATER_F64, token);
+			default:
+				break;
+			}
+		}
+		return EmitOpCode(opCode, token);
+	}
+
+	void Compiler::EmitLoop(uint64_t loopStart, const Token *token)
+	{
+		uint64_t offset = CurOpCodeList().size() - loopStart + 3;
+		if (offset <= UINT16_MAX)
+		{
+			EmitOpCode(OP_LOOP, token);
+			Emit((offset >> 8) & 0xFF);
+			Emit(offset & 0xFF);
+			return;
+		}
+
+		offset += 2;
+		EmitOpCode(OP_LOOP_LONG, token);
+		Emit((offset >> 24) & 0xFF);
+		Emit((offset >> 16) & 0xFF);
 		Emit((offset >> 8) & 0xFF);
 		Emit(offset & 0xFF);
 	}
 
-	void Compiler::PatchJump(uint64_t offset)
+	void Compiler::PatchJump(uint64_t offset, uint64_t operandSize)
 	{
-		uint16_t jumpOffset = static_cast<uint16_t>(CurOpCodeList().size() - offset - 2);
+		uint64_t jumpOffset = CurOpCodeList().size() - offset - 2;
+		if (jumpOffset > UINT16_MAX) // widened to the long form once the function is finished
+			mFarJumpTargets[CurFunction()][static_cast<uint32_t>(offset - 1 - operandSize)] = static_cast<uint32_t>(CurOpCodeList().size());
 		CurOpCodeList()[offset] = (jumpOffset >> 8) & 0xFF;
 		CurOpCodeList()[offset + 1] = (jumpOffset)&0xFF;
 	}
 
-	uint8_t Compiler::AddConstant(const Value &value)
+	// forward jumps are emitted with a 16 bit placeholder before the distance is known,
+	// re-encode the function with the long jump forms if any of them overflowed
+	void Compiler::WidenFarJumps()
+	{
+		auto iter = mFarJumpTargets.find(CurFunction());
+		if (iter == mFarJumpTargets.end())
+			return;
+
+		auto instructions = BytecodeOptimizePass::Decode(CurChunk(), iter->second);
+		BytecodeOptimizePass::Encode(instructions, CurChunk());
+		mFarJumpTargets.erase(iter);
+	}
+
+	uint32_t Compiler::AddConstant(const Value &value, const Token *token)
 	{
+		if (CurChunk().constants.size() > UINT16_MAX)
+			CYS_LOG_ERROR_WITH_LOC(token, TEXT("Too many constants in one chunk."));
 		CurChunk().constants.emplace_back(value);
-		return static_cast<uint8_t>(CurChunk().constants.size()) - 1;
+		return static_cast<uint32_t>(CurChunk().constants.size()) - 1;
 	}
 
 	void Compiler::EmitSymbol(const Symbol &symbol)
 	{
 		if (symbol.location == SymbolLocation::GLOBAL)
 		{
-			EmitOpCode(OP_SET_GLOBAL, symbol.relatedToken);
-			Emit(symbol.index);
+			EmitIndexed(OP_SET_GLOBAL, symbol.index, symbol.relatedToken);
 			EmitOpCode(OP_POP, symbol.relatedToken);
 		}
 		else if (symbol.location == SymbolLocation::LOCAL)
-		{
-			EmitOpCode(OP_SET_LOCAL, symbol.relatedToken);
-			Emit(symbol.index);
-		}
+			EmitIndexed(OP_SET_LOCAL, symbol.index, symbol.relatedToken);
 	}
 
 	void Compiler::EnterScope()
@@ -1487,18 +1687,40 @@ namespace CynicScript
 	{
 		mSymbolTable->mScopeDepth--;
 
-		for (int32_t i = 0; i < mSymbolTable->mSymbols.size(); ++i)
+		// the innermost scope's symbols are always the last ones defined,pop them from the stack top down
+		// and release their slots so the next scope reuses them at the same stack positions
+		while (mSymbolTable->mSymbolCount > 0)
 		{
-			Symbol *symbol = &mSymbolTable->mSymbols[i];
-			if (symbol->location == SymbolLocation::LOCAL &&
-				symbol->scopeDepth > mSymbolTable->mScopeDepth)
+			Symbol *symbol = &mSymbolTable->mSymbols[mSymbolTable->mSymbolCount - 1];
+			if (symbol->scopeDepth <= mSymbolTable->mScopeDepth)
+				break;
+
+			if (symbol->location == SymbolLocation::LOCAL)
 			{
 				if (symbol->isCaptured)
 					EmitOpCode(OP_CLOSE_UPVALUE, symbol->relatedToken);
 				else
 					EmitOpCode(OP_POP, symbol->relatedToken);
-				symbol->location = SymbolLocation::GLOBAL; // mark as global to avoid second pop
+				mSymbolTable->mLocalSymbolCount--;
 			}
+
+			*symbol = Symbol();
+			mSymbolTable->mSymbolCount--;
+		}
+	}
+
+	// break and continue leave the scopes of the loop body early,so they pop the locals of those scopes like ExitScope
+	// does on the normal path.the symbols stay defined,the code after the jump still belongs to the scopes
+	void Compiler::EmitLoopScopeExit(const Token *relatedToken)
+	{
+		for (int64_t i = static_cast<int64_t>(mSymbolTable->mSymbolCount) - 1; i >= 0; --i)
+		{
+			const auto &symbol = mSymbolTable->mSymbols[i];
+			if (symbol.scopeDepth <= mCurLoopScopeDepth)
+				break;
+
+			if (symbol.location == SymbolLocation::LOCAL)
+				EmitOpCode(symbol.isCaptured ? OP_CLOSE_UPVALUE : OP_POP, relatedToken);
 		}
 	}
 
@@ -1736,5 +1958,6 @@ namespace CynicScript
 	{
 		SAFE_DELETE(mSymbolTable);
 		std::vector<FunctionObject *>().swap(mFunctionList);
+		mFarJumpTargets.clear();
 	}
 }
\ No newline at end of file
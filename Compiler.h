@@ -1,4 +1,5 @@
 #pragma once
+#include <unordered_map>
 #include "Chunk.h"
 #include "Ast.h"
 #include "Object.h"
@@ -38,6 +39,7 @@ namespace CynicScript
 		void CompileIfStmt(IfStmt *stmt);
 		void CompileScopeStmt(ScopeStmt *stmt);
 		void CompileWhileStmt(WhileStmt *stmt);
+		void CompileForInStmt(ForInStmt *stmt);
 		void CompileReturnStmt(ReturnStmt *stmt);
 		void CompileBreakStmt(BreakStmt *stmt);
 		void CompileContinueStmt(ContinueStmt *stmt);
@@ -59,7 +61,7 @@ namespace CynicScript
 		void CompileIdentifierExpr(IdentifierExpr *expr, const RWState &state, int8_t paramCount = -1);
 		void CompileLambdaExpr(LambdaExpr *expr);
 		void CompileCompoundExpr(CompoundExpr *expr);
-		void CompileCallExpr(CallExpr *expr);
+		void CompileCallExpr(CallExpr *expr, bool isTailCall = false);
 		void CompileDotExpr(DotExpr *expr, const RWState &state = RWState::READ);
 		void CompileRefExpr(RefExpr *expr);
 		void CompileStructExpr(StructExpr *expr);
@@ -76,14 +78,19 @@ namespace CynicScript
 		uint64_t EmitClosure(FunctionObject *function, const Token *token);
 		uint64_t EmitReturn(uint8_t retCount, const Token *token);
 		uint64_t EmitJump(OpCode opcode, const Token *token);
-		void EmitLoop(uint16_t opcode, const Token *token);
-		void PatchJump(uint64_t offset);
-		uint8_t AddConstant(const Value &value);
+		uint64_t EmitArithmetic(OpCode opCode, const Type &leftType, const Type &rightType, const Token *token);
+		uint64_t EmitIndexed(OpCode opCode, uint32_t index, const Token *token);
+		void EmitLoop(uint64_t loopStart, const Token *token);
+		// operandSize:bytes between the opcode and its 16 bit offset,the for opcodes carry a slot operand first
+		void PatchJump(uint64_t offset, uint64_t operandSize = 0);
+		void WidenFarJumps();
+		uint32_t AddConstant(const Value &value, const Token *token);
 
 		void EmitSymbol(const Symbol &symbol);
 
 		void EnterScope();
 		void ExitScope();
+		void EmitLoopScopeExit(const Token *relatedToken);
 
 		Chunk &CurChunk();
 		FunctionObject *CurFunction();
@@ -99,5 +106,9 @@ namespace CynicScript
 		SymbolTable *mSymbolTable;
 
 		int64_t mCurBreakStmtAddress, mCurContinueStmtAddress;
+		uint8_t mCurLoopScopeDepth; // scope depth outside the innermost loop body,break and continue pop the locals above it
+
+		// jump opcode offset -> target offset of the forward jumps whose distance overflowed 16 bits,per function
+		std::unordered_map<FunctionObject *, std::unordered_map<uint32_t, uint32_t>> mFarJumpTargets;
 	};
 }
\ No newline at end of file
@@ -43,6 +43,17 @@ namespace CynicScript
 		stmt->body = (ScopeStmt *)ExecuteScopeStmt(stmt->body);
 		return stmt;
 	}
+	Stmt *ConstantFoldPass::ExecuteForInStmt(ForInStmt *stmt)
+	{
+		if (stmt->iterable)
+			stmt->iterable = ExecuteExpr(stmt->iterable);
+		if (stmt->rangeBegin)
+			stmt->rangeBegin = ExecuteExpr(stmt->rangeBegin);
+		if (stmt->rangeEnd)
+			stmt->rangeEnd = ExecuteExpr(stmt->rangeEnd);
+		stmt->body = (ScopeStmt *)ExecuteScopeStmt(stmt->body);
+		return stmt;
+	}
 	Decl *ConstantFoldPass::ExecuteEnumDecl(EnumDecl *decl)
 	{
 		for (auto &[k, v] : decl->enumItems)
@@ -25,6 +25,7 @@ namespace CynicScript
         Stmt *ExecuteIfStmt(IfStmt *stmt) override;
         Stmt *ExecuteScopeStmt(ScopeStmt *stmt) override;
         Stmt *ExecuteWhileStmt(WhileStmt *stmt) override;
+        Stmt *ExecuteForInStmt(ForInStmt *stmt) override;
         Stmt *ExecuteBreakStmt(BreakStmt *stmt) override;
         Stmt *ExecuteContinueStmt(ContinueStmt *stmt) override;
 
@@ -1,5 +1,7 @@
 #include <string>
 #include <string_view>
+#include <unordered_set>
+#include <thread>
 #include "CynicScript.h"
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -15,7 +17,10 @@ CynicScript::Parser *gParser{nullptr};
 CynicScript::AstOptimizePassManager *gAstOptimizePassManager{nullptr};
 
 CynicScript::Compiler *gCompiler{nullptr};
+CynicScript::BytecodeOptimizePassManager *gBytecodeOptimizePassManager{nullptr};
 CynicScript::VM *gVm{nullptr};
+// --fuel=<n>,the script still runs to the end but gives control back to the host loop in Run() every n units
+uint64_t gFuelBudget{0};
 
 int32_t PrintVersion()
 {
@@ -31,6 +36,24 @@ int32_t PrintUsage()
 	CYS_LOG_INFO(TEXT("-s or --serialize: serialize source file as bytecode binary file"));
 	CYS_LOG_INFO(TEXT("-f or --file:run source file with a valid file path,like : CynicScript -f examples/array.cd."));
 	CYS_LOG_INFO(TEXT("--function-cache:use function cache optimize."));
+	CYS_LOG_INFO(TEXT("--emit-cpp:compile source file to C++ source instead of running it,like : CynicScript -f examples/array.cd --emit-cpp array.cpp."));
+	CYS_LOG_INFO(TEXT("--load-native:run source file with the shared library built from its --emit-cpp output."));
+	CYS_LOG_INFO(TEXT("--profile-sample=<hz>:sample the script call stack hz times per second of cpu time and write the folded stacks for flamegraph tools."));
+	CYS_LOG_INFO(TEXT("--profile-sample-output:where --profile-sample writes the folded stacks,profile.folded by default."));
+	CYS_LOG_INFO(TEXT("--quicken-stats:print how many opcodes of each function are quickened after running."));
+	CYS_LOG_INFO(TEXT("--fuel=<n>:suspend the script after n loop iterations and calls and resume it right away,to exercise preemption."));
+	CYS_LOG_INFO(TEXT("--backend=<stack|register|auto>:run functions on the stack vm(default),on the register vm,or on the register vm only where it executes clearly fewer instructions."));
+	CYS_LOG_INFO(TEXT("--gc-pause-budget-us=<n>:mark and sweep the old generation incrementally,at most n microseconds at a time,instead of all at once."));
+	CYS_LOG_INFO(TEXT("--gc-parallel-mark[=<n>]:mark the heap of a major collection on n threads,n defaults to the number of cores."));
+	CYS_LOG_INFO(TEXT("--gc-concurrent-sweep:sweep the old generation on a background thread while the script goes on."));
+#ifdef CYS_OPCODE_PROFILE
+	CYS_LOG_INFO(TEXT("--profile-opcodes:print how many times each opcode and opcode pair is executed when the vm shuts down."));
+	CYS_LOG_INFO(TEXT("--profile-opcodes-cycles:with --profile-opcodes,also measure the time stamp counter cycles spent in each opcode."));
+	CYS_LOG_INFO(TEXT("--profile-opcodes-json:with --profile-opcodes,write the profile to a json file instead,like : --profile-opcodes-json profile.json."));
+#endif
+#ifdef CYS_JIT
+	CYS_LOG_INFO(TEXT("--no-jit:never compile hot functions to machine code."));
+#endif
 #ifndef NDEBUG
 	CYS_LOG_INFO(TEXT("--gc-debug:debug gc."));
 	CYS_LOG_INFO(TEXT("--gc-stress:stressing gc."));
@@ -39,6 +62,20 @@ int32_t PrintUsage()
 	return EXIT_FAILURE;
 }
 
+void PrintQuickenStats(CynicScript::FunctionObject *function, std::unordered_set<CynicScript::FunctionObject *> &visited)
+{
+	if (visited.contains(function))
+		return;
+	visited.insert(function);
+
+	CynicScript::Logger::Println(TEXT("{}:{} quickened opcode(s)"), function->ToString(), function->quickenedCount);
+	for (const auto &c : function->chunk.constants)
+	{
+		if (CYS_IS_FUNCTION_VALUE(c))
+			PrintQuickenStats(CYS_TO_FUNCTION_VALUE(c), visited);
+	}
+}
+
 void Run(STRING_VIEW content)
 {
 	auto tokens = gLexer->ScanTokens(content);
@@ -60,6 +97,10 @@ void Run(STRING_VIEW content)
 
 	auto mainFunc = gCompiler->Compile(stmt);
 
+	mainFunc = gBytecodeOptimizePassManager->Execute(mainFunc);
+
+	CynicScript::Verifier::Verify(mainFunc);
+
 #ifndef NDEBUG
 	auto str = mainFunc->ToStringWithChunk();
 	CynicScript::Logger::Println(TEXT("{}"), str);
@@ -70,9 +111,37 @@ void Run(STRING_VIEW content)
 		auto data = mainFunc->chunk.Serialize();
 		CynicScript::WriteBinaryFile(CynicScript::Config::GetInstance()->GetSerializeBinaryFilePath(), data);
 	}
+	else if (!CynicScript::Config::GetInstance()->GetEmitCppFilePath().empty())
+	{
+		auto source = CynicScript::Aot::EmitCpp(mainFunc);
+		CynicScript::WriteBinaryFile(CynicScript::Config::GetInstance()->GetEmitCppFilePath(), std::vector<uint8_t>(source.begin(), source.end()));
+	}
 	else
 	{
+		if (!CynicScript::Config::GetInstance()->GetNativeModulePath().empty())
+			CynicScript::Aot::Load(CynicScript::Config::GetInstance()->GetNativeModulePath(), mainFunc);
+
+		auto sampleFrequency = CynicScript::Config::GetInstance()->GetProfileSampleFrequency();
+		if (sampleFrequency > 0 && !CynicScript::SampleProfiler::GetInstance()->Start(sampleFrequency))
+			CYS_LOG_WARN(TEXT("Failed to start the sampling profiler,the script runs without it."));
+
+		gVm->SetFuelBudget(gFuelBudget);
 		gVm->Run(mainFunc);
+		while (gVm->GetStatus() == CynicScript::VM::Status::SUSPENDED)
+			gVm->Resume();
+
+		if (sampleFrequency > 0)
+		{
+			CynicScript::SampleProfiler::GetInstance()->Stop();
+			auto folded = CynicScript::SampleProfiler::GetInstance()->ToFolded();
+			CynicScript::WriteBinaryFile(CynicScript::Config::GetInstance()->GetProfileSampleFilePath(), std::vector<uint8_t>(folded.begin(), folded.end()));
+		}
+
+		if (CynicScript::Config::GetInstance()->IsShowQuickenStats())
+		{
+			std::unordered_set<CynicScript::FunctionObject *> visited;
+			PrintQuickenStats(mainFunc, visited);
+		}
 	}
 }
 
@@ -133,9 +202,116 @@ int32_t ParseArgs(int32_t argc, const char *argv[])
 			else
 				return PrintUsage();
 		}
+		if (strcmp(argv[i], "--emit-cpp") == 0)
+		{
+			if (i + 1 < argc)
+				CynicScript::Config::GetInstance()->SetEmitCppFilePath(argv[++i]);
+			else
+				return PrintUsage();
+		}
+
+		if (strcmp(argv[i], "--load-native") == 0)
+		{
+			if (i + 1 < argc)
+				CynicScript::Config::GetInstance()->SetNativeModulePath(argv[++i]);
+			else
+				return PrintUsage();
+		}
+
+		if (strncmp(argv[i], "--profile-sample=", strlen("--profile-sample=")) == 0)
+		{
+			auto frequency = strtol(argv[i] + strlen("--profile-sample="), nullptr, 10);
+			if (frequency <= 0)
+				return PrintUsage();
+			CynicScript::Config::GetInstance()->SetProfileSampleFrequency(static_cast<uint32_t>(frequency));
+		}
+
+		if (strcmp(argv[i], "--profile-sample-output") == 0)
+		{
+			if (i + 1 < argc)
+				CynicScript::Config::GetInstance()->SetProfileSampleFilePath(argv[++i]);
+			else
+				return PrintUsage();
+		}
+
 		if (strcmp(argv[i], "--function-cache") == 0)
 			CynicScript::Config::GetInstance()->SetUseFunctionCache(true);
 
+		if (strcmp(argv[i], "--quicken-stats") == 0)
+			CynicScript::Config::GetInstance()->SetShowQuickenStats(true);
+
+		if (strncmp(argv[i], "--fuel=", strlen("--fuel=")) == 0)
+		{
+			auto fuel = strtoll(argv[i] + strlen("--fuel="), nullptr, 10);
+			if (fuel <= 0)
+				return PrintUsage();
+			gFuelBudget = static_cast<uint64_t>(fuel);
+		}
+
+		if (strncmp(argv[i], "--backend=", strlen("--backend=")) == 0)
+		{
+			auto backend = argv[i] + strlen("--backend=");
+			if (strcmp(backend, "stack") == 0)
+				CynicScript::Config::GetInstance()->SetBackend(CynicScript::Config::Backend::STACK);
+			else if (strcmp(backend, "register") == 0)
+				CynicScript::Config::GetInstance()->SetBackend(CynicScript::Config::Backend::REGISTER);
+			else if (strcmp(backend, "auto") == 0)
+				CynicScript::Config::GetInstance()->SetBackend(CynicScript::Config::Backend::AUTO);
+			else
+				return PrintUsage();
+		}
+
+		if (strncmp(argv[i], "--gc-pause-budget-us=", strlen("--gc-pause-budget-us=")) == 0)
+		{
+			auto budget = strtoll(argv[i] + strlen("--gc-pause-budget-us="), nullptr, 10);
+			if (budget < 0 || budget > UINT32_MAX)
+				return PrintUsage();
+			CynicScript::Config::GetInstance()->SetGCPauseBudget(static_cast<uint32_t>(budget));
+		}
+
+		if (strcmp(argv[i], "--gc-parallel-mark") == 0)
+			CynicScript::Config::GetInstance()->SetGCMarkThreadCount(std::thread::hardware_concurrency());
+
+		if (strncmp(argv[i], "--gc-parallel-mark=", strlen("--gc-parallel-mark=")) == 0)
+		{
+			auto count = strtoll(argv[i] + strlen("--gc-parallel-mark="), nullptr, 10);
+			if (count <= 0 || count > UINT32_MAX)
+				return PrintUsage();
+			CynicScript::Config::GetInstance()->SetGCMarkThreadCount(static_cast<uint32_t>(count));
+		}
+
+		if (strcmp(argv[i], "--gc-concurrent-sweep") == 0)
+			CynicScript::Config::GetInstance()->SetGCConcurrentSweep(true);
+
+#ifdef CYS_OPCODE_PROFILE
+		if (strcmp(argv[i], "--profile-opcodes") == 0)
+			CynicScript::Config::GetInstance()->SetProfileOpCodes(true);
+
+		if (strcmp(argv[i], "--profile-opcodes-cycles") == 0)
+			CynicScript::Config::GetInstance()->SetProfileOpCodeCycles(true);
+
+		if (strcmp(argv[i], "--profile-opcodes-json") == 0)
+		{
+			if (i + 1 < argc)
+				CynicScript::Config::GetInstance()->SetProfileOpCodesFilePath(argv[++i]);
+			else
+				return PrintUsage();
+		}
+#endif
+
+#ifdef CYS_JIT
+		if (strcmp(argv[i], "--no-jit") == 0)
+			CynicScript::Config::GetInstance()->SetUseJit(false);
+#endif
+
+#ifndef NDEBUG
+		if (strcmp(argv[i], "--gc-debug") == 0)
+			CynicScript::Config::GetInstance()->SetDebugGC(true);
+
+		if (strcmp(argv[i], "--gc-stress") == 0)
+			CynicScript::Config::GetInstance()->SetStressGC(true);
+#endif
+
 		if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
 			return PrintUsage();
 
@@ -160,6 +336,7 @@ int32_t main(int32_t argc, const char *argv[])
 	gParser = new CynicScript::Parser();
 	gAstOptimizePassManager = new CynicScript::AstOptimizePassManager();
 	gCompiler = new CynicScript::Compiler();
+	gBytecodeOptimizePassManager = new CynicScript::BytecodeOptimizePassManager();
 	gVm = new CynicScript::VM();
 
 	gAstOptimizePassManager
@@ -167,6 +344,10 @@ int32_t main(int32_t argc, const char *argv[])
 		->Add<CynicScript::SyntaxCheckPass>()
 		->Add<CynicScript::TypeCheckAndResolvePass>();
 
+	gBytecodeOptimizePassManager
+		->Add<CynicScript::SuperInstructionPass>()
+		->Add<CynicScript::PeepholePass>();
+
 	if (!CynicScript::Config::GetInstance()->GetExecuteFilePath().empty())
 		RunFile(CynicScript::Config::GetInstance()->GetExecuteFilePath());
 	else
@@ -176,6 +357,7 @@ int32_t main(int32_t argc, const char *argv[])
 	SAFE_DELETE(gParser);
 	SAFE_DELETE(gAstOptimizePassManager);
 	SAFE_DELETE(gCompiler);
+	SAFE_DELETE(gBytecodeOptimizePassManager);
 	SAFE_DELETE(gVm);
 
 	CynicScript::Destroy();
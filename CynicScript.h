@@ -12,4 +12,11 @@
 #include "TypeCheckAndResolvePass.h"
 #include "SyntaxCheckPass.h"
 #include "Compiler.h"
-#include "VM.h"
\ No newline at end of file
+#include "BytecodeOptimizePass.h"
+#include "SuperInstructionPass.h"
+#include "PeepholePass.h"
+#include "RegisterCompiler.h"
+#include "Verifier.h"
+#include "VM.h"
+#include "Aot.h"
+#include "SampleProfiler.h"
\ No newline at end of file
@@ -0,0 +1,553 @@
+#include "Jit.h"
+#ifdef CYS_JIT
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include "BytecodeOptimizePass.h"
+namespace CynicScript
+{
+	enum Reg : uint8_t
+	{
+		RAX = 0,
+		RBX = 3,
+		RSI = 6,
+		RDI = 7,
+		R12 = 12,
+		R13,
+		R14,
+		R15,
+	};
+
+	// registers live across the whole compiled function(all callee saved,so stub calls keep them)
+	constexpr Reg CONTEXT = RBX;
+	constexpr Reg STACK_TOP = R12; // written back to the context around every stub call and exit
+	constexpr Reg SLOTS = R13;
+	constexpr Reg CONSTANTS = R14;
+	constexpr Reg GLOBALS = R15;
+
+	enum Cond : uint8_t
+	{
+		COND_E = 0x4,
+		COND_NE = 0x5,
+		COND_L = 0xC,
+		COND_GE = 0xD,
+		COND_LE = 0xE,
+		COND_G = 0xF,
+	};
+
+	constexpr int32_t VALUE_SIZE = sizeof(Value);
+#ifndef CYS_NAN_BOXING
+	// the tagged layout keeps kind and payload apart,so int and bool fast paths can be done inline
+	constexpr int32_t KIND_OFFSET = offsetof(Value, kind);
+	constexpr int32_t PAYLOAD_OFFSET = offsetof(Value, integer);
+#endif
+
+	// emits raw x86-64,memory operands are always [base+disp32]
+	class Assembler
+	{
+	public:
+		// uint32_t Entry(NativeContext *context,void *target)
+		void Prologue()
+		{
+			Emit({0x53});						  // push rbx
+			Emit({0x41, 0x54, 0x41, 0x55});		  // push r12,push r13
+			Emit({0x41, 0x56, 0x41, 0x57});		  // push r14,push r15
+			Emit({0x48, 0x89, 0xFB});			  // mov rbx,rdi
+			Load(STACK_TOP, CONTEXT, offsetof(NativeContext, stackTop));
+			Load(SLOTS, CONTEXT, offsetof(NativeContext, frame));
+			Load(SLOTS, SLOTS, offsetof(CallFrame, slots));
+			Load(CONSTANTS, CONTEXT, offsetof(NativeContext, constants));
+			Load(GLOBALS, CONTEXT, offsetof(NativeContext, globals));
+			Emit({0xFF, 0xE6}); // jmp rsi
+
+			mEpilogue = mCode.size();
+			Emit({0x41, 0x5F, 0x41, 0x5E}); // pop r15,pop r14
+			Emit({0x41, 0x5D, 0x41, 0x5C}); // pop r13,pop r12
+			Emit({0x5B, 0xC3});				// pop rbx,ret
+		}
+
+		// hand over to the interpreter at the opcode at offset
+		void Exit(uint32_t offset)
+		{
+			Store(CONTEXT, offsetof(NativeContext, stackTop), STACK_TOP);
+			Emit({0xB8}); // mov eax,imm32
+			EmitU32(offset);
+			Emit({0xE9}); // jmp epilogue
+			EmitU32(static_cast<uint32_t>(mEpilogue - (mCode.size() + 4)));
+		}
+
+		// al = stub(context,ip)
+		void CallStub(NativeStub stub, uint8_t *ip)
+		{
+			Store(CONTEXT, offsetof(NativeContext, stackTop), STACK_TOP);
+			Emit({0x48, 0x89, 0xDF}); // mov rdi,rbx
+			Emit({0x48, 0xBE});		  // mov rsi,imm64
+			EmitU64(reinterpret_cast<uint64_t>(ip));
+			Emit({0x48, 0xB8}); // mov rax,imm64
+			EmitU64(reinterpret_cast<uint64_t>(stub));
+			Emit({0xFF, 0xD0}); // call rax
+			Load(STACK_TOP, CONTEXT, offsetof(NativeContext, stackTop));
+		}
+
+		void Load(Reg reg, Reg base, int32_t disp) { Op({0x8B}, reg, base, disp); }
+		void Store(Reg base, int32_t disp, Reg reg) { Op({0x89}, reg, base, disp); }
+		void Add(Reg reg, Reg base, int32_t disp) { Op({0x03}, reg, base, disp); }
+		void Sub(Reg reg, Reg base, int32_t disp) { Op({0x2B}, reg, base, disp); }
+		void Mul(Reg reg, Reg base, int32_t disp) { Op({0x0F, 0xAF}, reg, base, disp); }
+		void Cmp(Reg reg, Reg base, int32_t disp) { Op({0x3B}, reg, base, disp); }
+
+		void CmpByte(Reg base, int32_t disp, uint8_t imm)
+		{
+			ByteOp(0x80, 7, base, disp);
+			Emit({imm});
+		}
+
+		void StoreByte(Reg base, int32_t disp, uint8_t imm)
+		{
+			ByteOp(0xC6, 0, base, disp);
+			Emit({imm});
+		}
+
+		// rax = condition ? 1 : 0
+		void SetCond(Cond cond)
+		{
+			Emit({0x0F, static_cast<uint8_t>(0x90 | cond), 0xC0}); // setcc al
+			Emit({0x48, 0x0F, 0xB6, 0xC0});						   // movzx rax,al
+		}
+
+		void IncRax() { Emit({0x48, 0xFF, 0xC0}); }
+
+		void CopyValue(Reg dst, int32_t dstDisp, Reg src, int32_t srcDisp)
+		{
+			if constexpr (VALUE_SIZE == 8)
+			{
+				Load(RAX, src, srcDisp);
+				Store(dst, dstDisp, RAX);
+			}
+			else
+			{
+				for (int32_t i = 0; i < VALUE_SIZE; i += 16)
+				{
+					XmmOp(0x10, src, srcDisp + i); // movups xmm0,[src]
+					XmmOp(0x11, dst, dstDisp + i); // movups [dst],xmm0
+				}
+			}
+		}
+
+		void Push(Reg src, int32_t srcDisp)
+		{
+			CopyValue(STACK_TOP, 0, src, srcDisp);
+			MoveStackTop(1);
+		}
+
+		void MoveStackTop(int32_t count)
+		{
+			Emit({0x49, 0x81, static_cast<uint8_t>(count > 0 ? 0xC4 : 0xEC)}); // add/sub r12,imm32
+			EmitU32(static_cast<uint32_t>(std::abs(count) * VALUE_SIZE));
+		}
+
+		void TestAl() { Emit({0x84, 0xC0}); }
+
+		// jumps inside the code of one opcode,returns the position to bind later
+		size_t JumpIf(Cond cond)
+		{
+			Emit({0x0F, static_cast<uint8_t>(0x80 | cond)});
+			EmitU32(0);
+			return mCode.size() - 4;
+		}
+
+		size_t Jump()
+		{
+			Emit({0xE9});
+			EmitU32(0);
+			return mCode.size() - 4;
+		}
+
+		void Bind(size_t pos)
+		{
+			int32_t rel = static_cast<int32_t>(mCode.size() - (pos + 4));
+			std::memcpy(mCode.data() + pos, &rel, sizeof(int32_t));
+		}
+
+		// jumps to another opcode,resolved by PatchJumps
+		void JumpIf(Cond cond, size_t target) { mPatches.emplace_back(JumpIf(cond), target); }
+		void Jump(size_t target) { mPatches.emplace_back(Jump(), target); }
+
+		void PatchJumps(const std::vector<uint32_t> &entries)
+		{
+			for (const auto &[pos, target] : mPatches)
+			{
+				int32_t rel = static_cast<int32_t>(entries[target]) - static_cast<int32_t>(pos + 4);
+				std::memcpy(mCode.data() + pos, &rel, sizeof(int32_t));
+			}
+		}
+
+		size_t Size() const { return mCode.size(); }
+		const std::vector<uint8_t> &Code() const { return mCode; }
+
+	private:
+		// REX.W opcode modrm(reg,[base+disp32])
+		void Op(std::initializer_list<uint8_t> opCode, Reg reg, Reg base, int32_t disp)
+		{
+			Emit({static_cast<uint8_t>(0x48 | ((reg >> 3) << 2) | (base >> 3))});
+			Emit(opCode);
+			ModRM(reg & 7, base, disp);
+		}
+
+		void ByteOp(uint8_t opCode, uint8_t ext, Reg base, int32_t disp)
+		{
+			if (base >= 8)
+				Emit({0x41});
+			Emit({opCode});
+			ModRM(ext, base, disp);
+		}
+
+		void XmmOp(uint8_t opCode, Reg base, int32_t disp)
+		{
+			if (base >= 8)
+				Emit({0x41});
+			Emit({0x0F, opCode});
+			ModRM(0, base, disp);
+		}
+
+		void ModRM(uint8_t reg, Reg base, int32_t disp)
+		{
+			Emit({static_cast<uint8_t>(0x80 | (reg << 3) | (base & 7))});
+			if ((base & 7) == 4) // rsp and r12 need a sib byte
+				Emit({0x24});
+			EmitU32(static_cast<uint32_t>(disp));
+		}
+
+		void Emit(std::initializer_list<uint8_t> bytes) { mCode.insert(mCode.end(), bytes); }
+		void EmitU32(uint32_t v)
+		{
+			for (int32_t i = 0; i < 4; ++i)
+				mCode.emplace_back((v >> (i * 8)) & 0xFF);
+		}
+		void EmitU64(uint64_t v)
+		{
+			for (int32_t i = 0; i < 8; ++i)
+				mCode.emplace_back((v >> (i * 8)) & 0xFF);
+		}
+
+		size_t mEpilogue{0};
+		std::vector<uint8_t> mCode;
+		std::vector<std::pair<size_t, size_t>> mPatches; // rel32 position -> target bytecode offset
+	};
+
+	uint32_t JitCode::Run(NativeContext *context, uint32_t offset) const
+	{
+		auto entry = reinterpret_cast<uint32_t (*)(NativeContext *, void *)>(code);
+		return entry(context, code + entries[offset]);
+	}
+
+#ifndef CYS_NAN_BOXING
+	// top(1) = top(1) op top(0) for two ints,anything else goes through the stub
+	static void EmitIntBinary(Assembler &assembler, NativeStub stub, uint8_t *ip, uint8_t opCode)
+	{
+		const int32_t left = -2 * VALUE_SIZE, right = -VALUE_SIZE;
+		assembler.CmpByte(STACK_TOP, left + KIND_OFFSET, ValueKind::INT);
+		auto leftSlow = assembler.JumpIf(COND_NE);
+		assembler.CmpByte(STACK_TOP, right + KIND_OFFSET, ValueKind::INT);
+		auto rightSlow = assembler.JumpIf(COND_NE);
+
+		assembler.Load(RAX, STACK_TOP, left + PAYLOAD_OFFSET);
+		switch (opCode)
+		{
+		case OP_ADD:
+		case OP_ADD_I64:
+			assembler.Add(RAX, STACK_TOP, right + PAYLOAD_OFFSET);
+			break;
+		case OP_SUB:
+		case OP_SUB_I64:
+			assembler.Sub(RAX, STACK_TOP, right + PAYLOAD_OFFSET);
+			break;
+		case OP_MUL:
+		case OP_MUL_I64:
+			assembler.Mul(RAX, STACK_TOP, right + PAYLOAD_OFFSET);
+			break;
+		default:
+			assembler.Cmp(RAX, STACK_TOP, right + PAYLOAD_OFFSET);
+			assembler.SetCond(opCode == OP_LESS || opCode == OP_LESS_I64 ? COND_L : COND_G);
+			assembler.StoreByte(STACK_TOP, left + KIND_OFFSET, ValueKind::BOOL);
+			break;
+		}
+		assembler.Store(STACK_TOP, left + PAYLOAD_OFFSET, RAX);
+		assembler.MoveStackTop(-1);
+		auto done = assembler.Jump();
+
+		assembler.Bind(leftSlow);
+		assembler.Bind(rightSlow);
+		assembler.CallStub(stub, ip);
+		assembler.Bind(done);
+	}
+#endif
+
+	static uint8_t ToGenericOpCode(uint8_t opCode)
+	{
+		switch (opCode)
+		{
+		case OP_ADD_INT_QUICK:
+		case OP_ADD_REAL_QUICK:
+			return OP_ADD;
+		case OP_SUB_INT_QUICK:
+		case OP_SUB_REAL_QUICK:
+			return OP_SUB;
+		case OP_MUL_INT_QUICK:
+		case OP_MUL_REAL_QUICK:
+			return OP_MUL;
+		case OP_LESS_INT_QUICK:
+		case OP_LESS_REAL_QUICK:
+			return OP_LESS;
+		case OP_GREATER_INT_QUICK:
+		case OP_GREATER_REAL_QUICK:
+			return OP_GREATER;
+		case OP_EQUAL_INT_QUICK:
+		case OP_EQUAL_REAL_QUICK:
+			return OP_EQUAL;
+		default:
+			return opCode;
+		}
+	}
+
+	JitCode *Jit::Compile(FunctionObject *function, const NativeStub *stubs)
+	{
+		auto &chunk = function->chunk;
+
+		Assembler assembler;
+		assembler.Prologue();
+
+		std::vector<uint32_t> entries(chunk.opCodes.size() + 1, UINT32_MAX);
+		for (size_t offset = 0; offset < chunk.opCodes.size(); offset += 1 + BytecodeOptimizePass::GetOperandSize(chunk, offset))
+		{
+			entries[offset] = static_cast<uint32_t>(assembler.Size());
+
+			auto opCode = ToGenericOpCode(chunk.opCodes[offset]);
+			auto ip = chunk.opCodes.data() + offset + 1;
+			auto u8 = [ip](size_t i) -> int32_t
+			{ return ip[i]; };
+			auto u16 = [ip]() -> int32_t
+			{ return (ip[0] << 8) | ip[1]; };
+
+			switch (opCode)
+			{
+			case OP_JUMP:
+			case OP_JUMP_LONG:
+			case OP_LOOP:
+			case OP_LOOP_LONG:
+				assembler.Jump(BytecodeOptimizePass::GetJumpTarget(chunk, offset));
+				break;
+			case OP_CONSTANT:
+				assembler.Push(CONSTANTS, u8(0) * VALUE_SIZE);
+				break;
+			case OP_CONSTANT_LONG:
+				assembler.Push(CONSTANTS, u16() * VALUE_SIZE);
+				break;
+			case OP_GET_LOCAL:
+				assembler.Push(SLOTS, u8(0) * VALUE_SIZE);
+				break;
+			case OP_GET_LOCAL_LONG:
+				assembler.Push(SLOTS, u16() * VALUE_SIZE);
+				break;
+			case OP_GET_GLOBAL:
+				assembler.Push(GLOBALS, u8(0) * VALUE_SIZE);
+				break;
+			case OP_GET_GLOBAL_LONG:
+				assembler.Push(GLOBALS, u16() * VALUE_SIZE);
+				break;
+			case OP_POP:
+				assembler.MoveStackTop(-1);
+				break;
+#ifndef CYS_NAN_BOXING
+			case OP_ADD:
+			case OP_SUB:
+			case OP_MUL:
+			case OP_LESS:
+			case OP_GREATER:
+			case OP_ADD_I64:
+			case OP_SUB_I64:
+			case OP_MUL_I64:
+			case OP_LESS_I64:
+			case OP_GREATER_I64:
+				EmitIntBinary(assembler, stubs[opCode], ip, opCode);
+				break;
+			case OP_SET_LOCAL_POP:
+			case OP_SET_GLOBAL_POP:
+			{
+				// a ref slot writes through its pointer,leave that to the stub
+				auto base = opCode == OP_SET_LOCAL_POP ? SLOTS : GLOBALS;
+				auto slot = u8(0) * VALUE_SIZE;
+				assembler.CmpByte(base, slot + KIND_OFFSET, ValueKind::OBJECT);
+				auto slow = assembler.JumpIf(COND_E);
+				assembler.MoveStackTop(-1);
+				assembler.CopyValue(base, slot, STACK_TOP, 0);
+				auto done = assembler.Jump();
+				assembler.Bind(slow);
+				assembler.CallStub(stubs[opCode], ip);
+				assembler.Bind(done);
+				break;
+			}
+			case OP_SET_LOCAL_LOAD:
+			{
+				auto slot = u8(0) * VALUE_SIZE;
+				assembler.CmpByte(SLOTS, slot + KIND_OFFSET, ValueKind::OBJECT);
+				auto slow = assembler.JumpIf(COND_E);
+				assembler.CopyValue(SLOTS, slot, STACK_TOP, -VALUE_SIZE);
+				auto done = assembler.Jump();
+				assembler.Bind(slow);
+				assembler.CallStub(stubs[opCode], ip);
+				assembler.Bind(done);
+				break;
+			}
+			case OP_INC_LOCAL:
+			{
+				auto slot = u8(0) * VALUE_SIZE;
+				auto constant = u8(1) * VALUE_SIZE;
+				assembler.CmpByte(SLOTS, slot + KIND_OFFSET, ValueKind::INT);
+				auto slotSlow = assembler.JumpIf(COND_NE);
+				assembler.CmpByte(CONSTANTS, constant + KIND_OFFSET, ValueKind::INT);
+				auto constantSlow = assembler.JumpIf(COND_NE);
+				assembler.Load(RAX, SLOTS, slot + PAYLOAD_OFFSET);
+				assembler.Add(RAX, CONSTANTS, constant + PAYLOAD_OFFSET);
+				assembler.Store(SLOTS, slot + PAYLOAD_OFFSET, RAX);
+				auto done = assembler.Jump();
+				assembler.Bind(slotSlow);
+				assembler.Bind(constantSlow);
+				assembler.CallStub(stubs[opCode], ip);
+				assembler.Bind(done);
+				break;
+			}
+			case OP_LESS_LOCAL_CONST_JUMP:
+			{
+				auto target = BytecodeOptimizePass::GetJumpTarget(chunk, offset);
+				auto slot = u8(0) * VALUE_SIZE;
+				auto constant = u8(1) * VALUE_SIZE;
+				assembler.CmpByte(SLOTS, slot + KIND_OFFSET, ValueKind::INT);
+				auto slotSlow = assembler.JumpIf(COND_NE);
+				assembler.CmpByte(CONSTANTS, constant + KIND_OFFSET, ValueKind::INT);
+				auto constantSlow = assembler.JumpIf(COND_NE);
+				assembler.Load(RAX, SLOTS, slot + PAYLOAD_OFFSET);
+				assembler.Cmp(RAX, CONSTANTS, constant + PAYLOAD_OFFSET);
+				assembler.JumpIf(COND_GE, target);
+				auto done = assembler.Jump();
+				assembler.Bind(slotSlow);
+				assembler.Bind(constantSlow);
+				assembler.CallStub(stubs[opCode], ip);
+				assembler.TestAl();
+				assembler.JumpIf(COND_NE, target);
+				assembler.Bind(done);
+				break;
+			}
+			case OP_JUMP_IF_FALSE:
+			case OP_JUMP_IF_FALSE_LONG:
+			case OP_JUMP_IF_FALSE_POP:
+			{
+				auto target = BytecodeOptimizePass::GetJumpTarget(chunk, offset);
+				assembler.CmpByte(STACK_TOP, -VALUE_SIZE + KIND_OFFSET, ValueKind::BOOL);
+				auto slow = assembler.JumpIf(COND_NE);
+				if (opCode == OP_JUMP_IF_FALSE_POP)
+					assembler.MoveStackTop(-1);
+				assembler.CmpByte(STACK_TOP, (opCode == OP_JUMP_IF_FALSE_POP ? 0 : -VALUE_SIZE) + PAYLOAD_OFFSET, 0);
+				assembler.JumpIf(COND_E, target);
+				auto done = assembler.Jump();
+				assembler.Bind(slow);
+				assembler.CallStub(stubs[opCode], ip);
+				assembler.TestAl();
+				assembler.JumpIf(COND_NE, target);
+				assembler.Bind(done);
+				break;
+			}
+			case OP_JUMP_IF_TRUE_POP:
+			{
+				// the stub reports a condition that is not a bool
+				auto target = BytecodeOptimizePass::GetJumpTarget(chunk, offset);
+				assembler.CmpByte(STACK_TOP, -VALUE_SIZE + KIND_OFFSET, ValueKind::BOOL);
+				auto slow = assembler.JumpIf(COND_NE);
+				assembler.MoveStackTop(-1);
+				assembler.CmpByte(STACK_TOP, PAYLOAD_OFFSET, 0);
+				assembler.JumpIf(COND_NE, target);
+				auto done = assembler.Jump();
+				assembler.Bind(slow);
+				assembler.CallStub(stubs[opCode], ip);
+				assembler.TestAl();
+				assembler.JumpIf(COND_NE, target);
+				assembler.Bind(done);
+				break;
+			}
+			case OP_FOR_RANGE_INT:
+			{
+				// counter,end,loop variable
+				auto target = BytecodeOptimizePass::GetJumpTarget(chunk, offset);
+				auto state = u8(0) * VALUE_SIZE;
+				assembler.CmpByte(SLOTS, state + KIND_OFFSET, ValueKind::INT);
+				auto counterSlow = assembler.JumpIf(COND_NE);
+				assembler.CmpByte(SLOTS, state + VALUE_SIZE + KIND_OFFSET, ValueKind::INT);
+				auto endSlow = assembler.JumpIf(COND_NE);
+				assembler.Load(RAX, SLOTS, state + PAYLOAD_OFFSET);
+				assembler.Cmp(RAX, SLOTS, state + VALUE_SIZE + PAYLOAD_OFFSET);
+				assembler.JumpIf(COND_GE, target);
+				assembler.StoreByte(SLOTS, state + 2 * VALUE_SIZE + KIND_OFFSET, ValueKind::INT);
+				assembler.Store(SLOTS, state + 2 * VALUE_SIZE + PAYLOAD_OFFSET, RAX);
+				assembler.IncRax();
+				assembler.Store(SLOTS, state + PAYLOAD_OFFSET, RAX);
+				auto done = assembler.Jump();
+				assembler.Bind(counterSlow);
+				assembler.Bind(endSlow);
+				assembler.CallStub(stubs[opCode], ip);
+				assembler.TestAl();
+				assembler.JumpIf(COND_NE, target);
+				assembler.Bind(done);
+				break;
+			}
+#endif
+			default:
+				if (!stubs[opCode])
+					assembler.Exit(static_cast<uint32_t>(offset));
+				else
+				{
+					assembler.CallStub(stubs[opCode], ip);
+					if (BytecodeOptimizePass::IsJumpOpCode(opCode))
+					{
+						assembler.TestAl();
+						assembler.JumpIf(COND_NE, BytecodeOptimizePass::GetJumpTarget(chunk, offset));
+					}
+				}
+				break;
+			}
+		}
+
+		// jumps to the end of chunk
+		entries[chunk.opCodes.size()] = static_cast<uint32_t>(assembler.Size());
+		assembler.Exit(static_cast<uint32_t>(chunk.opCodes.size()));
+
+		assembler.PatchJumps(entries);
+
+		auto size = assembler.Size();
+		auto code = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (code == MAP_FAILED)
+			return nullptr;
+
+		std::memcpy(code, assembler.Code().data(), size);
+		if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0)
+		{
+			munmap(code, size);
+			return nullptr;
+		}
+
+		auto result = new JitCode();
+		result->code = static_cast<uint8_t *>(code);
+		result->size = size;
+		result->entries = std::move(entries);
+		return result;
+	}
+
+	void Jit::Release(JitCode *jitCode)
+	{
+		if (!jitCode)
+			return;
+		munmap(jitCode->code, jitCode->size);
+		delete jitCode;
+	}
+}
+#endif
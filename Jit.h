@@ -0,0 +1,30 @@
+#pragma once
+#ifdef CYS_JIT
+#include <vector>
+#include "VM.h"
+namespace CynicScript
+{
+    // a function is compiled once its calls and loop iterations add up to this
+    constexpr uint32_t JIT_THRESHOLD = 1000;
+
+    struct JitCode
+    {
+        // enter the compiled code at the opcode at offset,returns the offset of the opcode the interpreter has to continue with
+        uint32_t Run(NativeContext *context, uint32_t offset) const;
+
+        uint8_t *code{nullptr};
+        size_t size{0};
+        std::vector<uint32_t> entries; // native offset of every opcode,indexed by bytecode offset
+    };
+
+    // baseline template jit for x86-64 linux:loads,stores,int arithmetic and branches are emitted inline,other opcodes call
+    // their stub,jumps and loops become native branches.opcodes without a stub leave the compiled code and let the interpreter run them
+    class CYS_API Jit
+    {
+    public:
+        // returns nullptr if the code could not be mapped executable
+        static JitCode *Compile(FunctionObject *function, const NativeStub *stubs);
+        static void Release(JitCode *jitCode);
+    };
+}
+#endif
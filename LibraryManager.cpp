@@ -123,6 +123,7 @@ namespace CynicScript
                                                                          CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("[Native function 'insert']:Index out of array's range"));
 
                                                                      array->elements.insert(array->elements.begin() + iIndex, 1, args[2]);
+                                                                     WRITE_BARRIER(array);
                                                                  }
                                                                  else if (CYS_IS_DICT_VALUE(args[0]))
                                                                  {
@@ -133,6 +134,7 @@ namespace CynicScript
                                                                              CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("[Native function 'insert']:Already exist value in the dict object of arg1") + args[1].ToString());
 
                                                                      dict->elements[args[1]] = args[2];
+                                                                     WRITE_BARRIER(dict);
                                                                  }
                                                                  else if (CYS_IS_STR_VALUE(args[0]))
                                                                  {
@@ -217,7 +219,7 @@ namespace CynicScript
                                                                     if (!CYS_IS_OBJECT_VALUE(args[0]))
                                                                         CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("[Native function 'addressof']:The arg0 is a value,only object has address."));
 
-                                                                    result = new StrObject(PointerAddressToString(args[0].object));
+                                                                    result = new StrObject(PointerAddressToString(CYS_TO_OBJECT_VALUE(args[0])));
                                                                     return true;
                                                                 });
 
@@ -1,36 +1,45 @@
 #include "Object.h"
+#include <algorithm>
 #include "Chunk.h"
 #include "Common.h"
 #include "Logger.h"
 #include "Allocator.h"
+#include "Jit.h"
+#include "RegisterCompiler.h"
 namespace CynicScript
 {
 
 	Object::Object(ObjectKind kind)
-		: kind(kind), marked(false), next(nullptr)
+		: kind(kind), marked(0), next(nullptr)
 	{
 	}
 
 	void Object::Mark()
 	{
-		if (marked)
+		auto allocator = Allocator::GetInstance();
+		if (allocator->mIsParallelMarking)
+		{
+			allocator->MarkInParallel(this);
+			return;
+		}
+		if (marked == allocator->mMarkEpoch)
 			return;
 #ifndef NDEBUG
 		if (Config::GetInstance()->IsDebugGC())
 			CYS_LOG_INFO(TEXT("(0x{}) mark: {}"), (void *)this, ToString());
 #endif
-		marked = true;
-		Allocator::GetInstance()->mGrayObjects.emplace_back(this);
+		marked = allocator->mMarkEpoch;
+		allocator->mGrayObjects.emplace_back(this);
 	}
 	void Object::UnMark()
 	{
-		if (!marked)
+		if (marked == 0)
 			return;
 #ifndef NDEBUG
 		if (Config::GetInstance()->IsDebugGC())
 			CYS_LOG_INFO(TEXT("(0x{}) unMark: {}"), (void *)this, ToString());
 #endif
-		marked = false;
+		marked = 0;
 	}
 
 	void Object::Blacken()
@@ -239,6 +248,14 @@ namespace CynicScript
 	{
 	}
 
+	FunctionObject::~FunctionObject()
+	{
+		RegisterCompiler::Release(registerCode);
+#ifdef CYS_JIT
+		Jit::Release(jitCode);
+#endif
+	}
+
 	STRING FunctionObject::ToString() const
 	{
 		return TEXT("<fn ") + name + TEXT(":0x") + PointerAddressToString((void *)this) + TEXT(">");
@@ -295,6 +312,7 @@ namespace CynicScript
 	void FunctionObject::SetCache(size_t hash, const std::vector<Value> &result)
 	{
 		caches[hash] = result;
+		Allocator::GetInstance()->WriteBarrier(this);
 	}
 	bool FunctionObject::GetCache(size_t hash, std::vector<Value> &result) const
 	{
@@ -424,8 +442,8 @@ namespace CynicScript
 		return std::vector<uint8_t>();
 	}
 
-	RefObject::RefObject(Value *pointer)
-		: Object(ObjectKind::REF), pointer(pointer)
+	RefObject::RefObject(Value *pointer, Object *owner)
+		: Object(ObjectKind::REF), pointer(pointer), owner(owner)
 	{
 	}
 
@@ -434,6 +452,13 @@ namespace CynicScript
 		return pointer->ToString();
 	}
 
+	void RefObject::Blacken()
+	{
+		Object::Blacken();
+		if (owner)
+			owner->Mark();
+	}
+
 	bool RefObject::IsEqualTo(Object *other)
 	{
 		if (!CYS_IS_REF_OBJ(other))
@@ -447,6 +472,8 @@ namespace CynicScript
 		return std::vector<uint8_t>();
 	}
 
+	uint32_t ClassObject::sEpoch = 0;
+
 	ClassObject::ClassObject()
 		: Object(ObjectKind::CLASS)
 	{
@@ -457,6 +484,11 @@ namespace CynicScript
 	{
 	}
 
+	ClassObject::~ClassObject()
+	{
+		sEpoch++; // a new class may reuse this address
+	}
+
 	STRING ClassObject::ToString() const
 	{
 		STRING result = TEXT("class ") + name;
@@ -479,6 +511,10 @@ namespace CynicScript
 		Object::Blacken();
 		for (auto &[k, v] : defaultMembers)
 			v.Mark();
+		for (auto &[k, v] : functions)
+			v.Mark();
+		for (auto &[k, v] : enums)
+			v.Mark();
 		for (auto &[k, v] : parents)
 			v->Mark();
 		for (auto &[k, v] : constructors)
@@ -534,6 +570,34 @@ namespace CynicScript
 		return GetParentMember(name, retV);
 	}
 
+	bool ClassObject::IsConstMember(const STRING &name)
+	{
+		if (defaultMembers.contains(name))
+			return constMembers.contains(name);
+		if (functions.contains(name) || enums.contains(name))
+			return true;
+
+		Value member;
+		for (const auto &[k, parent] : parents)
+		{
+			if (parent->GetMember(name, member))
+				return parent->IsConstMember(name);
+		}
+		return false;
+	}
+
+	uint32_t ClassObject::GetMemberSlot(const STRING &name)
+	{
+		auto iter = memberSlots.find(name);
+		if (iter != memberSlots.end())
+			return iter->second;
+
+		auto slot = static_cast<uint32_t>(memberSlots.size());
+		memberSlots[name] = slot;
+		sEpoch++;
+		return slot;
+	}
+
 	bool ClassObject::GetParentMember(const STRING &name, Value &retV)
 	{
 		if (!parents.empty())
@@ -564,8 +628,8 @@ namespace CynicScript
 	ClassInstanceObject::ClassInstanceObject(ClassObject *klass)
 		: Object(ObjectKind::CLASS_INSTANCE), klass(klass)
 	{
-		if (!klass->defaultMembers.empty())
-			members = klass->defaultMembers;
+		for (const auto &[k, v] : klass->defaultMembers)
+			SetOwnMember(k, v);
 
 		ObtainParentMembers(klass);
 	}
@@ -578,8 +642,13 @@ namespace CynicScript
 	void ClassInstanceObject::Blacken()
 	{
 		Object::Blacken();
-		for (auto &[k, v] : members)
-			v.Mark();
+		if (klass)
+			klass->Mark();
+		for (size_t i = 0; i < members.size(); ++i)
+		{
+			if (ownSlots[i])
+				members[i].Mark();
+		}
 	}
 
 	bool ClassInstanceObject::IsEqualTo(Object *other)
@@ -587,8 +656,16 @@ namespace CynicScript
 		if (!CYS_IS_CLASS_INSTANCE_OBJ(other))
 			return false;
 		auto klassInstance = CYS_TO_CLASS_INSTANCE_OBJ(other);
-		if (members != klassInstance->members)
+		if (std::count(ownSlots.begin(), ownSlots.end(), true) != std::count(klassInstance->ownSlots.begin(), klassInstance->ownSlots.end(), true))
 			return false;
+		for (const auto &[name, slot] : klass->memberSlots)
+		{
+			if (!IsOwnSlot(slot))
+				continue;
+			auto otherMember = klassInstance->GetOwnMember(name);
+			if (!otherMember || members[slot] != *otherMember)
+				return false;
+		}
 		return true;
 	}
 
@@ -600,36 +677,45 @@ namespace CynicScript
 
 	bool ClassInstanceObject::GetMember(const STRING &name, Value &retV)
 	{
+		if (auto member = GetOwnMember(name))
 		{
-			auto iter = members.find(name);
-			if (iter != members.end())
-			{
-				retV = iter->second;
-				return true;
-			}
+			retV = *member;
+			return true;
 		}
+
+		return klass->GetMember(name, retV);
+	}
+
+	Value *ClassInstanceObject::GetOwnMember(const STRING &name)
+	{
+		auto iter = klass->memberSlots.find(name);
+		if (iter == klass->memberSlots.end() || !IsOwnSlot(iter->second))
+			return nullptr;
+		return &members[iter->second];
+	}
+
+	void ClassInstanceObject::SetOwnMember(const STRING &name, const Value &value)
+	{
+		auto slot = klass->GetMemberSlot(name);
+		if (slot >= members.size())
 		{
-			for(const auto& [name,memberPair]:parentMembers)
-			{
-				auto iter = memberPair.find(name);
-				if (iter != memberPair.end())
-				{
-					retV = iter->second;
-					return true;
-				}
-			}
+			members.resize(slot + 1);
+			ownSlots.resize(slot + 1, false);
 		}
-
-		return klass->GetMember(name,retV);
+		members[slot] = value;
+		ownSlots[slot] = true;
 	}
 
 	void ClassInstanceObject::ObtainParentMembers(ClassObject *classObj)
 	{
-		if(classObj->parents.empty())
-			return;
-		for(const auto &[name, parent] : classObj->parents)
+		// parent members are copied into the instance too,the class's own members shadow them
+		for (const auto &[name, parent] : classObj->parents)
 		{
-			parentMembers[name] = parent->defaultMembers;
+			for (const auto &[k, v] : parent->defaultMembers)
+			{
+				if (!GetOwnMember(k))
+					SetOwnMember(k, v);
+			}
 			ObtainParentMembers(parent);
 		}
 	}
@@ -786,4 +872,29 @@ namespace CynicScript
 		}
 		return false;
 	}
+
+#ifdef CYS_NAN_BOXING
+	BoxedIntObject::BoxedIntObject(int64_t value)
+		: Object(ObjectKind::BOXED_INT), value(value)
+	{
+	}
+
+	STRING BoxedIntObject::ToString() const
+	{
+		return CYS_TO_STRING(value);
+	}
+
+	bool BoxedIntObject::IsEqualTo(Object *other)
+	{
+		if (!CYS_IS_BOXED_INT_OBJ(other))
+			return false;
+		return value == CYS_TO_BOXED_INT_OBJ(other)->value;
+	}
+
+	std::vector<uint8_t> BoxedIntObject::Serialize() const
+	{
+		auto byteList = ByteConverter::ToU64ByteList(value);
+		return std::vector<uint8_t>(byteList.begin(), byteList.end());
+	}
+#endif
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <functional>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <map>
 #include "Chunk.h"
 #include "Token.h"
@@ -23,6 +24,7 @@ namespace CynicScript
 #define CYS_IS_CLASS_CLOSURE_BIND_OBJ(obj) ((obj)->kind == ::CynicScript::ObjectKind::CLASS_CLOSURE_BIND)
 #define CYS_IS_ENUM_OBJ(obj) ((obj)->kind == ::CynicScript::ObjectKind::ENUM)
 #define CYS_IS_MODULE_OBJ(obj) ((obj)->kind == ::CynicScript::ObjectKind::MODULE)
+#define CYS_IS_BOXED_INT_OBJ(obj) ((obj)->kind == ::CynicScript::ObjectKind::BOXED_INT)
 
 #define CYS_TO_STR_OBJ(obj) ((::CynicScript::StrObject *)(obj))
 #define CYS_TO_ARRAY_OBJ(obj) ((::CynicScript::ArrayObject *)(obj))
@@ -38,45 +40,63 @@ namespace CynicScript
 #define CYS_TO_CLASS_CLOSURE_BIND_OBJ(obj) ((::CynicScript::ClassClosureBindObject *)(obj))
 #define CYS_TO_ENUM_OBJ(obj) ((::CynicScript::EnumObject *)(obj))
 #define CYS_TO_MODULE_OBJ(obj) ((::CynicScript::ModuleObject *)(obj))
-
+#define CYS_TO_BOXED_INT_OBJ(obj) ((::CynicScript::BoxedIntObject *)(obj))
+
+#ifdef CYS_NAN_BOXING
+#define CYS_GET_VALUE_KIND(v) ((v).GetKind())
+#define CYS_IS_NULL_VALUE(v) ((v).IsNil())
+#define CYS_IS_INT_VALUE(v) ((v).IsInteger())
+#define CYS_IS_REAL_VALUE(v) ((v).IsReal())
+#define CYS_IS_BOOL_VALUE(v) ((v).IsBool())
+#define CYS_IS_OBJECT_VALUE(v) ((v).IsObject())
+
+#define CYS_TO_INT_VALUE(v) ((v).AsInteger())
+#define CYS_TO_REAL_VALUE(v) ((v).AsReal())
+#define CYS_TO_BOOL_VALUE(v) ((v).AsBool())
+#define CYS_TO_OBJECT_VALUE(v) ((v).AsObject())
+#else
+#define CYS_GET_VALUE_KIND(v) ((v).kind)
 #define CYS_IS_NULL_VALUE(v) ((v).kind == ::CynicScript::ValueKind::NIL)
 #define CYS_IS_INT_VALUE(v) ((v).kind == ::CynicScript::ValueKind::INT)
 #define CYS_IS_REAL_VALUE(v) ((v).kind == ::CynicScript::ValueKind::REAL)
 #define CYS_IS_BOOL_VALUE(v) ((v).kind == ::CynicScript::ValueKind::BOOL)
 #define CYS_IS_OBJECT_VALUE(v) ((v).kind == ::CynicScript::ValueKind::OBJECT)
-#define CYS_IS_STR_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_STR_OBJ((v).object))
-#define CYS_IS_ARRAY_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_ARRAY_OBJ((v).object))
-#define CYS_IS_DICT_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_TABLE_OBJ((v).object))
-#define CYS_IS_STRUCT_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_STRUCT_OBJ((v).object))
-#define CYS_IS_FUNCTION_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_FUNCTION_OBJ((v).object))
-#define CYS_IS_UPVALUE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_UPVALUE_OBJ((v).object))
-#define CYS_IS_CLOSURE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLOSURE_OBJ((v).object))
-#define CYS_IS_NATIVE_FUNCTION_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_NATIVE_FUNCTION_OBJ((v).object))
-#define CYS_IS_REF_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_REF_OBJ((v).object))
-#define CYS_IS_CLASS_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLASS_OBJ((v).object))
-#define CYS_IS_CLASS_INSTANCE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLASS_INSTANCE_OBJ((v).object))
-#define CYS_IS_CLASS_CLOSURE_BIND_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLASS_CLOSURE_BIND_OBJ((v).object))
-#define CYS_IS_ENUM_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_ENUM_OBJ((v).object))
-#define CYS_IS_MODULE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_MODULE_OBJ((v).object))
 
 #define CYS_TO_INT_VALUE(v) ((v).integer)
 #define CYS_TO_REAL_VALUE(v) ((v).realnum)
 #define CYS_TO_BOOL_VALUE(v) ((v).boolean)
 #define CYS_TO_OBJECT_VALUE(v) ((v).object)
-#define CYS_TO_STR_VALUE(v) (CYS_TO_STR_OBJ((v).object))
-#define CYS_TO_ARRAY_VALUE(v) (CYS_TO_ARRAY_OBJ((v).object))
-#define CYS_TO_DICT_VALUE(v) (CYS_TO_TABLE_OBJ((v).object))
-#define CYS_TO_STRUCT_VALUE(v) (CYS_TO_STRUCT_OBJ((v).object))
-#define CYS_TO_FUNCTION_VALUE(v) (CYS_TO_FUNCTION_OBJ((v).object))
-#define CYS_TO_UPVALUE_VALUE(v) (CYS_TO_UPVALUE_OBJ((v).object))
-#define CYS_TO_CLOSURE_VALUE(v) (CYS_TO_CLOSURE_OBJ((v).object))
-#define CYS_TO_NATIVE_FUNCTION_VALUE(v) (CYS_TO_NATIVE_FUNCTION_OBJ((v).object))
-#define CYS_TO_REF_VALUE(v) (CYS_TO_REF_OBJ((v).object))
-#define CYS_TO_CLASS_VALUE(v) (CYS_TO_CLASS_OBJ((v).object))
-#define CYS_TO_CLASS_INSTANCE_VALUE(v) (CYS_TO_CLASS_INSTANCE_OBJ((v).object))
-#define CYS_TO_CLASS_CLOSURE_BIND_VALUE(v) (CYS_TO_CLASS_CLOSURE_BIND_OBJ((v).object))
-#define CYS_TO_ENUM_VALUE(v) (CYS_TO_ENUM_OBJ((v).object))
-#define CYS_TO_MODULE_VALUE(v) (CYS_TO_MODULE_OBJ((v).object))
+#endif
+
+#define CYS_IS_STR_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_STR_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_ARRAY_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_ARRAY_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_DICT_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_TABLE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_STRUCT_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_STRUCT_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_FUNCTION_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_FUNCTION_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_UPVALUE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_UPVALUE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_CLOSURE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLOSURE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_NATIVE_FUNCTION_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_NATIVE_FUNCTION_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_REF_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_REF_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_CLASS_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLASS_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_CLASS_INSTANCE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLASS_INSTANCE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_CLASS_CLOSURE_BIND_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_CLASS_CLOSURE_BIND_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_ENUM_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_ENUM_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_IS_MODULE_VALUE(v) (CYS_IS_OBJECT_VALUE(v) && CYS_IS_MODULE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+
+#define CYS_TO_STR_VALUE(v) (CYS_TO_STR_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_ARRAY_VALUE(v) (CYS_TO_ARRAY_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_DICT_VALUE(v) (CYS_TO_TABLE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_STRUCT_VALUE(v) (CYS_TO_STRUCT_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_FUNCTION_VALUE(v) (CYS_TO_FUNCTION_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_UPVALUE_VALUE(v) (CYS_TO_UPVALUE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_CLOSURE_VALUE(v) (CYS_TO_CLOSURE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_NATIVE_FUNCTION_VALUE(v) (CYS_TO_NATIVE_FUNCTION_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_REF_VALUE(v) (CYS_TO_REF_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_CLASS_VALUE(v) (CYS_TO_CLASS_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_CLASS_INSTANCE_VALUE(v) (CYS_TO_CLASS_INSTANCE_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_CLASS_CLOSURE_BIND_VALUE(v) (CYS_TO_CLASS_CLOSURE_BIND_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_ENUM_VALUE(v) (CYS_TO_ENUM_OBJ(CYS_TO_OBJECT_VALUE(v)))
+#define CYS_TO_MODULE_VALUE(v) (CYS_TO_MODULE_OBJ(CYS_TO_OBJECT_VALUE(v)))
 
     enum CYS_API ObjectKind : uint8_t
     {
@@ -93,7 +113,8 @@ namespace CynicScript
         CLASS_INSTANCE,
         CLASS_CLOSURE_BIND,
         ENUM,
-        MODULE
+        MODULE,
+        BOXED_INT,
     };
 
     struct CYS_API Object
@@ -110,7 +131,9 @@ namespace CynicScript
         virtual std::vector<uint8_t> Serialize() const = 0;
 
         const ObjectKind kind;
-        bool marked{false};
+        uint8_t marked{0};        // the mark epoch of the major collection that last reached this object,0 for never
+        bool isRemembered{false}; // in the allocator's remembered set,see Allocator::WriteBarrier
+        uint32_t size{0};         // bytes counted by the allocator
         Object *next{nullptr};
     };
 
@@ -168,11 +191,13 @@ namespace CynicScript
         std::unordered_map<STRING, Value> elements{};
     };
 
+    struct ClassObject;
+
     struct CYS_API FunctionObject : public Object
     {
         FunctionObject();
         FunctionObject(STRING_VIEW name);
-        ~FunctionObject() override = default;
+        ~FunctionObject() override;
 
         STRING ToString() const override;
 #ifndef NDEBUG
@@ -188,6 +213,67 @@ namespace CynicScript
         std::unordered_map<size_t, std::vector<Value>> caches;
         // -- Function cache relative
 
+        // ++ Predecoding relative
+        // chunk.opCodes decoded once before the first closure of the function is created,the interpreter runs these.
+        // the bytes stay for serialization,disassembly and compiled code
+        std::vector<DecodedInstruction> decodedInstructions;
+        std::vector<uint32_t> decodedIndices; // opcode offset -> index in decodedInstructions
+        // -- Predecoding relative
+
+        // ++ Quickening relative
+        struct QuickenSite
+        {
+            uint16_t counter{0}; // how many times the generic opcode saw a quickenable operand pair
+            uint8_t backoff{0};  // doubles the warm up threshold every time the quick opcode deoptimizes
+        };
+        std::vector<QuickenSite> quickenSites; // one per generic or quick arithmetic and compare opcode,numbered by VM::Predecode
+        uint32_t quickenedCount{0};            // opcodes currently rewritten into their *_QUICK form
+        // -- Quickening relative
+
+        // ++ Property inline cache relative
+        struct PropertyCache
+        {
+            enum Kind : uint8_t
+            {
+                EMPTY,
+                FIELD,        // own member of the receiver at slot
+                CLASS_MEMBER, // resolved through the class(functions,enums,defaults),valid while the receiver does not own slot
+                MEGAMORPHIC,  // too many receiver classes,always take the slow path
+            };
+
+            Kind kind{EMPTY};
+            uint8_t missCount{0};
+            uint32_t epoch{0};
+            uint32_t slot{UINT32_MAX};
+            ClassObject *klass{nullptr};
+            Value member{};
+        };
+        std::vector<PropertyCache> propertyCaches; // one per GET_PROPERTY and SET_PROPERTY,numbered by VM::Predecode
+        // -- Property inline cache relative
+
+        // ++ Native code relative
+        // set when an aot module(see Aot.h) provides machine code for this chunk,runs from the opcode at offset
+        // and returns the offset of the opcode the interpreter continues with
+        uint32_t (*aotEntry)(struct NativeContext *context, uint32_t offset){nullptr};
+        // -- Native code relative
+
+        // ++ Register backend relative
+        bool isRegisterCompiled{false};             // translated on the first call,registerCode stays nullptr if the function keeps the stack vm
+        struct RegisterCode *registerCode{nullptr}; // see RegisterCompiler.h
+        // -- Register backend relative
+
+#ifdef CYS_JIT
+        // ++ Jit relative
+        uint32_t jitHotness{0}; // calls and loop iterations,counts up to JIT_THRESHOLD
+        struct JitCode *jitCode{nullptr};
+        // -- Jit relative
+#endif
+
+        // ++ Verifier relative
+        bool isVerified{false};
+        uint32_t maxStackDepth{0}; // stack slots a frame of this function uses at most,the callee and arguments included
+        // -- Verifier relative
+
         uint8_t arity{0};
         VarArg varArg{VarArg::NONE};
         int8_t upValueCount{0};
@@ -243,21 +329,23 @@ namespace CynicScript
 
     struct CYS_API RefObject : public Object
     {
-        RefObject(Value *pointer);
+        RefObject(Value *pointer, Object *owner = nullptr);
         ~RefObject() override = default;
 
         STRING ToString() const override;
+        void Blacken() override;
         bool IsEqualTo(Object *other) override;
         std::vector<uint8_t> Serialize() const override;
 
         Value *pointer{nullptr};
+        Object *owner{nullptr}; // the array,dict or upvalue pointer points into,nullptr for stack slots and globals
     };
 
     struct CYS_API ClassObject : public Object
     {
         ClassObject();
         ClassObject(STRING_VIEW name);
-        ~ClassObject() override = default;
+        ~ClassObject() override;
 
         STRING ToString() const override;
         void Blacken() override;
@@ -266,13 +354,25 @@ namespace CynicScript
 
         bool GetMember(const STRING &name, Value &retV);
         bool GetParentMember(const STRING &name, Value &retV);
+        // const members,functions and enums cannot be reassigned
+        bool IsConstMember(const STRING &name);
+
+        uint32_t GetMemberSlot(const STRING &name);
 
         STRING name{};
         std::map<int32_t, ClosureObject *> constructors{}; // argument count as key for now
         std::unordered_map<STRING, Value> defaultMembers{};
+        std::unordered_set<STRING> constMembers{}; // names in defaultMembers declared with const
         std::unordered_map<STRING, Value> functions{};
         std::unordered_map<STRING, Value> enums{};
         std::map<STRING, ClassObject *> parents{};
+
+        // member layout shared by every instance of this class,slots are only ever appended
+        std::unordered_map<STRING, uint32_t> memberSlots{};
+
+        // bumped whenever a member layout grows,a class-level member is reassigned or a class is freed,
+        // property inline caches recorded under an older epoch are stale
+        static uint32_t sEpoch;
     };
 
     struct CYS_API ClassInstanceObject : public Object
@@ -288,11 +388,18 @@ namespace CynicScript
 
         bool GetMember(const STRING &name, Value &retV);
 
+        Value *GetOwnMember(const STRING &name);
+        void SetOwnMember(const STRING &name, const Value &value);
+        bool IsOwnSlot(uint32_t slot) const
+        {
+            return slot < ownSlots.size() && ownSlots[slot];
+        }
+
         void ObtainParentMembers(ClassObject *classObj);
 
         ClassObject *klass;
-        std::unordered_map<STRING, Value> members{};
-        std::map<STRING, std::unordered_map<STRING,Value>> parentMembers{};//collect parent members
+        std::vector<Value> members{};   // indexed by klass->memberSlots
+        std::vector<bool> ownSlots{};   // whether members[slot] is set on this instance,otherwise lookups fall back to the class
     };
 
     struct CYS_API ClassClosureBindObject : public Object
@@ -343,4 +450,19 @@ namespace CynicScript
         STRING name{};
         std::unordered_map<STRING, Value> members{};
     };
+
+#ifdef CYS_NAN_BOXING
+    // holds an integer that does not fit into the 48 bit payload of a nan boxed value
+    struct CYS_API BoxedIntObject : public Object
+    {
+        BoxedIntObject(int64_t value);
+        ~BoxedIntObject() override = default;
+
+        STRING ToString() const override;
+        bool IsEqualTo(Object *other) override;
+        std::vector<uint8_t> Serialize() const override;
+
+        int64_t value{0};
+    };
+#endif
 }
\ No newline at end of file
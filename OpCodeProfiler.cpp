@@ -0,0 +1,108 @@
+#include "OpCodeProfiler.h"
+#ifdef CYS_OPCODE_PROFILE
+#include <algorithm>
+#include <iomanip>
+#include "Chunk.h"
+namespace CynicScript
+{
+	OpCodeProfiler::OpCodeProfiler()
+		: mPairCounts(UINT8_COUNT * UINT8_COUNT)
+	{
+	}
+
+	void OpCodeProfiler::Break() noexcept
+	{
+		mHasPrevious = false;
+	}
+
+	bool OpCodeProfiler::IsEmpty() const noexcept
+	{
+		return std::all_of(mCounts.begin(), mCounts.end(), [](uint64_t count)
+						   { return count == 0; });
+	}
+
+	STRING OpCodeProfiler::ToTable(size_t maxPairCount) const
+	{
+		uint64_t total = 0;
+		uint64_t totalCycles = 0;
+		std::vector<uint8_t> opCodes;
+		for (int32_t i = 0; i < UINT8_COUNT; ++i)
+		{
+			total += mCounts[i];
+			totalCycles += mCycles[i];
+			if (mCounts[i] > 0)
+				opCodes.emplace_back(static_cast<uint8_t>(i));
+		}
+		std::stable_sort(opCodes.begin(), opCodes.end(), [this](uint8_t left, uint8_t right)
+						 { return mCounts[left] > mCounts[right]; });
+
+		STRING_STREAM stream;
+		stream << std::fixed << std::setprecision(2);
+		stream << std::left << std::setw(32) << TEXT("opcode") << std::right << std::setw(16) << TEXT("count") << std::setw(10) << TEXT("%");
+		if (totalCycles > 0)
+			stream << std::setw(18) << TEXT("cycles") << std::setw(10) << TEXT("%") << std::setw(12) << TEXT("cycles/op");
+		stream << std::endl;
+
+		for (auto opCode : opCodes)
+		{
+			stream << std::left << std::setw(32) << GetOpCodeName(opCode) << std::right << std::setw(16) << mCounts[opCode] << std::setw(10) << mCounts[opCode] * 100.0 / total;
+			if (totalCycles > 0)
+				stream << std::setw(18) << mCycles[opCode] << std::setw(10) << mCycles[opCode] * 100.0 / totalCycles << std::setw(12) << static_cast<double>(mCycles[opCode]) / mCounts[opCode];
+			stream << std::endl;
+		}
+		stream << std::left << std::setw(32) << TEXT("total") << std::right << std::setw(16) << total << std::endl;
+
+		std::vector<uint32_t> pairs;
+		for (uint32_t i = 0; i < mPairCounts.size(); ++i)
+			if (mPairCounts[i] > 0)
+				pairs.emplace_back(i);
+		std::stable_sort(pairs.begin(), pairs.end(), [this](uint32_t left, uint32_t right)
+						 { return mPairCounts[left] > mPairCounts[right]; });
+		if (pairs.size() > maxPairCount)
+			pairs.resize(maxPairCount);
+
+		stream << std::endl
+			   << std::left << std::setw(64) << TEXT("opcode pair") << std::right << std::setw(16) << TEXT("count") << std::setw(10) << TEXT("%") << std::endl;
+		for (auto pair : pairs)
+		{
+			STRING name = STRING(GetOpCodeName(pair / UINT8_COUNT)) + TEXT(" ") + GetOpCodeName(pair % UINT8_COUNT);
+			stream << std::left << std::setw(64) << name << std::right << std::setw(16) << mPairCounts[pair] << std::setw(10) << mPairCounts[pair] * 100.0 / total << std::endl;
+		}
+
+		return stream.str();
+	}
+
+	std::string OpCodeProfiler::ToJson() const
+	{
+		auto name = [](uint8_t opCode)
+		{
+			STRING str = GetOpCodeName(opCode);
+			return std::string(str.begin(), str.end()); // opcode names are ascii
+		};
+
+		std::string result = "{\n\t\"opcodes\": [";
+		bool isFirst = true;
+		for (int32_t i = 0; i < UINT8_COUNT; ++i)
+		{
+			if (mCounts[i] == 0)
+				continue;
+			result += isFirst ? "\n" : ",\n";
+			result += "\t\t{\"name\": \"" + name(i) + "\", \"count\": " + std::to_string(mCounts[i]) + ", \"cycles\": " + std::to_string(mCycles[i]) + "}";
+			isFirst = false;
+		}
+
+		result += "\n\t],\n\t\"pairs\": [";
+		isFirst = true;
+		for (uint32_t i = 0; i < mPairCounts.size(); ++i)
+		{
+			if (mPairCounts[i] == 0)
+				continue;
+			result += isFirst ? "\n" : ",\n";
+			result += "\t\t{\"first\": \"" + name(i / UINT8_COUNT) + "\", \"second\": \"" + name(i % UINT8_COUNT) + "\", \"count\": " + std::to_string(mPairCounts[i]) + "}";
+			isFirst = false;
+		}
+		result += "\n\t]\n}\n";
+		return result;
+	}
+}
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+#ifdef CYS_OPCODE_PROFILE
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#include "Common.h"
+namespace CynicScript
+{
+    // counts every opcode VM::Execute dispatches and every pair of consecutive opcodes,optionally with the time stamp counter
+    // difference between two dispatches charged to the first one.opcodes run by compiled code(jit or aot) are not seen,
+    // their time is charged to the opcode that entered it
+    class CYS_API OpCodeProfiler
+    {
+    public:
+        OpCodeProfiler();
+        ~OpCodeProfiler() = default;
+
+        inline void Record(uint8_t opCode, bool withCycles) noexcept
+        {
+            mCounts[opCode]++;
+            if (mHasPrevious)
+                mPairCounts[mPreviousOpCode * UINT8_COUNT + opCode]++;
+
+            if (withCycles)
+            {
+                auto now = ReadTimestamp();
+                if (mHasPrevious)
+                    mCycles[mPreviousOpCode] += now - mPreviousTimestamp;
+                mPreviousTimestamp = now;
+            }
+
+            mPreviousOpCode = opCode;
+            mHasPrevious = true;
+        }
+
+        // a new Execute() starts,the time between the last dispatch and here belongs to no opcode
+        void Break() noexcept;
+
+        bool IsEmpty() const noexcept;
+
+        STRING ToTable(size_t maxPairCount = 20) const;
+        std::string ToJson() const;
+
+    private:
+        static inline uint64_t ReadTimestamp() noexcept
+        {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+        }
+
+        std::array<uint64_t, UINT8_COUNT> mCounts{};
+        std::array<uint64_t, UINT8_COUNT> mCycles{};
+        std::vector<uint64_t> mPairCounts; // indexed by first*UINT8_COUNT+second
+
+        uint8_t mPreviousOpCode{0};
+        bool mHasPrevious{false};
+        uint64_t mPreviousTimestamp{0};
+    };
+}
+#endif
@@ -558,6 +558,9 @@ namespace CynicScript
 		//		}
 		// }
 
+		if (IsForInStmt())
+			return ParseForInStmt();
+
 		auto token = GetCurToken();
 
 		auto scopeStmt = new ScopeStmt(token);
@@ -618,6 +621,63 @@ namespace CynicScript
 		return scopeStmt;
 	}
 
+	// for(let x in ...) or for(x in ...),'in' is matched as an identifier so it stays usable as a name elsewhere
+	bool Parser::IsForInStmt()
+	{
+		auto pos = mCurPos + 2; // skip 'for' '('
+		if (pos < (int64_t)mTokens.size() && (mTokens[pos]->kind == TokenKind::LET || mTokens[pos]->kind == TokenKind::CONST))
+			pos++;
+		if (pos + 1 >= (int64_t)mTokens.size())
+			return false;
+		return mTokens[pos]->kind == TokenKind::IDENTIFIER && mTokens[pos + 1]->kind == TokenKind::IDENTIFIER && mTokens[pos + 1]->literal == TEXT("in");
+	}
+
+	Stmt *Parser::ParseForInStmt()
+	{
+		auto forInStmt = new ForInStmt(GetCurToken());
+
+		Consume(TokenKind::FOR, TEXT("Expect 'for' keyword."));
+		Consume(TokenKind::LPAREN, TEXT("Expect '(' after 'for'."));
+
+		if (IsMatchCurTokenAndStepOnce(TokenKind::CONST))
+			forInStmt->permission = Permission::IMMUTABLE;
+		else
+			IsMatchCurTokenAndStepOnce(TokenKind::LET);
+
+		auto name = (IdentifierExpr *)ParseIdentifierExpr();
+		forInStmt->variable = new VarDescExpr(name->tagToken, Type(), name);
+
+		Consume(TokenKind::IDENTIFIER, TEXT("Expect 'in' after for-in stmt's variable."));
+
+		if (IsMatchCurToken(TokenKind::IDENTIFIER) && GetCurToken()->literal == TEXT("range") && IsMatchNextToken(TokenKind::LPAREN))
+		{
+			GetCurTokenAndStepOnce();
+			Consume(TokenKind::LPAREN, TEXT("Expect '(' after 'range'."));
+			forInStmt->rangeEnd = ParseExpr();
+			if (IsMatchCurTokenAndStepOnce(TokenKind::COMMA))
+			{
+				forInStmt->rangeBegin = forInStmt->rangeEnd;
+				forInStmt->rangeEnd = ParseExpr();
+			}
+			Consume(TokenKind::RPAREN, TEXT("Expect ')' after range's bound(s)."));
+		}
+		else
+			forInStmt->iterable = ParseExpr();
+
+		Consume(TokenKind::RPAREN, TEXT("Expect ')' after for-in stmt's iterable expr."));
+
+		auto scopeToken = GetCurToken();
+		if (IsMatchCurToken(TokenKind::LBRACE))
+			forInStmt->body = (ScopeStmt *)ParseScopeStmt();
+		else
+		{
+			forInStmt->body = new ScopeStmt(scopeToken);
+			forInStmt->body->stmts.emplace_back(ParseStmt());
+		}
+
+		return forInStmt;
+	}
+
 	Stmt *Parser::ParseBreakStmt()
 	{
 		auto breakStmt = new BreakStmt(GetCurToken());
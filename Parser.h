@@ -75,6 +75,8 @@ namespace CynicScript
 		Stmt *ParseScopeStmt();
 		Stmt *ParseWhileStmt();
 		Stmt *ParseForStmt();
+		Stmt *ParseForInStmt();
+		bool IsForInStmt();
 		Stmt *ParseBreakStmt();
 		Stmt *ParseContinueStmt();
 		Stmt *ParseSwitchStmt();
@@ -0,0 +1,188 @@
+#include "PeepholePass.h"
+namespace CynicScript
+{
+	static bool IsUnconditionalJumpOpCode(uint8_t opCode)
+	{
+		return opCode == OP_JUMP || opCode == OP_JUMP_LONG || opCode == OP_LOOP || opCode == OP_LOOP_LONG;
+	}
+
+	static bool IsBackwardJumpOpCode(uint8_t opCode)
+	{
+		return opCode == OP_LOOP || opCode == OP_LOOP_LONG;
+	}
+
+	void PeepholePass::ExecuteInstructions(InstructionList &instructions)
+	{
+		bool isChanged = true;
+		while (isChanged)
+		{
+			isChanged = false;
+			isChanged |= RemoveUnreachable(instructions);
+			isChanged |= ThreadJumps(instructions);
+			isChanged |= RemovePushPop(instructions);
+			isChanged |= FuseSetLocalLoad(instructions);
+			isChanged |= FoldNotIntoJump(instructions);
+		}
+	}
+
+	bool PeepholePass::RemoveUnreachable(InstructionList &instructions)
+	{
+		std::vector<bool> isReachable(instructions.size(), false);
+		std::vector<size_t> worklist;
+		if (!instructions.empty())
+			worklist.emplace_back(0);
+
+		while (!worklist.empty())
+		{
+			auto idx = worklist.back();
+			worklist.pop_back();
+			if (idx >= instructions.size() || isReachable[idx])
+				continue;
+			isReachable[idx] = true;
+
+			const auto &instruction = instructions[idx];
+			if (instruction.isRemoved)
+			{
+				worklist.emplace_back(idx + 1);
+				continue;
+			}
+
+			if (IsJumpOpCode(instruction.opCode))
+				worklist.emplace_back(static_cast<size_t>(instruction.jumpTarget));
+			if (instruction.opCode != OP_RETURN && !IsUnconditionalJumpOpCode(instruction.opCode))
+				worklist.emplace_back(idx + 1);
+		}
+
+		bool isChanged = false;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			if (!instructions[i].isRemoved && !isReachable[i])
+			{
+				instructions[i].isRemoved = true;
+				isChanged = true;
+			}
+		}
+		return isChanged;
+	}
+
+	bool PeepholePass::ThreadJumps(InstructionList &instructions)
+	{
+		SkipRemovedJumpTargets(instructions);
+
+		bool isChanged = false;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			auto &instruction = instructions[i];
+			if (instruction.isRemoved || !IsJumpOpCode(instruction.opCode))
+				continue;
+
+			// the encoded offset is unsigned,so a forward jump may only be threaded to a later instruction and a loop to an earlier one
+			auto isBackward = IsBackwardJumpOpCode(instruction.opCode);
+			auto target = static_cast<size_t>(instruction.jumpTarget);
+			auto threadedTarget = target;
+			for (size_t hop = 0; hop < instructions.size() && target < instructions.size() && IsUnconditionalJumpOpCode(instructions[target].opCode); ++hop)
+			{
+				target = static_cast<size_t>(instructions[target].jumpTarget);
+				if (isBackward ? target <= i : target > i)
+					threadedTarget = target;
+			}
+
+			if (threadedTarget != static_cast<size_t>(instruction.jumpTarget))
+			{
+				instruction.jumpTarget = static_cast<int64_t>(threadedTarget);
+				isChanged = true;
+			}
+
+			if ((instruction.opCode == OP_JUMP || instruction.opCode == OP_JUMP_LONG) && threadedTarget == NextLiveInstruction(instructions, i))
+			{
+				instruction.isRemoved = true;
+				isChanged = true;
+			}
+		}
+		return isChanged;
+	}
+
+	bool PeepholePass::RemovePushPop(InstructionList &instructions)
+	{
+		SkipRemovedJumpTargets(instructions);
+		auto jumpTargets = StatsJumpTargets(instructions);
+
+		bool isChanged = false;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			auto opCode = instructions[i].opCode;
+			if (instructions[i].isRemoved || (opCode != OP_CONSTANT && opCode != OP_CONSTANT_LONG && opCode != OP_NULL))
+				continue;
+
+			auto next = NextLiveInstruction(instructions, i);
+			if (next >= instructions.size() || instructions[next].opCode != OP_POP || jumpTargets[next] > 0)
+				continue;
+
+			instructions[i].isRemoved = true;
+			instructions[next].isRemoved = true;
+			isChanged = true;
+		}
+		return isChanged;
+	}
+
+	bool PeepholePass::FuseSetLocalLoad(InstructionList &instructions)
+	{
+		SkipRemovedJumpTargets(instructions);
+		auto jumpTargets = StatsJumpTargets(instructions);
+
+		bool isChanged = false;
+		std::vector<size_t> indices;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			if (!MatchSequence(instructions, i, {OP_SET_LOCAL_POP, OP_GET_LOCAL}, indices))
+				continue;
+			if (instructions[indices[0]].operands[0] != instructions[indices[1]].operands[0] || jumpTargets[indices[1]] > 0)
+				continue;
+
+			instructions[indices[0]].opCode = OP_SET_LOCAL_LOAD;
+			instructions[indices[1]].isRemoved = true;
+			isChanged = true;
+		}
+		return isChanged;
+	}
+
+	bool PeepholePass::FoldNotIntoJump(InstructionList &instructions)
+	{
+		SkipRemovedJumpTargets(instructions);
+		auto jumpTargets = StatsJumpTargets(instructions);
+
+		bool isChanged = false;
+		std::vector<size_t> indices;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			if (!MatchSequence(instructions, i, {OP_NOT, OP_JUMP_IF_FALSE_POP}, indices))
+				continue;
+			if (jumpTargets[indices[1]] > 0)
+				continue;
+
+			// NOT's token,a condition that is not a bool is reported where it was before
+			auto &jump = instructions[indices[1]];
+			jump.opCode = OP_JUMP_IF_TRUE_POP;
+			jump.token = instructions[indices[0]].token;
+			instructions[indices[0]].isRemoved = true;
+			isChanged = true;
+		}
+		return isChanged;
+	}
+
+	void PeepholePass::SkipRemovedJumpTargets(InstructionList &instructions)
+	{
+		for (auto &instruction : instructions)
+		{
+			if (!instruction.isRemoved && IsJumpOpCode(instruction.opCode))
+				instruction.jumpTarget = static_cast<int64_t>(FirstLiveInstruction(instructions, static_cast<size_t>(instruction.jumpTarget)));
+		}
+	}
+
+	size_t PeepholePass::FirstLiveInstruction(const InstructionList &instructions, size_t idx)
+	{
+		if (idx >= instructions.size() || !instructions[idx].isRemoved)
+			return idx;
+		return NextLiveInstruction(instructions, idx);
+	}
+}
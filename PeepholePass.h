@@ -0,0 +1,33 @@
+#pragma once
+#include "BytecodeOptimizePass.h"
+
+namespace CynicScript
+{
+    // clean up what the ast directed compiler leaves behind,repeated until nothing changes:
+    // instructions no path from the entry reaches(code after RETURN,JUMP or LOOP) are removed
+    // a jump landing on an unconditional jump goes to that jump's target directly,a JUMP to the next instruction is removed
+    // CONSTANT POP,NULL POP                     -> removed
+    // SET_LOCAL_POP x GET_LOCAL x               -> SET_LOCAL_LOAD x
+    // NOT JUMP_IF_FALSE_POP                     -> JUMP_IF_TRUE_POP
+    // runs after SuperInstructionPass,so it sees the fused forms
+    class CYS_API PeepholePass : public BytecodeOptimizePass
+    {
+    public:
+        PeepholePass() noexcept = default;
+        virtual ~PeepholePass() override = default;
+
+    protected:
+        void ExecuteInstructions(InstructionList &instructions) override;
+
+    private:
+        bool RemoveUnreachable(InstructionList &instructions);
+        bool ThreadJumps(InstructionList &instructions);
+        bool RemovePushPop(InstructionList &instructions);
+        bool FuseSetLocalLoad(InstructionList &instructions);
+        bool FoldNotIntoJump(InstructionList &instructions);
+
+        // a jump to a removed instruction lands on the next live one,make that explicit so jump target stats stay exact
+        void SkipRemovedJumpTargets(InstructionList &instructions);
+        size_t FirstLiveInstruction(const InstructionList &instructions, size_t idx);
+    };
+}
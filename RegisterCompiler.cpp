@@ -0,0 +1,590 @@
+#include "RegisterCompiler.h"
+#include <algorithm>
+#include "BytecodeOptimizePass.h"
+#include "Verifier.h"
+#include "Logger.h"
+namespace CynicScript
+{
+	constexpr int32_t UNKNOWN_DEPTH = -1;
+
+	// the generic,typed and quickened forms of a binary opcode all run as the generic register opcode,
+	// UINT8_MAX if the opcode is not a binary one
+	static uint8_t GetRegisterBinaryOpCode(uint8_t opCode)
+	{
+		switch (opCode)
+		{
+		case OP_ADD:
+		case OP_ADD_I64:
+		case OP_ADD_F64:
+		case OP_ADD_INT_QUICK:
+		case OP_ADD_REAL_QUICK:
+			return ROP_ADD;
+		case OP_SUB:
+		case OP_SUB_I64:
+		case OP_SUB_F64:
+		case OP_SUB_INT_QUICK:
+		case OP_SUB_REAL_QUICK:
+			return ROP_SUB;
+		case OP_MUL:
+		case OP_MUL_I64:
+		case OP_MUL_F64:
+		case OP_MUL_INT_QUICK:
+		case OP_MUL_REAL_QUICK:
+			return ROP_MUL;
+		case OP_DIV:
+		case OP_DIV_I64:
+		case OP_DIV_F64:
+			return ROP_DIV;
+		case OP_MOD:
+			return ROP_MOD;
+		case OP_BIT_AND:
+			return ROP_BIT_AND;
+		case OP_BIT_OR:
+			return ROP_BIT_OR;
+		case OP_BIT_LEFT_SHIFT:
+			return ROP_BIT_LEFT_SHIFT;
+		case OP_BIT_RIGHT_SHIFT:
+			return ROP_BIT_RIGHT_SHIFT;
+		case OP_LESS:
+		case OP_LESS_I64:
+		case OP_LESS_F64:
+		case OP_LESS_INT_QUICK:
+		case OP_LESS_REAL_QUICK:
+			return ROP_LESS;
+		case OP_GREATER:
+		case OP_GREATER_I64:
+		case OP_GREATER_F64:
+		case OP_GREATER_INT_QUICK:
+		case OP_GREATER_REAL_QUICK:
+			return ROP_GREATER;
+		case OP_EQUAL:
+		case OP_EQUAL_INT_QUICK:
+		case OP_EQUAL_REAL_QUICK:
+			return ROP_EQUAL;
+		default:
+			return UINT8_MAX;
+		}
+	}
+
+	// a compare followed by a conditional jump becomes one compare and branch opcode
+	static uint8_t GetCompareJumpOpCode(uint8_t compareOpCode, bool isJumpIfTrue)
+	{
+		switch (compareOpCode)
+		{
+		case ROP_LESS:
+			return isJumpIfTrue ? ROP_JUMP_IF_LESS : ROP_JUMP_IF_NOT_LESS;
+		case ROP_GREATER:
+			return isJumpIfTrue ? ROP_JUMP_IF_GREATER : ROP_JUMP_IF_NOT_GREATER;
+		case ROP_EQUAL:
+			return isJumpIfTrue ? ROP_JUMP_IF_EQUAL : ROP_JUMP_IF_NOT_EQUAL;
+		default:
+			return UINT8_MAX;
+		}
+	}
+
+	class RegisterTranslator
+	{
+	public:
+		RegisterTranslator(FunctionObject *function)
+			: mFunction(function), mChunk(function->chunk)
+		{
+		}
+
+		RegisterCode *Translate(bool isAlwaysKept);
+
+	private:
+		// where the value of a stack entry is:already in its own slot,still in a local slot or in the constant table
+		struct Operand
+		{
+			enum Kind : uint8_t
+			{
+				REGISTER,
+				LOCAL,
+				CONSTANT,
+			};
+			Kind kind{REGISTER};
+			uint16_t index{0};
+		};
+
+		bool ComputeDepths();
+		bool TranslateOpCode(size_t offset);
+		RegisterCode *Release();
+
+		size_t Emit(uint8_t opCode, uint16_t a, uint16_t b, uint16_t c, size_t offset);
+		void EmitJump(uint8_t opCode, uint16_t b, uint16_t c, size_t offset);
+		void EmitExit(size_t offset);
+
+		uint16_t ToOperand(const Operand &operand) const;
+		Operand Pop();
+		void PushRegister();
+
+		void Materialize(size_t idx, size_t offset);
+		void MaterializeReadersOf(uint16_t slot, size_t offset);
+		void Flush(size_t offset);
+
+		uint8_t ReadU8(size_t offset) const;
+		uint16_t ReadU16(size_t offset) const;
+
+		FunctionObject *mFunction;
+		const Chunk &mChunk;
+		RegisterCode *mCode{nullptr};
+
+		std::vector<int32_t> mDepths;      // stack depth before each opcode,UNKNOWN_DEPTH if not known
+		std::vector<bool> mIsJumpTarget;   // indexed by opcode offset
+		std::vector<int32_t> mTargetPcs;   // where a jump to the opcode at offset lands in the register code
+		std::vector<std::pair<size_t, size_t>> mJumpPatches; // register jump -> opcode offset of its target
+
+		std::vector<Operand> mStack;
+		bool mIsStackValid{false};
+		int64_t mLastComparePc{-1};
+
+		size_t mTranslatedCount{0}; // stack opcodes run by the register code
+		size_t mEmittedCount{0};    // register instructions they became
+	};
+
+	RegisterCode *RegisterTranslator::Translate(bool isAlwaysKept)
+	{
+		if (mFunction->varArg != VarArg::NONE || mChunk.constants.size() >= REGISTER_CONSTANT_BIT || !ComputeDepths())
+			return nullptr;
+
+		mCode = new RegisterCode();
+		mCode->entries.resize(mChunk.opCodes.size());
+		mTargetPcs.assign(mChunk.opCodes.size(), -1);
+
+		for (size_t offset = 0; offset < mChunk.opCodes.size(); offset += 1 + BytecodeOptimizePass::GetOperandSize(mChunk, offset))
+		{
+			auto depth = mDepths[offset];
+			if (depth == UNKNOWN_DEPTH)
+			{
+				mIsStackValid = false;
+				continue;
+			}
+
+			// every path into a jump target has its values in their own slots
+			if (mIsStackValid && mIsJumpTarget[offset])
+				Flush(offset);
+			if (!mIsStackValid || mIsJumpTarget[offset])
+			{
+				mStack.assign(depth, Operand{});
+				for (size_t i = 0; i < mStack.size(); ++i)
+					mStack[i].index = static_cast<uint16_t>(i);
+				mIsStackValid = true;
+			}
+
+			if (mStack.size() != static_cast<size_t>(depth))
+				return Release();
+
+			// the stack vm has every value in its slot,so it may start here even if the register code still defers some
+			auto pc = static_cast<int32_t>(mCode->instructions.size());
+			mTargetPcs[offset] = pc;
+			mCode->entries[offset] = {pc, static_cast<uint16_t>(depth)};
+
+			auto emittedCount = mCode->instructions.size();
+			if (TranslateOpCode(offset))
+			{
+				mTranslatedCount++;
+				mEmittedCount += mCode->instructions.size() - emittedCount;
+			}
+			else
+				EmitExit(offset);
+		}
+
+		// a jump whose target is not translated leaves to the stack vm there
+		std::vector<int32_t> exitPcs(mChunk.opCodes.size(), -1);
+		for (const auto &[pc, targetOffset] : mJumpPatches)
+		{
+			auto targetPc = mTargetPcs[targetOffset];
+			if (targetPc == -1)
+			{
+				if (exitPcs[targetOffset] == -1)
+				{
+					exitPcs[targetOffset] = static_cast<int32_t>(mCode->instructions.size());
+					RegisterInstruction exit;
+					exit.opCode = ROP_EXIT;
+					exit.a = static_cast<uint16_t>(mDepths[targetOffset]);
+					exit.offset = static_cast<uint32_t>(targetOffset);
+					mCode->instructions.emplace_back(exit);
+				}
+				targetPc = exitPcs[targetOffset];
+			}
+			mCode->instructions[pc].target = static_cast<uint32_t>(targetPc);
+		}
+
+		// an opcode writes at most one slot above the depth it starts at
+		for (const auto &depth : mDepths)
+			mCode->maxDepth = std::max<uint16_t>(mCode->maxDepth, static_cast<uint16_t>(depth + 1));
+
+		// a function that is mostly calls and object access would only bounce between the two vms
+		if (mTranslatedCount == 0 || (!isAlwaysKept && mEmittedCount * 4 > mTranslatedCount * 3))
+			return Release();
+
+		return mCode;
+	}
+
+	RegisterCode *RegisterTranslator::Release()
+	{
+		RegisterCompiler::Release(mCode);
+		mCode = nullptr;
+		return nullptr;
+	}
+
+	bool RegisterTranslator::ComputeDepths()
+	{
+		const auto size = mChunk.opCodes.size();
+		mDepths.assign(size, UNKNOWN_DEPTH);
+		mIsJumpTarget.assign(size, false);
+
+		std::vector<size_t> worklist;
+		auto propagate = [&](size_t offset, int32_t depth)
+		{
+			if (offset >= size || depth < 0 || depth >= REGISTER_CONSTANT_BIT)
+				return false;
+			if (mDepths[offset] == UNKNOWN_DEPTH)
+			{
+				mDepths[offset] = depth;
+				worklist.emplace_back(offset);
+			}
+			// paths that disagree on the depth are beyond what the register code can follow
+			return mDepths[offset] == depth;
+		};
+
+		if (size == 0 || !propagate(0, mFunction->arity + 1))
+			return false;
+
+		while (!worklist.empty())
+		{
+			auto offset = worklist.back();
+			worklist.pop_back();
+
+			auto opCode = mChunk.opCodes[offset];
+			StackEffect effect;
+			if (opCode == OP_RETURN || !Verifier::GetStackEffect(mChunk, offset, effect))
+				continue;
+
+			auto depth = mDepths[offset] - effect.pops + effect.pushes;
+			if (BytecodeOptimizePass::IsJumpOpCode(opCode))
+			{
+				auto target = BytecodeOptimizePass::GetJumpTarget(mChunk, offset);
+				if (!propagate(target, depth))
+					return false;
+				mIsJumpTarget[target] = true;
+			}
+
+			if (opCode != OP_JUMP && opCode != OP_JUMP_LONG && opCode != OP_LOOP && opCode != OP_LOOP_LONG &&
+				!propagate(offset + 1 + BytecodeOptimizePass::GetOperandSize(mChunk, offset), depth))
+				return false;
+		}
+		return true;
+	}
+
+	bool RegisterTranslator::TranslateOpCode(size_t offset)
+	{
+		auto opCode = mChunk.opCodes[offset];
+		auto top = static_cast<uint16_t>(mStack.size());
+
+		auto binaryOpCode = GetRegisterBinaryOpCode(opCode);
+		if (binaryOpCode != UINT8_MAX)
+		{
+			if (mStack.size() < 2)
+				return false;
+			auto right = Pop();
+			auto left = Pop();
+			auto pc = Emit(binaryOpCode, static_cast<uint16_t>(mStack.size()), ToOperand(left), ToOperand(right), offset);
+			PushRegister();
+			if (GetCompareJumpOpCode(binaryOpCode, false) != UINT8_MAX)
+				mLastComparePc = static_cast<int64_t>(pc);
+			return true;
+		}
+
+		switch (opCode)
+		{
+		case OP_CONSTANT:
+		case OP_CONSTANT_LONG:
+			mStack.emplace_back(Operand{Operand::CONSTANT, static_cast<uint16_t>(opCode == OP_CONSTANT ? ReadU8(offset + 1) : ReadU16(offset + 1))});
+			return true;
+		case OP_NULL:
+			Emit(ROP_LOAD_NULL, top, 0, 0, offset);
+			PushRegister();
+			return true;
+		case OP_GET_LOCAL:
+		case OP_GET_LOCAL_LONG:
+		{
+			auto slot = static_cast<uint16_t>(opCode == OP_GET_LOCAL ? ReadU8(offset + 1) : ReadU16(offset + 1));
+			if (slot >= mStack.size())
+				return false;
+			Materialize(slot, offset);
+			mStack.emplace_back(Operand{Operand::LOCAL, slot});
+			return true;
+		}
+		case OP_SET_LOCAL:
+		case OP_SET_LOCAL_LONG:
+		case OP_SET_LOCAL_POP:
+		case OP_SET_LOCAL_LOAD:
+		case OP_INC_LOCAL:
+		{
+			auto slot = static_cast<uint16_t>(opCode == OP_SET_LOCAL_LONG ? ReadU16(offset + 1) : ReadU8(offset + 1));
+			// the assigned value is on top of the slot,INC_LOCAL takes a constant instead
+			auto slotCount = opCode == OP_INC_LOCAL ? mStack.size() : mStack.size() - 1;
+			if (mStack.empty() || slot >= slotCount)
+				return false;
+			// the store checks the slot for a ref,and values deferred to the slot have to be read before it changes
+			Materialize(slot, offset);
+			MaterializeReadersOf(slot, offset);
+			if (opCode == OP_INC_LOCAL)
+			{
+				Emit(ROP_INC_LOCAL, slot, static_cast<uint16_t>(ReadU8(offset + 2) | REGISTER_CONSTANT_BIT), 0, offset);
+				return true;
+			}
+
+			Emit(ROP_STORE_LOCAL, slot, ToOperand(mStack.back()), 0, offset);
+			if (opCode == OP_SET_LOCAL_POP)
+				mStack.pop_back();
+			else if (opCode == OP_SET_LOCAL_LOAD)
+				mStack.back() = Operand{Operand::LOCAL, slot}; // the slot's content,the ref itself if the slot holds one
+			return true;
+		}
+		case OP_GET_GLOBAL:
+		case OP_GET_GLOBAL_LONG:
+			Emit(ROP_GET_GLOBAL, top, opCode == OP_GET_GLOBAL ? ReadU8(offset + 1) : ReadU16(offset + 1), 0, offset);
+			PushRegister();
+			return true;
+		case OP_SET_GLOBAL:
+		case OP_SET_GLOBAL_LONG:
+		case OP_SET_GLOBAL_POP:
+			if (mStack.empty())
+				return false;
+			Emit(ROP_SET_GLOBAL, opCode == OP_SET_GLOBAL_LONG ? ReadU16(offset + 1) : ReadU8(offset + 1), ToOperand(mStack.back()), 0, offset);
+			if (opCode == OP_SET_GLOBAL_POP)
+				mStack.pop_back();
+			return true;
+		case OP_GET_UPVALUE:
+			Emit(ROP_GET_UPVALUE, top, ReadU8(offset + 1), 0, offset);
+			PushRegister();
+			return true;
+		case OP_SET_UPVALUE:
+			if (mStack.empty())
+				return false;
+			Emit(ROP_SET_UPVALUE, ReadU8(offset + 1), ToOperand(mStack.back()), 0, offset);
+			return true;
+		case OP_NOT:
+		case OP_MINUS:
+		{
+			if (mStack.empty())
+				return false;
+			auto value = Pop();
+			Emit(opCode == OP_NOT ? ROP_NOT : ROP_MINUS, static_cast<uint16_t>(mStack.size()), ToOperand(value), 0, offset);
+			PushRegister();
+			return true;
+		}
+		case OP_POP:
+			if (mStack.empty())
+				return false;
+			Pop();
+			return true;
+		case OP_JUMP:
+		case OP_JUMP_LONG:
+		case OP_LOOP:
+		case OP_LOOP_LONG:
+			Flush(offset);
+			EmitJump(ROP_JUMP, 0, 0, offset);
+			mIsStackValid = false;
+			return true;
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_FALSE_LONG:
+			if (mStack.empty())
+				return false;
+			Flush(offset);
+			EmitJump(ROP_JUMP_IF_FALSE, ToOperand(mStack.back()), 0, offset);
+			return true;
+		case OP_JUMP_IF_FALSE_POP:
+		case OP_JUMP_IF_TRUE_POP:
+		{
+			if (mStack.empty())
+				return false;
+			auto isJumpIfTrue = opCode == OP_JUMP_IF_TRUE_POP;
+			auto condition = Pop();
+			auto comparePc = mLastComparePc;
+			Flush(offset);
+
+			// the compare right before produced the condition and nothing else ran since,branch on the compare itself
+			if (comparePc != -1 && !mIsJumpTarget[offset] && comparePc + 1 == static_cast<int64_t>(mCode->instructions.size()) &&
+				condition.kind == Operand::REGISTER && condition.index == mCode->instructions[comparePc].a)
+			{
+				auto &compare = mCode->instructions[comparePc];
+				compare.opCode = GetCompareJumpOpCode(compare.opCode, isJumpIfTrue);
+				mJumpPatches.emplace_back(static_cast<size_t>(comparePc), BytecodeOptimizePass::GetJumpTarget(mChunk, offset));
+				mCode->entries[offset].pc = -1; // the condition is never written to its slot
+				mTargetPcs[offset] = -1;
+				return true;
+			}
+
+			EmitJump(isJumpIfTrue ? ROP_JUMP_IF_TRUE : ROP_JUMP_IF_FALSE, ToOperand(condition), 0, offset);
+			return true;
+		}
+		case OP_LESS_LOCAL_CONST_JUMP:
+		{
+			auto slot = ReadU8(offset + 1);
+			if (slot >= mStack.size())
+				return false;
+			Flush(offset);
+			EmitJump(ROP_JUMP_IF_NOT_LESS, slot, static_cast<uint16_t>(ReadU8(offset + 2) | REGISTER_CONSTANT_BIT), offset);
+			return true;
+		}
+		case OP_FOR_RANGE_INT:
+		{
+			auto slot = ReadU8(offset + 1);
+			if (static_cast<size_t>(slot) + 2 >= mStack.size())
+				return false;
+			Flush(offset);
+			EmitJump(ROP_FOR_RANGE_INT, 0, 0, offset);
+			mCode->instructions.back().a = slot;
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	size_t RegisterTranslator::Emit(uint8_t opCode, uint16_t a, uint16_t b, uint16_t c, size_t offset)
+	{
+		RegisterInstruction instruction;
+		instruction.opCode = opCode;
+		instruction.a = a;
+		instruction.b = b;
+		instruction.c = c;
+		instruction.offset = static_cast<uint32_t>(offset);
+		mCode->instructions.emplace_back(instruction);
+		mLastComparePc = -1;
+		return mCode->instructions.size() - 1;
+	}
+
+	void RegisterTranslator::EmitJump(uint8_t opCode, uint16_t b, uint16_t c, size_t offset)
+	{
+		auto pc = Emit(opCode, 0, b, c, offset);
+		mJumpPatches.emplace_back(pc, BytecodeOptimizePass::GetJumpTarget(mChunk, offset));
+	}
+
+	void RegisterTranslator::EmitExit(size_t offset)
+	{
+		Flush(offset);
+		Emit(ROP_EXIT, static_cast<uint16_t>(mStack.size()), 0, 0, offset);
+		mIsStackValid = false;
+	}
+
+	uint16_t RegisterTranslator::ToOperand(const Operand &operand) const
+	{
+		return operand.kind == Operand::CONSTANT ? static_cast<uint16_t>(operand.index | REGISTER_CONSTANT_BIT) : operand.index;
+	}
+
+	RegisterTranslator::Operand RegisterTranslator::Pop()
+	{
+		auto operand = mStack.back();
+		mStack.pop_back();
+		return operand;
+	}
+
+	void RegisterTranslator::PushRegister()
+	{
+		mStack.emplace_back(Operand{Operand::REGISTER, static_cast<uint16_t>(mStack.size())});
+	}
+
+	void RegisterTranslator::Materialize(size_t idx, size_t offset)
+	{
+		if (mStack[idx].kind == Operand::REGISTER)
+			return;
+		Emit(ROP_MOVE, static_cast<uint16_t>(idx), ToOperand(mStack[idx]), 0, offset);
+		mStack[idx] = Operand{Operand::REGISTER, static_cast<uint16_t>(idx)};
+	}
+
+	void RegisterTranslator::MaterializeReadersOf(uint16_t slot, size_t offset)
+	{
+		for (size_t i = 0; i < mStack.size(); ++i)
+		{
+			if (mStack[i].kind == Operand::LOCAL && mStack[i].index == slot)
+				Materialize(i, offset);
+		}
+	}
+
+	void RegisterTranslator::Flush(size_t offset)
+	{
+		for (size_t i = 0; i < mStack.size(); ++i)
+			Materialize(i, offset);
+	}
+
+	uint8_t RegisterTranslator::ReadU8(size_t offset) const
+	{
+		return mChunk.opCodes[offset];
+	}
+
+	uint16_t RegisterTranslator::ReadU16(size_t offset) const
+	{
+		return static_cast<uint16_t>((mChunk.opCodes[offset] << 8) | mChunk.opCodes[offset + 1]);
+	}
+
+#ifndef NDEBUG
+	STRING RegisterCode::ToString() const
+	{
+		static const CHAR_T *sNames[] = {
+			TEXT("MOVE"),
+			TEXT("LOAD_NULL"),
+			TEXT("STORE_LOCAL"),
+			TEXT("GET_GLOBAL"),
+			TEXT("SET_GLOBAL"),
+			TEXT("GET_UPVALUE"),
+			TEXT("SET_UPVALUE"),
+			TEXT("ADD"),
+			TEXT("SUB"),
+			TEXT("MUL"),
+			TEXT("DIV"),
+			TEXT("MOD"),
+			TEXT("BIT_AND"),
+			TEXT("BIT_OR"),
+			TEXT("BIT_LEFT_SHIFT"),
+			TEXT("BIT_RIGHT_SHIFT"),
+			TEXT("LESS"),
+			TEXT("GREATER"),
+			TEXT("EQUAL"),
+			TEXT("NOT"),
+			TEXT("MINUS"),
+			TEXT("INC_LOCAL"),
+			TEXT("JUMP"),
+			TEXT("JUMP_IF_FALSE"),
+			TEXT("JUMP_IF_TRUE"),
+			TEXT("JUMP_IF_LESS"),
+			TEXT("JUMP_IF_NOT_LESS"),
+			TEXT("JUMP_IF_GREATER"),
+			TEXT("JUMP_IF_NOT_GREATER"),
+			TEXT("JUMP_IF_EQUAL"),
+			TEXT("JUMP_IF_NOT_EQUAL"),
+			TEXT("FOR_RANGE_INT"),
+			TEXT("EXIT"),
+		};
+
+		auto operand = [](uint16_t x)
+		{
+			return (x & REGISTER_CONSTANT_BIT ? TEXT("k") : TEXT("r")) + CYS_TO_STRING(x & ~REGISTER_CONSTANT_BIT);
+		};
+
+		STRING result;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			const auto &instruction = instructions[i];
+			result += CYS_TO_STRING(i) + TEXT("\t") + sNames[instruction.opCode] + TEXT("\tr") + CYS_TO_STRING(instruction.a) + TEXT(" ") +
+					  operand(instruction.b) + TEXT(" ") + operand(instruction.c) + TEXT("\t->") + CYS_TO_STRING(instruction.target) +
+					  TEXT("\t@") + CYS_TO_STRING(instruction.offset) + TEXT("\n");
+		}
+		return result;
+	}
+#endif
+
+	RegisterCode *RegisterCompiler::Compile(FunctionObject *function, bool isAlwaysKept)
+	{
+		RegisterTranslator translator(function);
+		return translator.Translate(isAlwaysKept);
+	}
+
+	void RegisterCompiler::Release(RegisterCode *registerCode)
+	{
+		delete registerCode;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include "Chunk.h"
+#include "Object.h"
+namespace CynicScript
+{
+    // three address opcodes of the register vm,a is the destination register(a frame slot),b and c are operands.
+    // an operand with REGISTER_CONSTANT_BIT set reads the constant table instead of a register
+    enum RegisterOpCode : uint8_t
+    {
+        ROP_MOVE,                // a=b,the raw slot content,refs included
+        ROP_LOAD_NULL,           // a=null
+        ROP_STORE_LOCAL,         // slot a=b,through the ref if slot a holds one
+        ROP_GET_GLOBAL,          // a=globals[b]
+        ROP_SET_GLOBAL,          // globals[a]=b,through the ref if the global holds one
+        ROP_GET_UPVALUE,         // a=upvalue b
+        ROP_SET_UPVALUE,         // upvalue a=b
+        ROP_ADD,                 // a=b+c
+        ROP_SUB,                 // a=b-c
+        ROP_MUL,                 // a=b*c
+        ROP_DIV,                 // a=b/c
+        ROP_MOD,                 // a=b%c
+        ROP_BIT_AND,             // a=b&c
+        ROP_BIT_OR,              // a=b|c
+        ROP_BIT_LEFT_SHIFT,      // a=b<<c
+        ROP_BIT_RIGHT_SHIFT,     // a=b>>c
+        ROP_LESS,                // a=b<c
+        ROP_GREATER,             // a=b>c
+        ROP_EQUAL,               // a=b==c
+        ROP_NOT,                 // a=!b
+        ROP_MINUS,               // a=-b
+        ROP_INC_LOCAL,           // slot a+=b,through the ref if slot a holds one
+        ROP_JUMP,                // goto target
+        ROP_JUMP_IF_FALSE,       // if b is null or false goto target
+        ROP_JUMP_IF_TRUE,        // if b goto target,b has to be a bool
+        ROP_JUMP_IF_LESS,        // if b<c goto target
+        ROP_JUMP_IF_NOT_LESS,
+        ROP_JUMP_IF_GREATER,     // if b>c goto target
+        ROP_JUMP_IF_NOT_GREATER,
+        ROP_JUMP_IF_EQUAL,       // if b==c goto target
+        ROP_JUMP_IF_NOT_EQUAL,
+        ROP_FOR_RANGE_INT,       // slots a..a+2 are counter,end,loop variable,goto target once the counter reaches the end
+        ROP_EXIT,                // leave to the stack vm at offset with a values on the stack
+    };
+
+    constexpr uint16_t REGISTER_CONSTANT_BIT = 0x8000;
+
+    struct RegisterInstruction
+    {
+        uint8_t opCode{ROP_EXIT};
+        uint16_t a{0};
+        uint16_t b{0};
+        uint16_t c{0};
+        uint32_t offset{0};  // the stack opcode this instruction was translated from,for error tokens and exits
+        uint32_t target{0};  // index of the jump target
+    };
+
+    // where the stack vm may hand a frame over to the register code
+    struct RegisterEntry
+    {
+        int32_t pc{-1};    // -1 if the register code cannot start at this opcode
+        uint16_t depth{0}; // the stack depth the register code expects there
+    };
+
+    struct RegisterCode
+    {
+#ifndef NDEBUG
+        STRING ToString() const;
+#endif
+        std::vector<RegisterInstruction> instructions;
+        std::vector<RegisterEntry> entries; // indexed by opcode offset
+        // slots the register code may write,the gc sees all of them while it runs so a deferred or dead slot never holds a freed object
+        uint16_t maxDepth{0};
+    };
+
+    // translates a stack chunk into register code:the operand stack becomes frame slots at the depth the stack vm would
+    // push them,locals and constants are read in place instead of being pushed first,so an expression like a=a+b*2 runs as
+    // two instructions instead of six.opcodes the register vm does not know(calls,returns,objects...) become exits that hand
+    // the frame back to the stack vm,which reenters the register code at loop back edges and after calls just like compiled code
+    class CYS_API RegisterCompiler
+    {
+    public:
+        // returns nullptr if nothing could be translated,or if isAlwaysKept is false and the register code
+        // does not save enough instructions over the stack code to be worth switching for
+        static RegisterCode *Compile(FunctionObject *function, bool isAlwaysKept);
+        static void Release(RegisterCode *registerCode);
+    };
+}
@@ -0,0 +1,89 @@
+#include "SampleProfiler.h"
+#include <algorithm>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/time.h>
+#endif
+#include "Allocator.h"
+#include "Logger.h"
+namespace CynicScript
+{
+	volatile std::sig_atomic_t SampleProfiler::sPendingTicks = 0;
+
+	bool SampleProfiler::Start(uint32_t frequency)
+	{
+#if defined(_WIN32) || defined(_WIN64)
+		return false;
+#else
+		if (frequency == 0)
+			return false;
+
+		struct sigaction action = {};
+		action.sa_handler = OnTick;
+		action.sa_flags = SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		if (sigaction(SIGPROF, &action, nullptr) != 0)
+			return false;
+
+		// the interval is process cpu time,a script blocked on io is not sampled
+		auto interval = std::max<uint32_t>(1000000 / frequency, 1);
+		itimerval timer = {};
+		timer.it_interval.tv_sec = interval / 1000000;
+		timer.it_interval.tv_usec = interval % 1000000;
+		timer.it_value = timer.it_interval;
+		return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+#endif
+	}
+
+	void SampleProfiler::Stop()
+	{
+#if !defined(_WIN32) && !defined(_WIN64)
+		itimerval timer = {};
+		setitimer(ITIMER_PROF, &timer, nullptr);
+		signal(SIGPROF, SIG_DFL);
+#endif
+		sPendingTicks = 0;
+	}
+
+	void SampleProfiler::Sample()
+	{
+		// every tick since the last sample is charged to this stack,the timer keeps running while the vm is between safe points
+		uint64_t ticks = sPendingTicks;
+		sPendingTicks = 0;
+
+		auto allocator = Allocator::GetInstance();
+		auto count = allocator->CallFrameCount();
+
+		STRING stack;
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto frame = allocator->PeekCallFrame(static_cast<int32_t>(count - 1 - i));
+			const auto &chunk = frame->closure->function->chunk;
+			auto token = chunk.GetRelatedToken(static_cast<uint32_t>(frame->ip - 1 - chunk.opCodes.data()));
+
+			if (!stack.empty())
+				stack += TEXT(";");
+			stack += frame->closure->function->name;
+			if (token)
+				stack += TEXT(":") + CYS_TO_STRING(token->sourceLocation.line);
+		}
+
+		mFoldedStacks[stack] += ticks;
+	}
+
+	std::string SampleProfiler::ToFolded() const
+	{
+		STRING result;
+		for (const auto &[stack, ticks] : mFoldedStacks)
+			result += stack + TEXT(" ") + CYS_TO_STRING(ticks) + TEXT("\n");
+#ifdef CYS_UTF8_ENCODE
+		return Utf8::Encode(result);
+#else
+		return result;
+#endif
+	}
+
+	void SampleProfiler::OnTick(int32_t)
+	{
+		sPendingTicks = sPendingTicks + 1;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "Common.h"
+namespace CynicScript
+{
+    // samples the script call stack at a fixed rate and folds the samples into "outer:line;inner:line count" lines for flamegraph tools.
+    // the timer signal(SIGPROF) only counts ticks,the vm takes the sample at its next call,return or loop back edge where the frame
+    // stack is consistent,so a sample never walks a half pushed frame and costs nothing between ticks.
+    // compiled loops(jit or aot) do not reach a back edge,their ticks are taken when the loop leaves the compiled code
+    class CYS_API SampleProfiler : public Singleton<SampleProfiler>
+    {
+    public:
+        // returns false if the timer could not be installed(or the platform has no SIGPROF)
+        bool Start(uint32_t frequency);
+        void Stop();
+
+        static inline bool IsSamplePending() noexcept
+        {
+            return sPendingTicks != 0;
+        }
+
+        // records the call frames of the allocator,the top frame's ip has to be saved before
+        void Sample();
+
+        std::string ToFolded() const;
+
+    private:
+        static void OnTick(int32_t signal);
+
+        static volatile std::sig_atomic_t sPendingTicks;
+
+        std::unordered_map<STRING, uint64_t> mFoldedStacks;
+    };
+}
@@ -0,0 +1,136 @@
+#include "SuperInstructionPass.h"
+namespace CynicScript
+{
+	void SuperInstructionPass::ExecuteInstructions(InstructionList &instructions)
+	{
+		// longest patterns first,otherwise JUMP_IF_FALSE POP would be eaten before the compare-and-jump fusion sees it
+		FuseLessLocalConstJump(instructions);
+		FuseIncLocal(instructions);
+		FuseJumpIfFalsePop(instructions);
+		FuseSetPop(instructions, OP_SET_LOCAL, OP_SET_LOCAL_POP);
+		FuseSetPop(instructions, OP_SET_GLOBAL, OP_SET_GLOBAL_POP);
+	}
+
+	void SuperInstructionPass::FuseLessLocalConstJump(InstructionList &instructions)
+	{
+		auto jumpTargets = StatsJumpTargets(instructions);
+		std::vector<size_t> indices;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			if (!MatchAnyOf(instructions, i, {OP_LESS, OP_LESS_I64, OP_LESS_F64}, [](uint8_t lessOpCode)
+							{ return std::vector<uint8_t>{OP_GET_LOCAL, OP_CONSTANT, lessOpCode, OP_JUMP_IF_FALSE, OP_POP}; }, indices))
+				continue;
+			if (IsTailJumpTarget(jumpTargets, indices))
+				continue;
+
+			Instruction fused = instructions[indices[3]];
+			if (!RetargetPastPop(instructions, jumpTargets, fused))
+				continue;
+
+			fused.opCode = OP_LESS_LOCAL_CONST_JUMP;
+			fused.operands = {instructions[indices[0]].operands[0], instructions[indices[1]].operands[0]};
+			fused.token = instructions[indices[2]].token;
+
+			jumpTargets[instructions[indices[3]].jumpTarget]--;
+			instructions[indices[0]] = fused;
+			for (size_t j = 1; j < indices.size(); ++j)
+				instructions[indices[j]].isRemoved = true;
+		}
+	}
+
+	void SuperInstructionPass::FuseIncLocal(InstructionList &instructions)
+	{
+		auto jumpTargets = StatsJumpTargets(instructions);
+		std::vector<size_t> indices;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			if (!MatchAnyOf(instructions, i, {OP_ADD, OP_ADD_I64, OP_ADD_F64}, [](uint8_t addOpCode)
+							{ return std::vector<uint8_t>{OP_GET_LOCAL, OP_CONSTANT, addOpCode, OP_SET_LOCAL, OP_POP}; }, indices))
+				continue;
+			if (instructions[indices[0]].operands[0] != instructions[indices[3]].operands[0])
+				continue;
+			if (IsTailJumpTarget(jumpTargets, indices))
+				continue;
+
+			auto &head = instructions[indices[0]];
+			head.opCode = OP_INC_LOCAL;
+			head.operands = {head.operands[0], instructions[indices[1]].operands[0]};
+			head.token = instructions[indices[2]].token;
+			for (size_t j = 1; j < indices.size(); ++j)
+				instructions[indices[j]].isRemoved = true;
+		}
+	}
+
+	void SuperInstructionPass::FuseJumpIfFalsePop(InstructionList &instructions)
+	{
+		auto jumpTargets = StatsJumpTargets(instructions);
+		std::vector<size_t> indices;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			if (!MatchSequence(instructions, i, {OP_JUMP_IF_FALSE, OP_POP}, indices))
+				continue;
+			if (IsTailJumpTarget(jumpTargets, indices))
+				continue;
+
+			auto &head = instructions[indices[0]];
+			auto oldTarget = head.jumpTarget;
+			if (!RetargetPastPop(instructions, jumpTargets, head))
+				continue;
+
+			jumpTargets[oldTarget]--;
+			head.opCode = OP_JUMP_IF_FALSE_POP;
+			instructions[indices[1]].isRemoved = true;
+		}
+	}
+
+	void SuperInstructionPass::FuseSetPop(InstructionList &instructions, uint8_t setOpCode, uint8_t fusedOpCode)
+	{
+		auto jumpTargets = StatsJumpTargets(instructions);
+		std::vector<size_t> indices;
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			if (!MatchSequence(instructions, i, {setOpCode, OP_POP}, indices))
+				continue;
+			if (IsTailJumpTarget(jumpTargets, indices))
+				continue;
+
+			instructions[indices[0]].opCode = fusedOpCode;
+			instructions[indices[1]].isRemoved = true;
+		}
+	}
+
+	// the fused opcodes check operand tags themselves,so the generic and the type specialized forms of an opcode fuse the same way
+	bool SuperInstructionPass::MatchAnyOf(const InstructionList &instructions, size_t start, std::initializer_list<uint8_t> variants, const std::function<std::vector<uint8_t>(uint8_t)> &makeSequence, std::vector<size_t> &indices)
+	{
+		for (auto variant : variants)
+		{
+			if (MatchSequence(instructions, start, makeSequence(variant), indices))
+				return true;
+		}
+		return false;
+	}
+
+	// the false branch of JUMP_IF_FALSE lands on a POP that discards the condition,
+	// a fused opcode has already popped it so jump to the instruction right after that POP
+	bool SuperInstructionPass::RetargetPastPop(InstructionList &instructions, std::vector<uint32_t> &jumpTargets, Instruction &jump)
+	{
+		auto target = static_cast<size_t>(jump.jumpTarget);
+		if (target >= instructions.size() || instructions[target].isRemoved || instructions[target].opCode != OP_POP)
+			return false;
+
+		auto newTarget = NextLiveInstruction(instructions, target);
+		jump.jumpTarget = static_cast<int64_t>(newTarget);
+		jumpTargets[newTarget]++;
+		return true;
+	}
+
+	bool SuperInstructionPass::IsTailJumpTarget(const std::vector<uint32_t> &jumpTargets, const std::vector<size_t> &indices)
+	{
+		for (size_t j = 1; j < indices.size(); ++j)
+		{
+			if (jumpTargets[indices[j]] > 0)
+				return true;
+		}
+		return false;
+	}
+}
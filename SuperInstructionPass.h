@@ -0,0 +1,34 @@
+#pragma once
+#include <functional>
+#include <initializer_list>
+#include "BytecodeOptimizePass.h"
+
+namespace CynicScript
+{
+    // fuse the hottest opcode sequences(measured on examples/ and loop heavy scripts) into single opcodes:
+    // GET_LOCAL CONSTANT LESS JUMP_IF_FALSE POP -> LESS_LOCAL_CONST_JUMP
+    // GET_LOCAL CONSTANT ADD SET_LOCAL POP      -> INC_LOCAL
+    // JUMP_IF_FALSE POP                         -> JUMP_IF_FALSE_POP
+    // SET_LOCAL POP                             -> SET_LOCAL_POP
+    // SET_GLOBAL POP                            -> SET_GLOBAL_POP
+    // LESS and ADD also match their _I64/_F64 forms
+    class CYS_API SuperInstructionPass : public BytecodeOptimizePass
+    {
+    public:
+        SuperInstructionPass() noexcept = default;
+        virtual ~SuperInstructionPass() override = default;
+
+    protected:
+        void ExecuteInstructions(InstructionList &instructions) override;
+
+    private:
+        void FuseLessLocalConstJump(InstructionList &instructions);
+        void FuseIncLocal(InstructionList &instructions);
+        void FuseJumpIfFalsePop(InstructionList &instructions);
+        void FuseSetPop(InstructionList &instructions, uint8_t setOpCode, uint8_t fusedOpCode);
+
+        bool MatchAnyOf(const InstructionList &instructions, size_t start, std::initializer_list<uint8_t> variants, const std::function<std::vector<uint8_t>(uint8_t)> &makeSequence, std::vector<size_t> &indices);
+        bool RetargetPastPop(InstructionList &instructions, std::vector<uint32_t> &jumpTargets, Instruction &jump);
+        bool IsTailJumpTarget(const std::vector<uint32_t> &jumpTargets, const std::vector<size_t> &indices);
+    };
+}
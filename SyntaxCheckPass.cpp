@@ -67,6 +67,17 @@ namespace CynicScript
             stmt->increment = (ScopeStmt *)ExecuteScopeStmt(stmt->increment);
         return stmt;
     }
+    Stmt *SyntaxCheckPass::ExecuteForInStmt(ForInStmt *stmt)
+    {
+        if (stmt->iterable)
+            stmt->iterable = ExecuteExpr(stmt->iterable);
+        if (stmt->rangeBegin)
+            stmt->rangeBegin = ExecuteExpr(stmt->rangeBegin);
+        if (stmt->rangeEnd)
+            stmt->rangeEnd = ExecuteExpr(stmt->rangeEnd);
+        stmt->body = (ScopeStmt *)ExecuteScopeStmt(stmt->body);
+        return stmt;
+    }
     Decl *SyntaxCheckPass::ExecuteEnumDecl(EnumDecl *decl)
     {
         decl->name = (IdentifierExpr *)ExecuteIdentifierExpr(decl->name);
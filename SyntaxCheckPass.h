@@ -24,6 +24,7 @@ namespace CynicScript
         virtual Stmt *ExecuteIfStmt(IfStmt *stmt) override;
         virtual Stmt *ExecuteScopeStmt(ScopeStmt *stmt) override;
         virtual Stmt *ExecuteWhileStmt(WhileStmt *stmt) override;
+        virtual Stmt *ExecuteForInStmt(ForInStmt *stmt) override;
         virtual Stmt *ExecuteBreakStmt(BreakStmt *stmt) override;
         virtual Stmt *ExecuteContinueStmt(ContinueStmt *stmt) override;
 
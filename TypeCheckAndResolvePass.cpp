@@ -7,8 +7,9 @@ namespace CynicScript
         TypeInfo() noexcept = default;
         ~TypeInfo() noexcept = default;
 
-        Type type{};
+        Type type{}; // proven numeric type(I64 or F64),UNDEFINED if not proven
         Permission permission{};
+        bool isMember{false}; // class or module member,bare names may not resolve to it at runtime
     };
 
     class TypeInfoTable
@@ -18,6 +19,11 @@ namespace CynicScript
         TypeInfoTable(TypeInfoTable *enclosing) noexcept : mEnclosing(enclosing) {}
         ~TypeInfoTable() noexcept = default;
 
+        TypeInfoTable *GetEnclosing() const
+        {
+            return mEnclosing;
+        }
+
         bool Find(STRING_VIEW name, TypeInfo &result)
         {
             auto iter = mTypeInfos.find(name);
@@ -36,7 +42,7 @@ namespace CynicScript
         }
 
     private:
-        TypeInfoTable *mEnclosing;
+        TypeInfoTable *mEnclosing{nullptr};
         std::unordered_map<STRING_VIEW, TypeInfo> mTypeInfos;
     };
 
@@ -170,13 +176,28 @@ namespace CynicScript
 
     TypeCheckAndResolvePass::~TypeCheckAndResolvePass() noexcept
     {
-        SAFE_DELETE(mTypeInfoTable);
+        while (mTypeInfoTable)
+            ExitScope();
     }
 
     Stmt *TypeCheckAndResolvePass::ExecuteAstStmts(AstStmts *stmt)
     {
-        for (auto &s : stmt->stmts)
-            s = ExecuteStmt(s);
+        // a write may be visited after a read of the same variable(loops,functions declared before the globals they modify),
+        // so rerun the whole traversal until no more variables get demoted
+        mUnstableNames.clear();
+        mIsFirstRound = true;
+        do
+        {
+            mIsChanged = false;
+            while (mTypeInfoTable)
+                ExitScope();
+            mTypeInfoTable = new TypeInfoTable();
+
+            for (auto &s : stmt->stmts)
+                s = ExecuteStmt(s);
+
+            mIsFirstRound = false;
+        } while (mIsChanged);
 
         return stmt;
     }
@@ -184,8 +205,11 @@ namespace CynicScript
     {
         for (auto &[k, v] : decl->variables)
         {
+            v = ExecuteExpr(v);
             if (k->kind == AstKind::ARRAY)
             {
+                for (auto e : ((ArrayExpr *)k)->elements)
+                    DefineVariable(e, Type());
             }
             else if (k->kind == AstKind::VAR_DESC)
             {
@@ -193,21 +217,26 @@ namespace CynicScript
                 Type &rightType = v->type;
 
                 if (leftType.Is(TypeKind::UNDEFINED))
-                {
                     leftType = v->type;
-                    return decl;
-                }
                 else if (leftType.Is(TypeKind::ANY))
                 {
-                    return decl;
+                    DefineVariable(k, Type());
+                    continue;
                 }
-                else if (leftType.IsPrimitiveType() && rightType.IsPrimitiveType())
+                else if (mIsFirstRound && leftType.IsPrimitiveType() && rightType.IsPrimitiveType())
                 {
                     if (auto info = FindPrimitiveTypeMapInfo(leftType.GetKind(), rightType.GetKind()))
                     {
                         Logger::Log(info->logKind, k->tagToken, info->msg);
                     }
                 }
+
+                // the stored value keeps the initializer's kind whatever the annotation says,so both have to agree
+                auto kind = GetNumericKind(rightType);
+                if (kind != TypeKind::UNDEFINED && GetNumericKind(leftType) == kind)
+                    DefineVariable(k, Type(kind, k->tagToken->sourceLocation));
+                else
+                    DefineVariable(k, Type());
             }
         }
 
@@ -220,30 +249,95 @@ namespace CynicScript
     }
     Stmt *TypeCheckAndResolvePass::ExecuteReturnStmt(ReturnStmt *stmt)
     {
+        if (stmt->expr)
+            stmt->expr = ExecuteExpr(stmt->expr);
         return stmt;
     }
     Stmt *TypeCheckAndResolvePass::ExecuteIfStmt(IfStmt *stmt)
     {
+        stmt->condition = ExecuteExpr(stmt->condition);
+        stmt->thenBranch = ExecuteStmt(stmt->thenBranch);
+        if (stmt->elseBranch)
+            stmt->elseBranch = ExecuteStmt(stmt->elseBranch);
         return stmt;
     }
     Stmt *TypeCheckAndResolvePass::ExecuteScopeStmt(ScopeStmt *stmt)
     {
+        EnterScope();
+        for (auto &s : stmt->stmts)
+            s = ExecuteStmt(s);
+        ExitScope();
         return stmt;
     }
     Stmt *TypeCheckAndResolvePass::ExecuteWhileStmt(WhileStmt *stmt)
     {
+        stmt->condition = ExecuteExpr(stmt->condition);
+        stmt->body = (ScopeStmt *)ExecuteScopeStmt(stmt->body);
+        if (stmt->increment)
+            stmt->increment = (ScopeStmt *)ExecuteScopeStmt(stmt->increment);
+        return stmt;
+    }
+    Stmt *TypeCheckAndResolvePass::ExecuteForInStmt(ForInStmt *stmt)
+    {
+        if (stmt->iterable)
+            stmt->iterable = ExecuteExpr(stmt->iterable);
+        if (stmt->rangeBegin)
+            stmt->rangeBegin = ExecuteExpr(stmt->rangeBegin);
+        if (stmt->rangeEnd)
+            stmt->rangeEnd = ExecuteExpr(stmt->rangeEnd);
+
+        EnterScope();
+        // OP_FOR_RANGE_INT only ever stores integers into the loop variable
+        if (stmt->iterable)
+            DefineVariable(stmt->variable, Type());
+        else
+            DefineVariable(stmt->variable, Type(TypeKind::I64, stmt->variable->tagToken->sourceLocation));
+        stmt->body = (ScopeStmt *)ExecuteScopeStmt(stmt->body);
+        ExitScope();
         return stmt;
     }
     Decl *TypeCheckAndResolvePass::ExecuteEnumDecl(EnumDecl *decl)
     {
+        DefineVariable(decl->name, Type());
         return decl;
     }
     Decl *TypeCheckAndResolvePass::ExecuteFunctionDecl(FunctionDecl *decl)
     {
+        DefineVariable(decl->name, Type());
+
+        EnterScope();
+        for (auto param : decl->parameters)
+            DefineVariable(param, Type());
+        decl->body = (ScopeStmt *)ExecuteScopeStmt(decl->body);
+        ExitScope();
+
         return decl;
     }
     Decl *TypeCheckAndResolvePass::ExecuteClassDecl(ClassDecl *decl)
     {
+        mTypeInfoTable->Define(decl->name, TypeInfo());
+
+        EnterScope();
+        for (auto &[privilege, varDecl] : decl->variables)
+        {
+            for (auto &[k, v] : varDecl->variables)
+            {
+                v = ExecuteExpr(v);
+                if (k->kind == AstKind::ARRAY)
+                {
+                    for (auto e : ((ArrayExpr *)k)->elements)
+                        DefineVariable(e, Type(), true);
+                }
+                else
+                    DefineVariable(k, Type(), true);
+            }
+        }
+        for (auto &[privilege, enumDecl] : decl->enumerations)
+            DefineVariable(enumDecl->name, Type(), true);
+        for (auto &[privilege, member] : decl->functions)
+            member.decl = (FunctionDecl *)ExecuteFunctionDecl(member.decl);
+        ExitScope();
+
         return decl;
     }
     Stmt *TypeCheckAndResolvePass::ExecuteBreakStmt(BreakStmt *stmt)
@@ -256,6 +350,33 @@ namespace CynicScript
     }
     Decl *TypeCheckAndResolvePass::ExecuteModuleDecl(ModuleDecl *decl)
     {
+        DefineVariable(decl->name, Type());
+
+        EnterScope();
+        for (auto enumDecl : decl->enumItems)
+            DefineVariable(enumDecl->name, Type(), true);
+        for (auto varDecl : decl->varItems)
+        {
+            for (auto &[k, v] : varDecl->variables)
+            {
+                v = ExecuteExpr(v);
+                if (k->kind == AstKind::ARRAY)
+                {
+                    for (auto e : ((ArrayExpr *)k)->elements)
+                        DefineVariable(e, Type(), true);
+                }
+                else
+                    DefineVariable(k, Type(), true);
+            }
+        }
+        for (auto &classDecl : decl->classItems)
+            classDecl = (ClassDecl *)ExecuteClassDecl(classDecl);
+        for (auto &moduleDecl : decl->moduleItems)
+            moduleDecl = (ModuleDecl *)ExecuteModuleDecl(moduleDecl);
+        for (auto &functionDecl : decl->functionItems)
+            functionDecl = (FunctionDecl *)ExecuteFunctionDecl(functionDecl);
+        ExitScope();
+
         return decl;
     }
     Expr *TypeCheckAndResolvePass::ExecuteLiteralExpr(LiteralExpr *expr)
@@ -264,42 +385,109 @@ namespace CynicScript
     }
     Expr *TypeCheckAndResolvePass::ExecuteInfixExpr(InfixExpr *expr)
     {
+        expr->left = ExecuteExpr(expr->left);
+        expr->right = ExecuteExpr(expr->right);
+
+        auto leftKind = GetNumericKind(expr->left->type);
+        auto rightKind = GetNumericKind(expr->right->type);
+        auto arithmeticKind = GetArithmeticKind(leftKind, rightKind);
+        auto integerKind = (leftKind == TypeKind::I64 && rightKind == TypeKind::I64) ? TypeKind::I64 : TypeKind::UNDEFINED;
+
+        auto &op = expr->op;
+        if (op == TEXT("="))
+        {
+            MarkWritten(expr->left, rightKind);
+            expr->type = Type();
+        }
+        else if (op == TEXT("+") || op == TEXT("-") || op == TEXT("*") || op == TEXT("/"))
+            expr->type = arithmeticKind == TypeKind::UNDEFINED ? Type() : Type(arithmeticKind, expr->tagToken->sourceLocation);
+        else if (op == TEXT("%") || op == TEXT("&") || op == TEXT("|") || op == TEXT("<<") || op == TEXT(">>"))
+            expr->type = integerKind == TypeKind::UNDEFINED ? Type() : Type(integerKind, expr->tagToken->sourceLocation);
+        else if (op == TEXT("<") || op == TEXT(">") || op == TEXT("<=") || op == TEXT(">=") || op == TEXT("==") || op == TEXT("!="))
+            expr->type = Type(TypeKind::BOOL, expr->tagToken->sourceLocation);
+        else if (op == TEXT("+=") || op == TEXT("-=") || op == TEXT("*=") || op == TEXT("/="))
+        {
+            MarkWritten(expr->left, arithmeticKind);
+            expr->type = Type();
+        }
+        else if (op == TEXT("%=") || op == TEXT("&=") || op == TEXT("|=") || op == TEXT("<<=") || op == TEXT(">>="))
+        {
+            MarkWritten(expr->left, integerKind);
+            expr->type = Type();
+        }
+        else
+            expr->type = Type();
+
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecutePrefixExpr(PrefixExpr *expr)
     {
+        expr->right = ExecuteExpr(expr->right);
+
+        auto kind = GetNumericKind(expr->right->type);
+        if (expr->op == TEXT("-"))
+            expr->type = kind == TypeKind::UNDEFINED ? Type() : Type(kind, expr->tagToken->sourceLocation);
+        else if (expr->op == TEXT("!"))
+            expr->type = Type(TypeKind::BOOL, expr->tagToken->sourceLocation);
+        else
+        {
+            if (expr->op == TEXT("++") || expr->op == TEXT("--"))
+                MarkWritten(expr->right, GetArithmeticKind(kind, TypeKind::I64));
+            expr->type = Type();
+        }
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecutePostfixExpr(PostfixExpr *expr)
     {
+        expr->left = ExecuteExpr(expr->left);
+        if (expr->op == TEXT("++") || expr->op == TEXT("--"))
+            MarkWritten(expr->left, GetArithmeticKind(GetNumericKind(expr->left->type), TypeKind::I64));
+        expr->type = Type();
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteConditionExpr(ConditionExpr *expr)
     {
+        expr->condition = ExecuteExpr(expr->condition);
+        expr->trueBranch = ExecuteExpr(expr->trueBranch);
+        expr->falseBranch = ExecuteExpr(expr->falseBranch);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteGroupExpr(GroupExpr *expr)
     {
+        expr->expr = ExecuteExpr(expr->expr);
+        expr->type = expr->expr->type;
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteArrayExpr(ArrayExpr *expr)
     {
+        for (auto &e : expr->elements)
+            e = ExecuteExpr(e);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteAppregateExpr(AppregateExpr *expr)
     {
+        for (auto &e : expr->exprs)
+            e = ExecuteExpr(e);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteDictExpr(DictExpr *expr)
     {
+        for (auto &[k, v] : expr->elements)
+        {
+            k = ExecuteExpr(k);
+            v = ExecuteExpr(v);
+        }
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteIndexExpr(IndexExpr *expr)
     {
+        expr->ds = ExecuteExpr(expr->ds);
+        expr->index = ExecuteExpr(expr->index);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteNewExpr(NewExpr *expr)
     {
+        expr->callee = ExecuteExpr(expr->callee);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteThisExpr(ThisExpr *expr)
@@ -312,30 +500,55 @@ namespace CynicScript
     }
     Expr *TypeCheckAndResolvePass::ExecuteIdentifierExpr(IdentifierExpr *expr)
     {
+        TypeInfo info;
+        if (!mUnstableNames.contains(expr->literal) && mTypeInfoTable->Find(expr->literal, info))
+            expr->type = info.type;
+        else
+            expr->type = Type();
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteLambdaExpr(LambdaExpr *expr)
     {
+        EnterScope();
+        for (auto param : expr->parameters)
+            DefineVariable(param, Type());
+        expr->body = (ScopeStmt *)ExecuteScopeStmt(expr->body);
+        ExitScope();
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteCompoundExpr(CompoundExpr *expr)
     {
+        EnterScope();
+        for (auto &s : expr->stmts)
+            s = ExecuteStmt(s);
+        if (expr->endExpr)
+            expr->endExpr = ExecuteExpr(expr->endExpr);
+        ExitScope();
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteCallExpr(CallExpr *expr)
     {
+        expr->callee = ExecuteExpr(expr->callee);
+        for (auto &arg : expr->arguments)
+            arg = ExecuteExpr(arg);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteDotExpr(DotExpr *expr)
     {
+        expr->callee = ExecuteExpr(expr->callee);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteRefExpr(RefExpr *expr)
     {
+        expr->refExpr = ExecuteExpr(expr->refExpr);
+        // anything may be stored through the reference later
+        MarkWritten(expr->refExpr, TypeKind::UNDEFINED);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteStructExpr(StructExpr *expr)
     {
+        for (auto &[k, v] : expr->elements)
+            v = ExecuteExpr(v);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteVarArgExpr(VarArgExpr *expr)
@@ -344,10 +557,114 @@ namespace CynicScript
     }
     Expr *TypeCheckAndResolvePass::ExecuteFactorialExpr(FactorialExpr *expr)
     {
+        expr->expr = ExecuteExpr(expr->expr);
         return expr;
     }
     Expr *TypeCheckAndResolvePass::ExecuteVarDescExpr(VarDescExpr *expr)
     {
         return expr;
     }
+
+    void TypeCheckAndResolvePass::EnterScope()
+    {
+        mTypeInfoTable = new TypeInfoTable(mTypeInfoTable);
+    }
+
+    void TypeCheckAndResolvePass::ExitScope()
+    {
+        auto enclosing = mTypeInfoTable->GetEnclosing();
+        SAFE_DELETE(mTypeInfoTable);
+        mTypeInfoTable = enclosing;
+    }
+
+    void TypeCheckAndResolvePass::DefineVariable(Expr *varDesc, const Type &provenType, bool isMember)
+    {
+        Expr *nameExpr = varDesc;
+        if (nameExpr->kind == AstKind::VAR_DESC)
+            nameExpr = ((VarDescExpr *)nameExpr)->name;
+
+        STRING_VIEW name;
+        if (nameExpr->kind == AstKind::IDENTIFIER)
+            name = ((IdentifierExpr *)nameExpr)->literal;
+        else if (nameExpr->kind == AstKind::VAR_ARG && ((VarArgExpr *)nameExpr)->argName)
+            name = ((VarArgExpr *)nameExpr)->argName->literal;
+        else
+            return;
+
+        TypeInfo info;
+        info.isMember = isMember;
+        if (!mUnstableNames.contains(STRING(name)))
+            info.type = provenType;
+        mTypeInfoTable->Define(name, info);
+    }
+
+    void TypeCheckAndResolvePass::MarkWritten(Expr *target, TypeKind valueKind)
+    {
+        switch (target->kind)
+        {
+        case AstKind::IDENTIFIER:
+        {
+            auto name = ((IdentifierExpr *)target)->literal;
+            TypeInfo info;
+            if (!mTypeInfoTable->Find(name, info) || info.isMember)
+                MarkUnstable(name); // the runtime may resolve it to any variable with this name
+            else if (info.type.GetKind() != TypeKind::UNDEFINED && info.type.GetKind() != valueKind)
+                MarkUnstable(name);
+            break;
+        }
+        case AstKind::VAR_DESC:
+            MarkWritten(((VarDescExpr *)target)->name, TypeKind::UNDEFINED);
+            break;
+        case AstKind::VAR_ARG:
+            if (((VarArgExpr *)target)->argName)
+                MarkWritten(((VarArgExpr *)target)->argName, TypeKind::UNDEFINED);
+            break;
+        case AstKind::GROUP:
+            MarkWritten(((GroupExpr *)target)->expr, valueKind);
+            break;
+        case AstKind::ARRAY:
+            for (auto e : ((ArrayExpr *)target)->elements)
+                MarkWritten(e, TypeKind::UNDEFINED);
+            break;
+        default: // index and member writes never touch a variable slot
+            break;
+        }
+    }
+
+    void TypeCheckAndResolvePass::MarkUnstable(STRING_VIEW name)
+    {
+        if (mUnstableNames.emplace(name).second)
+            mIsChanged = true;
+    }
+
+    TypeKind TypeCheckAndResolvePass::GetNumericKind(const Type &type)
+    {
+        // every integer literal becomes an int value and every floating one a real value at runtime
+        switch (type.GetKind())
+        {
+        case TypeKind::I8:
+        case TypeKind::U8:
+        case TypeKind::I16:
+        case TypeKind::U16:
+        case TypeKind::I32:
+        case TypeKind::U32:
+        case TypeKind::I64:
+        case TypeKind::U64:
+            return TypeKind::I64;
+        case TypeKind::F32:
+        case TypeKind::F64:
+            return TypeKind::F64;
+        default:
+            return TypeKind::UNDEFINED;
+        }
+    }
+
+    TypeKind TypeCheckAndResolvePass::GetArithmeticKind(TypeKind left, TypeKind right)
+    {
+        if (left == TypeKind::UNDEFINED || right == TypeKind::UNDEFINED)
+            return TypeKind::UNDEFINED;
+        if (left == TypeKind::I64 && right == TypeKind::I64)
+            return TypeKind::I64;
+        return TypeKind::F64;
+    }
 }
\ No newline at end of file
@@ -1,8 +1,15 @@
 #pragma once
+#include <unordered_set>
 #include "AstOptimizePass.h"
 namespace CynicScript
 {
     class TypeInfoTable;
+
+    // besides the annotation checks,this pass proves which variables always hold an int(I64) or a real(F64) value
+    // and types the arithmetic built on them so the compiler can emit tag-check-free opcodes(OP_ADD_I64 etc.).
+    // a variable is proven only if its initializer is numeric,its annotation(if any) agrees with it,
+    // no reference is ever taken to it and every write stores the same numeric kind.
+    // parameters and destructured variables are never proven.
     class CYS_API TypeCheckAndResolvePass : public AstOptimizePass
     {
     public:
@@ -23,6 +30,7 @@ namespace CynicScript
         virtual Stmt *ExecuteIfStmt(IfStmt *stmt) override;
         virtual Stmt *ExecuteScopeStmt(ScopeStmt *stmt) override;
         virtual Stmt *ExecuteWhileStmt(WhileStmt *stmt) override;
+        virtual Stmt *ExecuteForInStmt(ForInStmt *stmt) override;
         virtual Stmt *ExecuteBreakStmt(BreakStmt *stmt) override;
         virtual Stmt *ExecuteContinueStmt(ContinueStmt *stmt) override;
 
@@ -51,6 +59,21 @@ namespace CynicScript
         virtual Expr *ExecuteVarDescExpr(VarDescExpr *expr) override;
 
     private:
-        TypeInfoTable* mTypeInfoTable{nullptr};
+        void EnterScope();
+        void ExitScope();
+
+        void DefineVariable(Expr *varDesc, const Type &provenType, bool isMember = false);
+        void MarkWritten(Expr *target, TypeKind valueKind);
+        void MarkUnstable(STRING_VIEW name);
+
+        static TypeKind GetNumericKind(const Type &type);
+        static TypeKind GetArithmeticKind(TypeKind left, TypeKind right);
+
+        TypeInfoTable *mTypeInfoTable{nullptr};
+
+        // names written with another kind,through a reference or before they can be resolved,never proven
+        std::unordered_set<STRING> mUnstableNames;
+        bool mIsChanged{false};
+        bool mIsFirstRound{true};
     };
 }
\ No newline at end of file
@@ -1,15 +1,43 @@
 #include "VM.h"
 #include <iostream>
+#include <algorithm>
 #include "Allocator.h"
 #include "Common.h"
 #include "Object.h"
 #include "Token.h"
 #include "Logger.h"
+#include "Jit.h"
+#include "RegisterCompiler.h"
+#include "BytecodeOptimizePass.h"
+#include "Verifier.h"
+#include "SampleProfiler.h"
 
 namespace CynicScript
 {
+#ifdef CYS_OPCODE_PROFILE
+	VM::~VM() noexcept
+	{
+		if (!Config::GetInstance()->IsProfileOpCodes() || mOpCodeProfiler.IsEmpty())
+			return;
+
+		if (Config::GetInstance()->GetProfileOpCodesFilePath().empty())
+			Logger::Println(TEXT("{}"), mOpCodeProfiler.ToTable());
+		else
+		{
+			auto json = mOpCodeProfiler.ToJson();
+			WriteBinaryFile(Config::GetInstance()->GetProfileOpCodesFilePath(), std::vector<uint8_t>(json.begin(), json.end()));
+		}
+	}
+#endif
+
 	std::vector<Value> VM::Run(FunctionObject *mainFunc) noexcept
 	{
+		if (mStatus == Status::SUSPENDED)
+			CYS_LOG_ERROR(TEXT("Run a script while the script of this vm is suspended,Resume() it to the end first."));
+
+		Verifier::Verify(mainFunc);
+		Predecode(mainFunc);
+
 		Allocator::GetInstance()->StopGC();
 		auto closure = Allocator::GetInstance()->CreateObject<ClosureObject>(mainFunc);
 		Allocator::GetInstance()->RecoverGC();
@@ -17,6 +45,8 @@ namespace CynicScript
 		Allocator::GetInstance()->ResetStackPointer();
 		Allocator::GetInstance()->ResetCallFramePointer();
 
+		SET_STACK_TOP(Allocator::GetInstance()->GrowStack(STACK_TOP(), mainFunc->maxStackDepth));
+
 		PUSH_STACK(closure);
 
 		CallFrame mainCallFrame;
@@ -26,7 +56,50 @@ namespace CynicScript
 
 		PUSH_CALL_FRAME(mainCallFrame);
 
+		mFuel = mFuelBudget;
+		mStatus = Status::FINISHED;
 		Execute();
+		if (mStatus == Status::SUSPENDED)
+			Allocator::GetInstance()->ParkExecutionContext(&mContext);
+
+		return PopReturnValues();
+	}
+
+	std::vector<Value> VM::Resume() noexcept
+	{
+		if (mStatus != Status::SUSPENDED)
+			return {};
+
+		Allocator::GetInstance()->RestoreExecutionContext(&mContext);
+
+		mFuel = mFuelBudget;
+		mStatus = Status::FINISHED;
+		Execute();
+		if (mStatus == Status::SUSPENDED)
+			Allocator::GetInstance()->ParkExecutionContext(&mContext);
+
+		return PopReturnValues();
+	}
+
+	VM::Status VM::GetStatus() const noexcept
+	{
+		return mStatus;
+	}
+
+	void VM::SetFuelBudget(uint64_t fuel) noexcept
+	{
+		mFuelBudget = fuel;
+	}
+
+	uint64_t VM::GetFuelBudget() const noexcept
+	{
+		return mFuelBudget;
+	}
+
+	std::vector<Value> VM::PopReturnValues() noexcept
+	{
+		if (mStatus == Status::SUSPENDED)
+			return {};
 
 		std::vector<Value> returnValues;
 #ifndef NDEBUG
@@ -45,112 +118,616 @@ namespace CynicScript
 	void VM::Execute()
 	{
 		//  - * /
-#define COMMON_BINARY(op)                                                                                                                                                                                                     \
-	do                                                                                                                                                                                                                        \
-	{                                                                                                                                                                                                                         \
-		Value right = POP_STACK();                                                                                                                                                                                            \
-		Value left = POP_STACK();                                                                                                                                                                                             \
-		if (CYS_IS_REF_VALUE(left))                                                                                                                                                                                           \
-			left = *CYS_TO_REF_VALUE(left)->pointer;                                                                                                                                                                          \
-		if (CYS_IS_REF_VALUE(right))                                                                                                                                                                                          \
-			right = *CYS_TO_REF_VALUE(right)->pointer;                                                                                                                                                                        \
-		if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                                                                                \
-			PUSH_STACK(CYS_TO_INT_VALUE(left) op CYS_TO_INT_VALUE(right));                                                                                                                                                    \
-		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_REAL_VALUE(right))                                                                                                                                                         \
-			PUSH_STACK(CYS_TO_REAL_VALUE(left) op CYS_TO_REAL_VALUE(right));                                                                                                                                                  \
-		else if (CYS_IS_INT_VALUE(left) && CYS_IS_REAL_VALUE(right))                                                                                                                                                          \
-			PUSH_STACK(CYS_TO_INT_VALUE(left) op CYS_TO_REAL_VALUE(right));                                                                                                                                                   \
-		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                                                                          \
-			PUSH_STACK(CYS_TO_REAL_VALUE(left) op CYS_TO_INT_VALUE(right));                                                                                                                                                   \
-		else                                                                                                                                                                                                                  \
-			CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid binary op:{}{}{},only (&)int-(&)int,(&)real-(&)real,(&)int-(&)real or (&)real-(&)int type pair is available."), left.ToString(), TEXT(#op), right.ToString()); \
+#define COMMON_VALUE(left, op, right, result)                                                                                                                                                                                    \
+	do                                                                                                                                                                                                                           \
+	{                                                                                                                                                                                                                            \
+		if (CYS_IS_REF_VALUE(left))                                                                                                                                                                                              \
+			left = *CYS_TO_REF_VALUE(left)->pointer;                                                                                                                                                                             \
+		if (CYS_IS_REF_VALUE(right))                                                                                                                                                                                             \
+			right = *CYS_TO_REF_VALUE(right)->pointer;                                                                                                                                                                           \
+		if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                                                                                   \
+			result = CYS_TO_INT_VALUE(left) op CYS_TO_INT_VALUE(right);                                                                                                                                                          \
+		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_REAL_VALUE(right))                                                                                                                                                            \
+			result = CYS_TO_REAL_VALUE(left) op CYS_TO_REAL_VALUE(right);                                                                                                                                                        \
+		else if (CYS_IS_INT_VALUE(left) && CYS_IS_REAL_VALUE(right))                                                                                                                                                             \
+			result = CYS_TO_INT_VALUE(left) op CYS_TO_REAL_VALUE(right);                                                                                                                                                         \
+		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                                                                             \
+			result = CYS_TO_REAL_VALUE(left) op CYS_TO_INT_VALUE(right);                                                                                                                                                         \
+		else                                                                                                                                                                                                                     \
+			CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid binary op:{}{}{},only (&)int-(&)int,(&)real-(&)real,(&)int-(&)real or (&)real-(&)int type pair is available."), left.ToString(), TEXT(#op), right.ToString()); \
+	} while (0);
+
+#define COMMON_BINARY(op)                      \
+	do                                         \
+	{                                          \
+		Value right = POP();                   \
+		Value left = POP();                    \
+		Value result;                          \
+		COMMON_VALUE(left, op, right, result); \
+		PUSH(result);                          \
+	} while (0);
+
+// +,also used by the fused OP_INC_LOCAL
+#define ADD_VALUE(left, right, result)                                                                                                                                                                               \
+	do                                                                                                                                                                                                               \
+	{                                                                                                                                                                                                                \
+		if (CYS_IS_REF_VALUE(left))                                                                                                                                                                                  \
+			left = *CYS_TO_REF_VALUE(left)->pointer;                                                                                                                                                                 \
+		if (CYS_IS_REF_VALUE(right))                                                                                                                                                                                 \
+			right = *CYS_TO_REF_VALUE(right)->pointer;                                                                                                                                                               \
+		if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                                                                       \
+			result = CYS_TO_INT_VALUE(left) + CYS_TO_INT_VALUE(right);                                                                                                                                               \
+		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_REAL_VALUE(right))                                                                                                                                                \
+			result = CYS_TO_REAL_VALUE(left) + CYS_TO_REAL_VALUE(right);                                                                                                                                             \
+		else if (CYS_IS_INT_VALUE(left) && CYS_IS_REAL_VALUE(right))                                                                                                                                                 \
+			result = CYS_TO_INT_VALUE(left) + CYS_TO_REAL_VALUE(right);                                                                                                                                              \
+		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                                                                 \
+			result = CYS_TO_REAL_VALUE(left) + CYS_TO_INT_VALUE(right);                                                                                                                                              \
+		else if (CYS_IS_STR_VALUE(left) && CYS_IS_STR_VALUE(right))                                                                                                                                                  \
+			result = CREATE_OBJECT(StrObject, CYS_TO_STR_VALUE(left)->value + CYS_TO_STR_VALUE(right)->value);                                                                                                       \
+		else                                                                                                                                                                                                         \
+			CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid binary op:{}+{},only (&)int-(&)int,(&)real-(&)real,(&)int-(&)real or (&)real-(&)int type pair is available."), left.ToString(), right.ToString()); \
 	} while (0);
 
 // & | << >>
-#define INTEGER_BINARY(op)                                                                                                                                                   \
-	do                                                                                                                                                                       \
-	{                                                                                                                                                                        \
-		Value right = POP_STACK();                                                                                                                                           \
-		Value left = POP_STACK();                                                                                                                                            \
-		if (CYS_IS_REF_VALUE(left))                                                                                                                                          \
-			left = *CYS_TO_REF_VALUE(left)->pointer;                                                                                                                         \
-		if (CYS_IS_REF_VALUE(right))                                                                                                                                         \
-			right = *CYS_TO_REF_VALUE(right)->pointer;                                                                                                                       \
-		if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                               \
-			PUSH_STACK(CYS_TO_INT_VALUE(left) op CYS_TO_INT_VALUE(right));                                                                                                   \
-		else                                                                                                                                                                 \
-			CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid binary op:{}{}{},only (&)int-(&)int type pair is available."), left.ToString(), TEXT(#op), right.ToString()); \
+#define INTEGER_VALUE(left, op, right, result)                                                                                                                                  \
+	do                                                                                                                                                                          \
+	{                                                                                                                                                                           \
+		if (CYS_IS_REF_VALUE(left))                                                                                                                                             \
+			left = *CYS_TO_REF_VALUE(left)->pointer;                                                                                                                            \
+		if (CYS_IS_REF_VALUE(right))                                                                                                                                            \
+			right = *CYS_TO_REF_VALUE(right)->pointer;                                                                                                                          \
+		if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))                                                                                                                  \
+			result = CYS_TO_INT_VALUE(left) op CYS_TO_INT_VALUE(right);                                                                                                         \
+		else                                                                                                                                                                    \
+			CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid binary op:{}{}{},only (&)int-(&)int type pair is available."), left.ToString(), TEXT(#op), right.ToString()); \
+	} while (0);
+
+#define INTEGER_BINARY(op)                      \
+	do                                          \
+	{                                           \
+		Value right = POP();                    \
+		Value left = POP();                     \
+		Value result;                           \
+		INTEGER_VALUE(left, op, right, result); \
+		PUSH(result);                           \
 	} while (0);
 
 // > <
-#define COMPARE_BINARY(op)                                                                  \
-	do                                                                                      \
-	{                                                                                       \
-		Value right = POP_STACK();                                                          \
-		Value left = POP_STACK();                                                           \
-		if (CYS_IS_REF_VALUE(left))                                                         \
-			left = *CYS_TO_REF_VALUE(left)->pointer;                                        \
-		if (CYS_IS_REF_VALUE(right))                                                        \
-			right = *CYS_TO_REF_VALUE(right)->pointer;                                      \
-		if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))                              \
-			PUSH_STACK(CYS_TO_INT_VALUE(left) op CYS_TO_INT_VALUE(right) ? true : false);   \
-		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_REAL_VALUE(right))                       \
-			PUSH_STACK(CYS_TO_REAL_VALUE(left) op CYS_TO_REAL_VALUE(right) ? true : false); \
-		else if (CYS_IS_INT_VALUE(left) && CYS_IS_REAL_VALUE(right))                        \
-			PUSH_STACK(CYS_TO_INT_VALUE(left) op CYS_TO_REAL_VALUE(right) ? true : false);  \
-		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_INT_VALUE(right))                        \
-			PUSH_STACK(CYS_TO_REAL_VALUE(left) op CYS_TO_INT_VALUE(right) ? true : false);  \
-		else                                                                                \
-			PUSH_STACK(false);                                                              \
+#define COMPARE_VALUE(left, op, right, result)                            \
+	do                                                                    \
+	{                                                                     \
+		if (CYS_IS_REF_VALUE(left))                                       \
+			left = *CYS_TO_REF_VALUE(left)->pointer;                      \
+		if (CYS_IS_REF_VALUE(right))                                      \
+			right = *CYS_TO_REF_VALUE(right)->pointer;                    \
+		if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))            \
+			result = CYS_TO_INT_VALUE(left) op CYS_TO_INT_VALUE(right);   \
+		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_REAL_VALUE(right))     \
+			result = CYS_TO_REAL_VALUE(left) op CYS_TO_REAL_VALUE(right); \
+		else if (CYS_IS_INT_VALUE(left) && CYS_IS_REAL_VALUE(right))      \
+			result = CYS_TO_INT_VALUE(left) op CYS_TO_REAL_VALUE(right);  \
+		else if (CYS_IS_REAL_VALUE(left) && CYS_IS_INT_VALUE(right))      \
+			result = CYS_TO_REAL_VALUE(left) op CYS_TO_INT_VALUE(right);  \
+		else                                                              \
+			result = false;                                               \
+	} while (0);
+
+#define COMPARE_BINARY(op)                      \
+	do                                          \
+	{                                           \
+		Value right = POP();                    \
+		Value left = POP();                     \
+		bool result;                            \
+		COMPARE_VALUE(left, op, right, result); \
+		PUSH(result);                           \
 	} while (0);
 
 // && ||
-#define LOGIC_BINARY(op)                                                                                                                                                       \
-	do                                                                                                                                                                         \
-	{                                                                                                                                                                          \
-		Value right = POP_STACK();                                                                                                                                             \
-		Value left = POP_STACK();                                                                                                                                              \
-		if (CYS_IS_REF_VALUE(left))                                                                                                                                            \
-			left = *CYS_TO_REF_VALUE(left)->pointer;                                                                                                                           \
-		if (CYS_IS_REF_VALUE(right))                                                                                                                                           \
-			right = *CYS_TO_REF_VALUE(right)->pointer;                                                                                                                         \
-		if (CYS_IS_BOOL_VALUE(left) && CYS_IS_BOOL_VALUE(right))                                                                                                               \
-			PUSH_STACK(CYS_TO_BOOL_VALUE(left) op CYS_TO_BOOL_VALUE(right) ? Value(true) : Value(false));                                                                      \
-		else                                                                                                                                                                   \
-			CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid binary op:{}{}{},only (&)bool-(&)bool type pair is available."), left.ToString(), TEXT(#op), right.ToString()); \
+#define LOGIC_BINARY(op)                                                                                                                                                          \
+	do                                                                                                                                                                            \
+	{                                                                                                                                                                             \
+		Value right = POP();                                                                                                                                                      \
+		Value left = POP();                                                                                                                                                       \
+		if (CYS_IS_REF_VALUE(left))                                                                                                                                               \
+			left = *CYS_TO_REF_VALUE(left)->pointer;                                                                                                                              \
+		if (CYS_IS_REF_VALUE(right))                                                                                                                                              \
+			right = *CYS_TO_REF_VALUE(right)->pointer;                                                                                                                            \
+		if (CYS_IS_BOOL_VALUE(left) && CYS_IS_BOOL_VALUE(right))                                                                                                                  \
+			PUSH(CYS_TO_BOOL_VALUE(left) op CYS_TO_BOOL_VALUE(right) ? Value(true) : Value(false));                                                                               \
+		else                                                                                                                                                                      \
+			CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid binary op:{}{}{},only (&)bool-(&)bool type pair is available."), left.ToString(), TEXT(#op), right.ToString()); \
+	} while (0);
+
+// type specialized - * / + < >,TypeCheckAndResolvePass has proven both operand kinds so release builds skip every tag check
+#ifndef NDEBUG
+#define TYPED_BINARY(isKind, toKind, op)                                                                                                                          \
+	do                                                                                                                                                            \
+	{                                                                                                                                                             \
+		Value right = POP();                                                                                                                                      \
+		Value &left = PEEK(0);                                                                                                                                    \
+		if (!isKind(left) || !isKind(right))                                                                                                                      \
+			CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid typed binary op:{}{}{},operand kind mismatch."), left.ToString(), TEXT(#op), right.ToString()); \
+		left = toKind(left) op toKind(right);                                                                                                                     \
+	} while (0);
+#else
+#define TYPED_BINARY(isKind, toKind, op)      \
+	do                                        \
+	{                                         \
+		Value right = POP();                  \
+		Value &left = PEEK(0);                \
+		left = toKind(left) op toKind(right); \
+	} while (0);
+#endif
+
+// the binary ops of VM::Execute,the result takes the place of the second operand and stays cached as the top
+#define TOS_BINARY(valueMacro, resultType, op)  \
+	do                                          \
+	{                                           \
+		Value right = TOS;                      \
+		Value left = PEEK(1);                   \
+		resultType result;                      \
+		valueMacro(left, op, right, result);    \
+		--stackTop;                             \
+		TOS = result;                           \
 	} while (0);
 
-#define READ_INS() (*frame->ip++)
+#ifndef NDEBUG
+#define TOS_TYPED_BINARY(isKind, toKind, op)                                                                                                                      \
+	do                                                                                                                                                            \
+	{                                                                                                                                                             \
+		Value right = TOS;                                                                                                                                        \
+		Value left = PEEK(1);                                                                                                                                     \
+		if (!isKind(left) || !isKind(right))                                                                                                                      \
+			CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid typed binary op:{}{}{},operand kind mismatch."), left.ToString(), TEXT(#op), right.ToString()); \
+		--stackTop;                                                                                                                                               \
+		TOS = toKind(left) op toKind(right);                                                                                                                      \
+	} while (0);
+#else
+#define TOS_TYPED_BINARY(isKind, toKind, op) \
+	do                                       \
+	{                                        \
+		Value right = TOS;                   \
+		Value left = PEEK(1);                \
+		--stackTop;                          \
+		TOS = toKind(left) op toKind(right); \
+	} while (0);
+#endif
+
+// generic + - * < > == feed the quickening counters while both operands are plain ints or plain reals
+#define QUICKEN_BINARY(intOpCode, realOpCode)                              \
+	do                                                                     \
+	{                                                                      \
+		if (CYS_IS_INT_VALUE(TOS) && CYS_IS_INT_VALUE(PEEK(1)))            \
+			Quicken(frame->closure->function, ins, intOpCode);             \
+		else if (CYS_IS_REAL_VALUE(TOS) && CYS_IS_REAL_VALUE(PEEK(1)))     \
+			Quicken(frame->closure->function, ins, realOpCode);            \
+	} while (false)
+
+// the quick form guards on the tags it was specialized for,a failed guard rewrites the opcode back and reruns it generically
+#define QUICK_BINARY(isKind, toKind, op, genericOpCode)          \
+	if (!isKind(TOS) || !isKind(PEEK(1)))                        \
+	{                                                            \
+		Dequicken(frame->closure->function, ins, genericOpCode); \
+		pc = ins;                                                \
+		DISPATCH_TOS();                                          \
+	}                                                            \
+	else                                                         \
+	{                                                            \
+		Value right = TOS;                                       \
+		Value left = PEEK(1);                                    \
+		--stackTop;                                              \
+		TOS = toKind(left) op toKind(right);                     \
+	}
+
+// pc,stack top and current frame live in local variables,they are only written back to the allocator
+// at calls,returns and gc safepoints(any object allocation).ins is the decoded instruction that runs
+#define NEXT_INS() ((ins = pc++)->opCode)
+
+#ifdef CYS_OPCODE_PROFILE
+#define PROFILE_OPCODE() \
+	if (profiler)        \
+		profiler->Record(instruction, isProfileCycles)
+#else
+#define PROFILE_OPCODE()
+#endif
+
+// the native stubs read their operands from the bytes
+#define READ_INS() (*ip++)
+#define READ_U16() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_U32() (ip += 4, (uint32_t)((ip[-4] << 24) | (ip[-3] << 16) | (ip[-2] << 8) | ip[-1]))
+
+#ifndef NDEBUG
+#define PUSH(v)                                     \
+	do                                              \
+	{                                               \
+		if (stackTop >= STACK_END())                \
+			CYS_LOG_ERROR(TEXT("Stack overflow.")); \
+		*(stackTop++) = (v);                        \
+	} while (false)
+#else
+#define PUSH(v) (*(stackTop++) = (v))
+#endif
+#define POP() (*(--stackTop))
+#define DROP() (--stackTop)
+#define PEEK(dist) (*(stackTop - (dist) - 1))
+
+// top of stack caching(CYS_TOS_CACHE):the handlers on the hot paths(loads,arithmetic,compares,jumps,local stores) keep
+// the top value in the local tos,so a chain like a<b jump only touches memory for the values below the top.
+// while such a handler runs,the memory slot of the top(stackTop[-1]) may be stale,every slot below it is always current.
+// the other handlers work on the memory stack:dispatching from a caching handler to them goes through LABEL_SPILL_TOS,
+// which writes tos back first,and they reload tos when they dispatch.so calls,returns,compiled code and every gc
+// safepoint(object allocations happen only there) see the whole stack in memory.
+// without it TOS is simply the memory slot and the handlers compile to plain stack code
+#ifdef CYS_TOS_CACHE
+#define TOS tos
+#ifndef NDEBUG
+#define TOS_PUSH(v)                                 \
+	do                                              \
+	{                                               \
+		if (stackTop >= STACK_END())                \
+			CYS_LOG_ERROR(TEXT("Stack overflow.")); \
+		stackTop[-1] = tos;                         \
+		tos = (v);                                  \
+		++stackTop;                                 \
+	} while (false)
+#else
+#define TOS_PUSH(v)         \
+	do                      \
+	{                       \
+		stackTop[-1] = tos; \
+		tos = (v);          \
+		++stackTop;         \
+	} while (false)
+#endif
+#define TOS_DROP() (tos = stackTop[-2], --stackTop)
+#define SPILL_TOS() (stackTop[-1] = tos)
+#define FILL_TOS() (tos = stackTop[-1])
+#else
+#define TOS (stackTop[-1])
+#define TOS_PUSH(v) PUSH(v)
+#define TOS_DROP() (--stackTop)
+#define SPILL_TOS() ((void)0)
+#define FILL_TOS() ((void)0)
+#endif
+
+// the stack capacity is checked once per call instead of once per push,the verifier bounds how deep a frame gets(maxStackDepth).
+// the stack may move,so pointers into it must be recomputed afterwards
+#define RESERVE_STACK(count)                                                   \
+	do                                                                         \
+	{                                                                          \
+		if (static_cast<size_t>(STACK_END() - stackTop) < (size_t)(count))     \
+			stackTop = Allocator::GetInstance()->GrowStack(stackTop, (count)); \
+	} while (false)
+
+// frames keep a byte ip(the sampling profiler,compiled code and a suspended vm read it),the interpreter runs a pc
+#define TO_IP(instruction) (frame->closure->function->chunk.opCodes.data() + (instruction)->offset)
+#define TO_PC(byteIp) (frame->closure->function->decodedInstructions.data() + frame->closure->function->decodedIndices[(byteIp) - frame->closure->function->chunk.opCodes.data()])
+
+#define SAVE_FRAME()             \
+	do                           \
+	{                            \
+		frame->ip = TO_IP(pc);   \
+		SET_STACK_TOP(stackTop); \
+	} while (false)
+
+#define LOAD_FRAME()                                                  \
+	do                                                                \
+	{                                                                 \
+		frame = PEEK_CALL_FRAME(0);                                   \
+		pc = TO_PC(frame->ip);                                        \
+		stackTop = STACK_TOP();                                       \
+		constants = frame->closure->function->chunk.constants.data(); \
+	} while (false)
+
+// fuel only burns at loop back edges and calls,so straight line code pays nothing for it.
+// when it runs out the frame is saved at the opcode itself,which runs again once the vm resumes
+#define BURN_FUEL()                        \
+	do                                     \
+	{                                      \
+		if (isFuelMetered && mFuel-- == 0) \
+		{                                  \
+			mFuel = 0;                     \
+			frame->ip = TO_IP(ins);        \
+			SET_STACK_TOP(stackTop);       \
+			mStatus = Status::SUSPENDED;   \
+			return;                        \
+		}                                  \
+	} while (false)
+
+// compiled code keeps its loops to itself,a metered vm never enters it
+#define RUN_NATIVE(start) (!isFuelMetered && RunNative(frame, start, pc, stackTop, constants, globals))
+
+// the safe points of the sampling profiler,the current frame's ip is saved so the sample sees the running opcode
+#define SAMPLE_CALL_STACK()                          \
+	do                                               \
+	{                                                \
+		if (SampleProfiler::IsSamplePending())       \
+		{                                            \
+			frame->ip = TO_IP(pc);                   \
+			SampleProfiler::GetInstance()->Sample(); \
+		}                                            \
+	} while (false)
+
+// the source token is only looked up when it is really needed(errors and native calls)
+#define RELATED_TOKEN() (frame->closure->function->chunk.GetRelatedToken(ins->offset))
+
+#define CREATE_OBJECT(T, ...) (SET_STACK_TOP(stackTop), Allocator::GetInstance()->CreateObject<T>(__VA_ARGS__))
+
+// a ref into an array,dict or upvalue writes into its owner,which may be old
+#define STORE_TO_REF(refValue, v)                    \
+	do                                               \
+	{                                                \
+		auto refObject = CYS_TO_REF_VALUE(refValue); \
+		*refObject->pointer = (v);                   \
+		WRITE_BARRIER(refObject->owner);             \
+	} while (false)
 
 #define CHECK_IDX_RANGE(v, idx)                 \
 	if (idx < 0 || idx >= (uint64_t)(v).size()) \
-		CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Idx out of range."));
+		CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Idx out of range."));
 
 #define CHECK_IDX_VALID(idxValue)    \
 	if (!CYS_IS_INT_VALUE(idxValue)) \
-		CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid idx type for array or string,only integer is available."));
+		CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid idx type for array or string,only integer is available."));
+
+#ifdef CYS_COMPUTED_GOTO
+#define CASE(opCode) \
+	case opCode:     \
+	LABEL_##opCode:
+#define DISPATCH()                         \
+	do                                     \
+	{                                      \
+		FILL_TOS();                        \
+		instruction = NEXT_INS();          \
+		PROFILE_OPCODE();                  \
+		goto *sDispatchTable[instruction]; \
+	} while (false)
+
+// dispatch from a handler that keeps the top in tos
+#ifdef CYS_TOS_CACHE
+#define DISPATCH_TOS()                        \
+	do                                        \
+	{                                         \
+		instruction = NEXT_INS();             \
+		PROFILE_OPCODE();                     \
+		goto *sTosDispatchTable[instruction]; \
+	} while (false)
+#else
+#define DISPATCH_TOS() DISPATCH()
+#endif
 
-		while (1)
+#define SET_DISPATCH_TARGET(opCode) sDispatchTable[opCode] = &&LABEL_##opCode
+#define SET_TOS_DISPATCH_TARGET(opCode) sTosDispatchTable[opCode] = &&LABEL_##opCode
+
+		static void *sDispatchTable[UINT8_COUNT];
+#ifdef CYS_TOS_CACHE
+		static void *sTosDispatchTable[UINT8_COUNT];
+#endif
+		static bool sIsDispatchTableInitialized = false;
+		if (!sIsDispatchTableInitialized)
 		{
-			if (CYS_IS_CALL_FRAME_STACK_EMPTY())
-				return;
-			CallFrame *frame = PEEK_CALL_FRAME(0);
+			for (int32_t i = 0; i < UINT8_COUNT; ++i)
+				sDispatchTable[i] = &&LABEL_UNKNOWN;
+
+			SET_DISPATCH_TARGET(OP_CONSTANT);
+			SET_DISPATCH_TARGET(OP_NULL);
+			SET_DISPATCH_TARGET(OP_ADD);
+			SET_DISPATCH_TARGET(OP_SUB);
+			SET_DISPATCH_TARGET(OP_MUL);
+			SET_DISPATCH_TARGET(OP_DIV);
+			SET_DISPATCH_TARGET(OP_MOD);
+			SET_DISPATCH_TARGET(OP_EQUAL);
+			SET_DISPATCH_TARGET(OP_GREATER);
+			SET_DISPATCH_TARGET(OP_LESS);
+			SET_DISPATCH_TARGET(OP_NOT);
+			SET_DISPATCH_TARGET(OP_MINUS);
+			SET_DISPATCH_TARGET(OP_BIT_AND);
+			SET_DISPATCH_TARGET(OP_BIT_OR);
+			SET_DISPATCH_TARGET(OP_BIT_LEFT_SHIFT);
+			SET_DISPATCH_TARGET(OP_BIT_RIGHT_SHIFT);
+			SET_DISPATCH_TARGET(OP_RETURN);
+			SET_DISPATCH_TARGET(OP_FACTORIAL);
+			SET_DISPATCH_TARGET(OP_ARRAY);
+			SET_DISPATCH_TARGET(OP_DICT);
+			SET_DISPATCH_TARGET(OP_GET_INDEX);
+			SET_DISPATCH_TARGET(OP_SET_INDEX);
+			SET_DISPATCH_TARGET(OP_JUMP_IF_FALSE);
+			SET_DISPATCH_TARGET(OP_JUMP);
+			SET_DISPATCH_TARGET(OP_LOOP);
+			SET_DISPATCH_TARGET(OP_POP);
+			SET_DISPATCH_TARGET(OP_SET_GLOBAL);
+			SET_DISPATCH_TARGET(OP_GET_GLOBAL);
+			SET_DISPATCH_TARGET(OP_SET_LOCAL);
+			SET_DISPATCH_TARGET(OP_GET_LOCAL);
+			SET_DISPATCH_TARGET(OP_GET_UPVALUE);
+			SET_DISPATCH_TARGET(OP_SET_UPVALUE);
+			SET_DISPATCH_TARGET(OP_CLOSE_UPVALUE);
+			SET_DISPATCH_TARGET(OP_REF_GLOBAL);
+			SET_DISPATCH_TARGET(OP_REF_LOCAL);
+			SET_DISPATCH_TARGET(OP_REF_INDEX_GLOBAL);
+			SET_DISPATCH_TARGET(OP_REF_INDEX_LOCAL);
+			SET_DISPATCH_TARGET(OP_REF_UPVALUE);
+			SET_DISPATCH_TARGET(OP_REF_INDEX_UPVALUE);
+			SET_DISPATCH_TARGET(OP_CALL);
+			SET_DISPATCH_TARGET(OP_CLASS);
+			SET_DISPATCH_TARGET(OP_CLASS_INSTANCE);
+			SET_DISPATCH_TARGET(OP_STRUCT);
+			SET_DISPATCH_TARGET(OP_SET_PROPERTY);
+			SET_DISPATCH_TARGET(OP_GET_PROPERTY);
+			SET_DISPATCH_TARGET(OP_GET_BASE);
+			SET_DISPATCH_TARGET(OP_CLOSURE);
+			SET_DISPATCH_TARGET(OP_APPREGATE_RESOLVE);
+			SET_DISPATCH_TARGET(OP_APPREGATE_RESOLVE_VAR_ARG);
+			SET_DISPATCH_TARGET(OP_MODULE);
+			SET_DISPATCH_TARGET(OP_INIT_VAR_ARG);
+			SET_DISPATCH_TARGET(OP_SET_GLOBAL_POP);
+			SET_DISPATCH_TARGET(OP_SET_LOCAL_POP);
+			SET_DISPATCH_TARGET(OP_JUMP_IF_FALSE_POP);
+			SET_DISPATCH_TARGET(OP_INC_LOCAL);
+			SET_DISPATCH_TARGET(OP_LESS_LOCAL_CONST_JUMP);
+			SET_DISPATCH_TARGET(OP_ADD_I64);
+			SET_DISPATCH_TARGET(OP_SUB_I64);
+			SET_DISPATCH_TARGET(OP_MUL_I64);
+			SET_DISPATCH_TARGET(OP_DIV_I64);
+			SET_DISPATCH_TARGET(OP_LESS_I64);
+			SET_DISPATCH_TARGET(OP_GREATER_I64);
+			SET_DISPATCH_TARGET(OP_ADD_F64);
+			SET_DISPATCH_TARGET(OP_SUB_F64);
+			SET_DISPATCH_TARGET(OP_MUL_F64);
+			SET_DISPATCH_TARGET(OP_DIV_F64);
+			SET_DISPATCH_TARGET(OP_LESS_F64);
+			SET_DISPATCH_TARGET(OP_GREATER_F64);
+			SET_DISPATCH_TARGET(OP_ADD_INT_QUICK);
+			SET_DISPATCH_TARGET(OP_ADD_REAL_QUICK);
+			SET_DISPATCH_TARGET(OP_SUB_INT_QUICK);
+			SET_DISPATCH_TARGET(OP_SUB_REAL_QUICK);
+			SET_DISPATCH_TARGET(OP_MUL_INT_QUICK);
+			SET_DISPATCH_TARGET(OP_MUL_REAL_QUICK);
+			SET_DISPATCH_TARGET(OP_LESS_INT_QUICK);
+			SET_DISPATCH_TARGET(OP_LESS_REAL_QUICK);
+			SET_DISPATCH_TARGET(OP_GREATER_INT_QUICK);
+			SET_DISPATCH_TARGET(OP_GREATER_REAL_QUICK);
+			SET_DISPATCH_TARGET(OP_EQUAL_INT_QUICK);
+			SET_DISPATCH_TARGET(OP_EQUAL_REAL_QUICK);
+			SET_DISPATCH_TARGET(OP_CONSTANT_LONG);
+			SET_DISPATCH_TARGET(OP_SET_GLOBAL_LONG);
+			SET_DISPATCH_TARGET(OP_GET_GLOBAL_LONG);
+			SET_DISPATCH_TARGET(OP_SET_LOCAL_LONG);
+			SET_DISPATCH_TARGET(OP_GET_LOCAL_LONG);
+			SET_DISPATCH_TARGET(OP_CLOSURE_LONG);
+			SET_DISPATCH_TARGET(OP_JUMP_IF_FALSE_LONG);
+			SET_DISPATCH_TARGET(OP_JUMP_LONG);
+			SET_DISPATCH_TARGET(OP_LOOP_LONG);
+			SET_DISPATCH_TARGET(OP_TAIL_CALL);
+			SET_DISPATCH_TARGET(OP_FOR_RANGE_INT);
+			SET_DISPATCH_TARGET(OP_FOR_EACH_ARRAY);
+			SET_DISPATCH_TARGET(OP_JUMP_IF_TRUE_POP);
+			SET_DISPATCH_TARGET(OP_SET_LOCAL_LOAD);
+
+#ifdef CYS_TOS_CACHE
+			// the handlers that keep the top in tos,the others are reached through LABEL_SPILL_TOS
+			for (int32_t i = 0; i < UINT8_COUNT; ++i)
+				sTosDispatchTable[i] = &&LABEL_SPILL_TOS;
+
+			SET_TOS_DISPATCH_TARGET(OP_CONSTANT);
+			SET_TOS_DISPATCH_TARGET(OP_CONSTANT_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_NULL);
+			SET_TOS_DISPATCH_TARGET(OP_POP);
+			SET_TOS_DISPATCH_TARGET(OP_GET_GLOBAL);
+			SET_TOS_DISPATCH_TARGET(OP_GET_GLOBAL_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_GET_LOCAL);
+			SET_TOS_DISPATCH_TARGET(OP_GET_LOCAL_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_GET_UPVALUE);
+			SET_TOS_DISPATCH_TARGET(OP_SET_GLOBAL);
+			SET_TOS_DISPATCH_TARGET(OP_SET_GLOBAL_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_SET_GLOBAL_POP);
+			SET_TOS_DISPATCH_TARGET(OP_SET_LOCAL);
+			SET_TOS_DISPATCH_TARGET(OP_SET_LOCAL_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_SET_LOCAL_POP);
+			SET_TOS_DISPATCH_TARGET(OP_SET_LOCAL_LOAD);
+			SET_TOS_DISPATCH_TARGET(OP_SET_UPVALUE);
+			SET_TOS_DISPATCH_TARGET(OP_SUB);
+			SET_TOS_DISPATCH_TARGET(OP_MUL);
+			SET_TOS_DISPATCH_TARGET(OP_DIV);
+			SET_TOS_DISPATCH_TARGET(OP_MOD);
+			SET_TOS_DISPATCH_TARGET(OP_BIT_AND);
+			SET_TOS_DISPATCH_TARGET(OP_BIT_OR);
+			SET_TOS_DISPATCH_TARGET(OP_BIT_LEFT_SHIFT);
+			SET_TOS_DISPATCH_TARGET(OP_BIT_RIGHT_SHIFT);
+			SET_TOS_DISPATCH_TARGET(OP_LESS);
+			SET_TOS_DISPATCH_TARGET(OP_GREATER);
+			SET_TOS_DISPATCH_TARGET(OP_EQUAL);
+			SET_TOS_DISPATCH_TARGET(OP_NOT);
+			SET_TOS_DISPATCH_TARGET(OP_MINUS);
+			SET_TOS_DISPATCH_TARGET(OP_ADD_I64);
+			SET_TOS_DISPATCH_TARGET(OP_SUB_I64);
+			SET_TOS_DISPATCH_TARGET(OP_MUL_I64);
+			SET_TOS_DISPATCH_TARGET(OP_DIV_I64);
+			SET_TOS_DISPATCH_TARGET(OP_LESS_I64);
+			SET_TOS_DISPATCH_TARGET(OP_GREATER_I64);
+			SET_TOS_DISPATCH_TARGET(OP_ADD_F64);
+			SET_TOS_DISPATCH_TARGET(OP_SUB_F64);
+			SET_TOS_DISPATCH_TARGET(OP_MUL_F64);
+			SET_TOS_DISPATCH_TARGET(OP_DIV_F64);
+			SET_TOS_DISPATCH_TARGET(OP_LESS_F64);
+			SET_TOS_DISPATCH_TARGET(OP_GREATER_F64);
+			SET_TOS_DISPATCH_TARGET(OP_ADD_INT_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_ADD_REAL_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_SUB_INT_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_SUB_REAL_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_MUL_INT_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_MUL_REAL_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_LESS_INT_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_LESS_REAL_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_GREATER_INT_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_GREATER_REAL_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_EQUAL_INT_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_EQUAL_REAL_QUICK);
+			SET_TOS_DISPATCH_TARGET(OP_JUMP);
+			SET_TOS_DISPATCH_TARGET(OP_JUMP_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_JUMP_IF_FALSE);
+			SET_TOS_DISPATCH_TARGET(OP_JUMP_IF_FALSE_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_JUMP_IF_FALSE_POP);
+			SET_TOS_DISPATCH_TARGET(OP_JUMP_IF_TRUE_POP);
+			SET_TOS_DISPATCH_TARGET(OP_LOOP);
+			SET_TOS_DISPATCH_TARGET(OP_LOOP_LONG);
+			SET_TOS_DISPATCH_TARGET(OP_INC_LOCAL);
+			SET_TOS_DISPATCH_TARGET(OP_LESS_LOCAL_CONST_JUMP);
+			SET_TOS_DISPATCH_TARGET(OP_FOR_RANGE_INT);
+			SET_TOS_DISPATCH_TARGET(OP_FOR_EACH_ARRAY);
+#endif
+
+			sIsDispatchTableInitialized = true;
+		}
+#else
+#define CASE(opCode) case opCode:
+#define DISPATCH() continue
+#define DISPATCH_TOS() continue
+#endif
 
-			auto instruction = READ_INS();
-			auto relatedToken = frame->closure->function->chunk.opCodeRelatedTokens[READ_INS()];
+		if (CYS_IS_CALL_FRAME_STACK_EMPTY())
+			return;
+
+		CallFrame *frame;
+		DecodedInstruction *pc;
+		DecodedInstruction *ins;
+		Value *stackTop;
+		Value *constants;
+		LOAD_FRAME();
+
+		Value *globals = GET_GLOBAL_VARIABLE(0);
+
+		const bool isFuelMetered = mFuelBudget != 0;
+
+#ifdef CYS_TOS_CACHE
+		Value tos = stackTop[-1];
+#endif
+
+		uint8_t instruction;
+
+#ifdef CYS_OPCODE_PROFILE
+		auto profiler = Config::GetInstance()->IsProfileOpCodes() ? &mOpCodeProfiler : nullptr;
+		auto isProfileCycles = Config::GetInstance()->IsProfileOpCodeCycles();
+		if (profiler)
+			profiler->Break();
+#endif
+
+		while (1)
+		{
+			instruction = NEXT_INS();
+			PROFILE_OPCODE();
 			switch (instruction)
 			{
-			case OP_RETURN:
+			CASE(OP_RETURN)
 			{
-				auto retCount = READ_INS();
-				Value *retValues = STACK_TOP() - retCount;
+				SAMPLE_CALL_STACK();
+				auto retCount = ins->operands[0];
+				Value *retValues = stackTop - retCount;
 
 				CLOSED_UPVALUES(frame->slots);
 
-				if (CYS_IS_CALL_FRAME_STACK_EMPTY())
-					return;
-
-				SET_STACK_TOP(frame->slots);
+				stackTop = frame->slots;
 
 				if (retCount == 0)
 				{
@@ -161,7 +738,7 @@ namespace CynicScript
 						callFrameTop->closure->function->SetCache(callFrameTop->argumentsHash, {Value()});
 					}
 					// -- Function cache relative
-					PUSH_STACK(Value());
+					PUSH(Value());
 				}
 				else
 				{
@@ -176,243 +753,245 @@ namespace CynicScript
 					for (uint8_t i = 0; i < retCount; ++i)
 					{
 						auto value = *(retValues + i);
-						PUSH_STACK(value);
+						PUSH(value);
 					}
 				}
 
-				frame = POP_CALL_FRAME();
-				break;
+				POP_CALL_FRAME();
+				SET_STACK_TOP(stackTop);
+
+				if (CYS_IS_CALL_FRAME_STACK_EMPTY())
+					return;
+
+				LOAD_FRAME();
+				RUN_NATIVE(pc);
+				DISPATCH();
 			}
-			case OP_CONSTANT:
+			CASE(OP_CONSTANT)
+			CASE(OP_CONSTANT_LONG)
 			{
-				auto pos = READ_INS();
-				auto v = frame->closure->function->chunk.constants[pos];
-				PUSH_STACK(v);
-				break;
+				TOS_PUSH(*ins->constant);
+				DISPATCH_TOS();
 			}
-			case OP_NULL:
+			CASE(OP_NULL)
 			{
-				PUSH_STACK(Value());
-				break;
+				TOS_PUSH(Value());
+				DISPATCH_TOS();
 			}
-			case OP_SET_GLOBAL:
+			CASE(OP_SET_GLOBAL)
+			CASE(OP_SET_GLOBAL_LONG)
 			{
-				auto pos = READ_INS();
-				auto v = PEEK_STACK(0);
+				// a ref may point to any slot,the top included.DISPATCH() reloads tos
+				SPILL_TOS();
+				auto v = TOS;
 
-				auto globalValue = GET_GLOBAL_VARIABLE(pos);
+				auto globalValue = globals + ins->index;
 
 				if (CYS_IS_REF_VALUE(*globalValue))
-					*CYS_TO_REF_VALUE(*globalValue)->pointer = v;
+					STORE_TO_REF(*globalValue, v);
 				else
 					*globalValue = v;
-				break;
+				DISPATCH();
 			}
-			case OP_GET_GLOBAL:
+			CASE(OP_GET_GLOBAL)
+			CASE(OP_GET_GLOBAL_LONG)
 			{
-				auto pos = READ_INS();
-				PUSH_STACK(*GET_GLOBAL_VARIABLE(pos));
-				break;
+				TOS_PUSH(globals[ins->index]);
+				DISPATCH_TOS();
 			}
-			case OP_SET_LOCAL:
+			CASE(OP_SET_LOCAL)
+			CASE(OP_SET_LOCAL_LONG)
 			{
-				auto pos = READ_INS();
-				auto value = PEEK_STACK(0);
+				// the slot may be the top itself
+				SPILL_TOS();
+				auto value = TOS;
 
-				auto slot = frame->slots + pos;
+				auto slot = frame->slots + ins->index;
 
 				if (CYS_IS_REF_VALUE((*slot)))
-					*CYS_TO_REF_VALUE((*slot))->pointer = value;
+					STORE_TO_REF((*slot), value);
 				else
 					*slot = value; // now assume base ptr on the stack bottom
-				break;
+				DISPATCH();
 			}
-			case OP_GET_LOCAL:
+			CASE(OP_GET_LOCAL)
+			CASE(OP_GET_LOCAL_LONG)
 			{
-				auto pos = READ_INS();
-				PUSH_STACK(frame->slots[pos]); // now assume base ptr on the stack bottom
-				break;
+				TOS_PUSH(frame->slots[ins->index]); // now assume base ptr on the stack bottom
+				DISPATCH_TOS();
 			}
-			case OP_SET_UPVALUE:
+			CASE(OP_SET_UPVALUE)
 			{
-				auto pos = READ_INS();
-				auto v = PEEK_STACK(0);
-				*frame->closure->upvalues[pos]->location = PEEK_STACK(0);
-				break;
+				SPILL_TOS();
+				auto upvalue = frame->closure->upvalues[ins->index];
+				*upvalue->location = TOS;
+				WRITE_BARRIER(upvalue);
+				DISPATCH();
 			}
-			case OP_GET_UPVALUE:
+			CASE(OP_GET_UPVALUE)
 			{
-				auto pos = READ_INS();
-				PUSH_STACK(*frame->closure->upvalues[pos]->location);
-				break;
+				TOS_PUSH(*frame->closure->upvalues[ins->index]->location);
+				DISPATCH_TOS();
 			}
-			case OP_CLOSE_UPVALUE:
+			CASE(OP_CLOSE_UPVALUE)
 			{
-				CLOSED_UPVALUES(STACK_TOP() - 1);
-				POP_STACK();
-				break;
+				CLOSED_UPVALUES(stackTop - 1);
+				DROP();
+				DISPATCH();
 			}
-			case OP_ADD:
+			CASE(OP_ADD)
 			{
-				Value left = PEEK_STACK(0);
-				Value right = PEEK_STACK(1);
+				QUICKEN_BINARY(OP_ADD_INT_QUICK, OP_ADD_REAL_QUICK);
+				Value left = PEEK(0);
+				Value right = PEEK(1);
 				Value result;
-				if (CYS_IS_REF_VALUE(left))
-					left = *CYS_TO_REF_VALUE(left)->pointer;
-				if (CYS_IS_REF_VALUE(right))
-					right = *CYS_TO_REF_VALUE(right)->pointer;
-				if (CYS_IS_INT_VALUE(left) && CYS_IS_INT_VALUE(right))
-					result = CYS_TO_INT_VALUE(left) + CYS_TO_INT_VALUE(right);
-				else if (CYS_IS_REAL_VALUE(left) && CYS_IS_REAL_VALUE(right))
-					result = CYS_TO_REAL_VALUE(left) + CYS_TO_REAL_VALUE(right);
-				else if (CYS_IS_INT_VALUE(left) && CYS_IS_REAL_VALUE(right))
-					result = CYS_TO_INT_VALUE(left) + CYS_TO_REAL_VALUE(right);
-				else if (CYS_IS_REAL_VALUE(left) && CYS_IS_INT_VALUE(right))
-					result = CYS_TO_REAL_VALUE(left) + CYS_TO_INT_VALUE(right);
-				else if (CYS_IS_STR_VALUE(left) && CYS_IS_STR_VALUE(right))
-					result = Allocator::GetInstance()->CreateObject<StrObject>(CYS_TO_STR_VALUE(left)->value + CYS_TO_STR_VALUE(right)->value);
-				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid binary op:{}+{},only (&)int-(&)int,(&)real-(&)real,(&)int-(&)real or (&)real-(&)int type pair is available."), left.ToString(), right.ToString());
+				ADD_VALUE(left, right, result);
 
-				MOVE_STACK_TOP(-2);
-				PUSH_STACK(result);
+				stackTop -= 2;
+				PUSH(result);
 
-				break;
+				DISPATCH();
 			}
-			case OP_SUB:
+			CASE(OP_SUB)
 			{
-				COMMON_BINARY(-);
-				break;
+				QUICKEN_BINARY(OP_SUB_INT_QUICK, OP_SUB_REAL_QUICK);
+				TOS_BINARY(COMMON_VALUE, Value, -);
+				DISPATCH_TOS();
 			}
-			case OP_MUL:
+			CASE(OP_MUL)
 			{
-				COMMON_BINARY(*);
-				break;
+				QUICKEN_BINARY(OP_MUL_INT_QUICK, OP_MUL_REAL_QUICK);
+				TOS_BINARY(COMMON_VALUE, Value, *);
+				DISPATCH_TOS();
 			}
-			case OP_DIV:
+			CASE(OP_DIV)
 			{
-				COMMON_BINARY(/);
-				break;
+				TOS_BINARY(COMMON_VALUE, Value, /);
+				DISPATCH_TOS();
 			}
-			case OP_MOD:
+			CASE(OP_MOD)
 			{
-				INTEGER_BINARY(%);
-				break;
+				TOS_BINARY(INTEGER_VALUE, Value, %);
+				DISPATCH_TOS();
 			}
-			case OP_BIT_AND:
+			CASE(OP_BIT_AND)
 			{
-				INTEGER_BINARY(&);
-				break;
+				TOS_BINARY(INTEGER_VALUE, Value, &);
+				DISPATCH_TOS();
 			}
-			case OP_BIT_OR:
+			CASE(OP_BIT_OR)
 			{
-				INTEGER_BINARY(|);
-				break;
+				TOS_BINARY(INTEGER_VALUE, Value, |);
+				DISPATCH_TOS();
 			}
-			case OP_BIT_LEFT_SHIFT:
+			CASE(OP_BIT_LEFT_SHIFT)
 			{
-				INTEGER_BINARY(<<);
-				break;
+				TOS_BINARY(INTEGER_VALUE, Value, <<);
+				DISPATCH_TOS();
 			}
-			case OP_BIT_RIGHT_SHIFT:
+			CASE(OP_BIT_RIGHT_SHIFT)
 			{
-				INTEGER_BINARY(>>);
-				break;
+				TOS_BINARY(INTEGER_VALUE, Value, >>);
+				DISPATCH_TOS();
 			}
-			case OP_LESS:
+			CASE(OP_LESS)
 			{
-				COMPARE_BINARY(<);
-				break;
+				QUICKEN_BINARY(OP_LESS_INT_QUICK, OP_LESS_REAL_QUICK);
+				TOS_BINARY(COMPARE_VALUE, bool, <);
+				DISPATCH_TOS();
 			}
-			case OP_GREATER:
+			CASE(OP_GREATER)
 			{
-				COMPARE_BINARY(>);
-				break;
+				QUICKEN_BINARY(OP_GREATER_INT_QUICK, OP_GREATER_REAL_QUICK);
+				TOS_BINARY(COMPARE_VALUE, bool, >);
+				DISPATCH_TOS();
 			}
-			case OP_NOT:
+			CASE(OP_NOT)
 			{
-				auto value = POP_STACK();
+				auto value = TOS;
 				if (CYS_IS_REF_VALUE(value))
 					value = *CYS_TO_REF_VALUE(value)->pointer;
 				if (!CYS_IS_BOOL_VALUE(value))
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid op:!{}, only bool type is available."), value.ToString());
-				PUSH_STACK(!CYS_TO_BOOL_VALUE(value));
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:!{}, only bool type is available."), value.ToString());
+				TOS = !CYS_TO_BOOL_VALUE(value);
+				DISPATCH_TOS();
 			}
-			case OP_EQUAL:
+			CASE(OP_EQUAL)
 			{
-				Value left = POP_STACK();
-				Value right = POP_STACK();
+				QUICKEN_BINARY(OP_EQUAL_INT_QUICK, OP_EQUAL_REAL_QUICK);
+				Value left = TOS;
+				Value right = PEEK(1);
 				if (CYS_IS_REF_VALUE(left))
 					left = *CYS_TO_REF_VALUE(left)->pointer;
 				if (CYS_IS_REF_VALUE(right))
 					right = *CYS_TO_REF_VALUE(right)->pointer;
-				PUSH_STACK(left == right);
-				break;
+				--stackTop;
+				TOS = left == right;
+				DISPATCH_TOS();
 			}
-			case OP_MINUS:
+			CASE(OP_MINUS)
 			{
-				auto value = POP_STACK();
+				auto value = TOS;
 				if (CYS_IS_REF_VALUE(value))
 					value = *CYS_TO_REF_VALUE(value)->pointer;
 				if (CYS_IS_INT_VALUE(value))
-					PUSH_STACK(-CYS_TO_INT_VALUE(value));
+					TOS = -CYS_TO_INT_VALUE(value);
 				else if (CYS_IS_REAL_VALUE(value))
-					PUSH_STACK(-CYS_TO_REAL_VALUE(value));
+					TOS = -CYS_TO_REAL_VALUE(value);
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid op:-{}, only -(int||real expr) is available."), value.ToString());
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:-{}, only -(int||real expr) is available."), value.ToString());
+				DISPATCH_TOS();
 			}
-			case OP_FACTORIAL:
+			CASE(OP_FACTORIAL)
 			{
-				auto value = POP_STACK();
+				auto value = POP();
 				if (CYS_IS_REF_VALUE(value))
 					value = *CYS_TO_REF_VALUE(value)->pointer;
 				if (CYS_IS_INT_VALUE(value))
-					PUSH_STACK(Factorial(CYS_TO_INT_VALUE(value)));
+					PUSH(Factorial(CYS_TO_INT_VALUE(value)));
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid op:{}!, only (int expr)! is available."), value.ToString());
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:{}!, only (int expr)! is available."), value.ToString());
+				DISPATCH();
 			}
-			case OP_ARRAY:
+			CASE(OP_ARRAY)
 			{
-				auto count = READ_INS();
+				auto count = ins->operands[0];
 
 				std::vector<Value> elements(count);
 				size_t i = 0;
-				for (auto e = STACK_TOP() - count; e < STACK_TOP(); ++e, ++i)
+				for (auto e = stackTop - count; e < stackTop; ++e, ++i)
 					elements[i] = *e;
 
-				auto arrayObject = Allocator::GetInstance()->CreateObject<ArrayObject>(elements);
+				auto arrayObject = CREATE_OBJECT(ArrayObject, elements);
 
-				MOVE_STACK_TOP(-count);
+				stackTop -= count;
 
-				PUSH_STACK(arrayObject);
-				break;
+				PUSH(arrayObject);
+				DISPATCH();
 			}
-			case OP_DICT:
+			CASE(OP_DICT)
 			{
-				auto count = READ_INS();
+				auto count = ins->operands[0];
 				ValueUnorderedMap elements;
 
-				auto dict = Allocator::GetInstance()->CreateObject<DictObject>(elements);
+				auto dict = CREATE_OBJECT(DictObject, elements);
 
-				for (auto e = STACK_TOP() - count * 2; e < STACK_TOP(); e += 2)
+				for (auto e = stackTop - count * 2; e < stackTop; e += 2)
 				{
 					auto key = *e;
 					auto value = *(e + 1);
 					dict->elements[key] = value;
 				}
 
-				MOVE_STACK_TOP(-count * 2);
+				stackTop -= count * 2;
 
-				PUSH_STACK(dict);
-				break;
+				PUSH(dict);
+				DISPATCH();
 			}
-			case OP_GET_INDEX:
+			CASE(OP_GET_INDEX)
 			{
-				auto idxValue = POP_STACK();
-				auto dsValue = POP_STACK();
+				auto idxValue = POP();
+				auto dsValue = POP();
 				if (CYS_IS_ARRAY_VALUE(dsValue))
 				{
 					auto array = CYS_TO_ARRAY_VALUE(dsValue);
@@ -421,7 +1000,7 @@ namespace CynicScript
 					auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), array->elements.size());
 					CHECK_IDX_RANGE(array->elements, intIdx);
 
-					PUSH_STACK(array->elements[intIdx]);
+					PUSH(array->elements[intIdx]);
 				}
 				else if (CYS_IS_STR_VALUE(dsValue))
 				{
@@ -429,7 +1008,8 @@ namespace CynicScript
 					CHECK_IDX_VALID(idxValue)
 					auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), strObj->value.size());
 					CHECK_IDX_RANGE(strObj->value, intIdx);
-					PUSH_STACK(Allocator::GetInstance()->CreateObject<StrObject>(strObj->value.substr(intIdx, 1)));
+					auto subStr = CREATE_OBJECT(StrObject, strObj->value.substr(intIdx, 1));
+					PUSH(subStr);
 				}
 				else if (CYS_IS_DICT_VALUE(dsValue))
 				{
@@ -438,17 +1018,17 @@ namespace CynicScript
 					auto iter = dict->elements.find(idxValue);
 
 					if (iter != dict->elements.end())
-						PUSH_STACK(iter->second);
+						PUSH(iter->second);
 					else
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No key in dict"));
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No key in dict"));
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_SET_INDEX:
+			CASE(OP_SET_INDEX)
 			{
-				auto idxValue = POP_STACK();
-				auto dsValue = POP_STACK();
-				auto newValue = PEEK_STACK(0);
+				auto idxValue = POP();
+				auto dsValue = POP();
+				auto newValue = PEEK(0);
 				if (CYS_IS_ARRAY_VALUE(dsValue))
 				{
 					auto array = CYS_TO_ARRAY_VALUE(dsValue);
@@ -456,6 +1036,7 @@ namespace CynicScript
 					auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), array->elements.size());
 					CHECK_IDX_RANGE(array->elements, intIdx);
 					array->elements[intIdx] = newValue;
+					WRITE_BARRIER(array);
 				}
 				else if (CYS_IS_STR_VALUE(dsValue))
 				{
@@ -465,7 +1046,7 @@ namespace CynicScript
 					CHECK_IDX_RANGE(strObj->value, intIdx)
 
 					if (!CYS_IS_STR_VALUE(newValue))
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Cannot insert a non string clip:{} to string:{}"), newValue.ToString(), strObj->value);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Cannot insert a non string clip:{} to string:{}"), newValue.ToString(), strObj->value);
 
 					strObj->value.append(CYS_TO_STR_VALUE(newValue)->value, intIdx, CYS_TO_STR_VALUE(newValue)->value.size());
 				}
@@ -473,124 +1054,406 @@ namespace CynicScript
 				{
 					auto dict = CYS_TO_DICT_VALUE(dsValue);
 					dict->elements[idxValue] = newValue;
+					WRITE_BARRIER(dict);
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_POP:
+			CASE(OP_POP)
 			{
-				POP_STACK();
-				break;
+				TOS_DROP();
+				DISPATCH_TOS();
 			}
-			case OP_JUMP_IF_FALSE:
+			CASE(OP_JUMP_IF_FALSE)
+			CASE(OP_JUMP_IF_FALSE_LONG)
 			{
-				uint16_t address = (*(frame->ip++) << 8) | (*(frame->ip++));
-				if (IsFalsey(PEEK_STACK(0)))
-					frame->ip += address;
-				break;
+				if (IsFalsey(TOS))
+					pc = ins->target;
+				DISPATCH_TOS();
 			}
-			case OP_JUMP:
+			CASE(OP_JUMP)
+			CASE(OP_JUMP_LONG)
 			{
-				uint16_t address = (*(frame->ip++) << 8) | (*(frame->ip++));
-				frame->ip += address;
-				break;
+				pc = ins->target;
+				DISPATCH_TOS();
 			}
-			case OP_LOOP:
+			CASE(OP_LOOP)
+			CASE(OP_LOOP_LONG)
 			{
-				uint16_t address = (*(frame->ip++) << 8) | (*(frame->ip++));
-				frame->ip -= address;
-				break;
+				// a suspended vm and compiled code continue from the memory stack
+				SPILL_TOS();
+				BURN_FUEL();
+				SAMPLE_CALL_STACK();
+				if (RUN_NATIVE(ins))
+					DISPATCH();
+				pc = ins->target;
+				DISPATCH_TOS();
 			}
-			case OP_REF_GLOBAL:
+			CASE(OP_FOR_RANGE_INT)
 			{
-				auto index = READ_INS();
-				PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(GET_GLOBAL_VARIABLE(index)));
-				break;
+				SPILL_TOS();
+				// counter,end,loop variable
+				auto state = frame->slots + ins->index;
+				if (!CYS_IS_INT_VALUE(state[0]) || !CYS_IS_INT_VALUE(state[1]))
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("range's bounds must be integers:{},{}."), state[0].ToString(), state[1].ToString());
+
+				auto counter = CYS_TO_INT_VALUE(state[0]);
+				if (counter >= CYS_TO_INT_VALUE(state[1]))
+					pc = ins->target;
+				else
+				{
+					state[2] = Value(counter);
+					state[0] = Value(counter + 1);
+				}
+				DISPATCH();
 			}
-			case OP_REF_LOCAL:
+			CASE(OP_FOR_EACH_ARRAY)
 			{
-				auto index = READ_INS();
-				PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(frame->slots + index));
-				break;
+				SPILL_TOS();
+				// iterable,index,loop variable
+				auto state = frame->slots + ins->index;
+				auto iterable = state[0];
+				if (CYS_IS_REF_VALUE(iterable))
+					iterable = *CYS_TO_REF_VALUE(iterable)->pointer;
+				if (!CYS_IS_ARRAY_VALUE(iterable))
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Only array is iterable in for-in stmt:{}."), iterable.ToString());
+
+				const auto &elements = CYS_TO_ARRAY_VALUE(iterable)->elements;
+				auto index = CYS_TO_INT_VALUE(state[1]);
+				if (index >= static_cast<int64_t>(elements.size())) // the array may shrink inside the loop,check every iteration
+					pc = ins->target;
+				else
+				{
+					state[2] = elements[index];
+					state[1] = Value(index + 1);
+				}
+				DISPATCH();
 			}
-			case OP_REF_UPVALUE:
+			CASE(OP_SET_GLOBAL_POP)
 			{
-				auto index = READ_INS();
-				PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(frame->closure->upvalues[index]->location));
-				break;
+				auto v = TOS;
+				--stackTop;
+
+				auto globalValue = globals + ins->index;
+
+				if (CYS_IS_REF_VALUE(*globalValue))
+					STORE_TO_REF(*globalValue, v);
+				else
+					*globalValue = v;
+				DISPATCH();
+			}
+			CASE(OP_SET_LOCAL_POP)
+			{
+				auto value = TOS;
+				--stackTop;
+
+				auto slot = frame->slots + ins->index;
+
+				if (CYS_IS_REF_VALUE((*slot)))
+					STORE_TO_REF((*slot), value);
+				else
+					*slot = value;
+				DISPATCH();
+			}
+			CASE(OP_JUMP_IF_FALSE_POP)
+			{
+				auto value = TOS;
+				TOS_DROP();
+				if (IsFalsey(value))
+					pc = ins->target;
+				DISPATCH_TOS();
+			}
+			CASE(OP_JUMP_IF_TRUE_POP)
+			{
+				auto value = TOS;
+				TOS_DROP();
+				if (CYS_IS_REF_VALUE(value))
+					value = *CYS_TO_REF_VALUE(value)->pointer;
+				if (!CYS_IS_BOOL_VALUE(value))
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:!{}, only bool type is available."), value.ToString());
+				if (CYS_TO_BOOL_VALUE(value))
+					pc = ins->target;
+				DISPATCH_TOS();
+			}
+			CASE(OP_SET_LOCAL_LOAD)
+			{
+				SPILL_TOS();
+				auto slot = frame->slots + ins->index;
+				// a ref slot keeps the ref,reloading the slot pushes the ref again instead of the assigned value
+				if (CYS_IS_REF_VALUE((*slot)))
+				{
+					STORE_TO_REF((*slot), PEEK(0));
+					PEEK(0) = *slot;
+				}
+				else
+					*slot = PEEK(0);
+				DISPATCH();
+			}
+			CASE(OP_INC_LOCAL)
+			{
+				// the slot may be the top,and a string result allocates
+				SPILL_TOS();
+				auto slot = frame->slots + ins->index;
+				Value left = *ins->constant;
+				Value right = *slot;
+				Value result;
+				ADD_VALUE(left, right, result);
+
+				if (CYS_IS_REF_VALUE((*slot)))
+					STORE_TO_REF((*slot), result);
+				else
+					*slot = result;
+				DISPATCH();
+			}
+			CASE(OP_LESS_LOCAL_CONST_JUMP)
+			{
+				SPILL_TOS();
+				Value left = frame->slots[ins->index];
+				Value right = *ins->constant;
+				bool result;
+				COMPARE_VALUE(left, <, right, result);
+				if (!result)
+					pc = ins->target;
+				DISPATCH_TOS();
+			}
+			CASE(OP_ADD_I64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, +);
+				DISPATCH_TOS();
+			}
+			CASE(OP_SUB_I64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, -);
+				DISPATCH_TOS();
+			}
+			CASE(OP_MUL_I64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, *);
+				DISPATCH_TOS();
+			}
+			CASE(OP_DIV_I64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, /);
+				DISPATCH_TOS();
+			}
+			CASE(OP_LESS_I64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, <);
+				DISPATCH_TOS();
+			}
+			CASE(OP_GREATER_I64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, >);
+				DISPATCH_TOS();
+			}
+			CASE(OP_ADD_F64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, +);
+				DISPATCH_TOS();
+			}
+			CASE(OP_SUB_F64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, -);
+				DISPATCH_TOS();
+			}
+			CASE(OP_MUL_F64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, *);
+				DISPATCH_TOS();
 			}
-			case OP_REF_INDEX_GLOBAL:
+			CASE(OP_DIV_F64)
 			{
-				auto index = READ_INS();
-				auto idxValue = POP_STACK();
+				TOS_TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, /);
+				DISPATCH_TOS();
+			}
+			CASE(OP_LESS_F64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, <);
+				DISPATCH_TOS();
+			}
+			CASE(OP_GREATER_F64)
+			{
+				TOS_TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, >);
+				DISPATCH_TOS();
+			}
+			CASE(OP_ADD_INT_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, +, OP_ADD);
+				DISPATCH_TOS();
+			}
+			CASE(OP_ADD_REAL_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, +, OP_ADD);
+				DISPATCH_TOS();
+			}
+			CASE(OP_SUB_INT_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, -, OP_SUB);
+				DISPATCH_TOS();
+			}
+			CASE(OP_SUB_REAL_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, -, OP_SUB);
+				DISPATCH_TOS();
+			}
+			CASE(OP_MUL_INT_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, *, OP_MUL);
+				DISPATCH_TOS();
+			}
+			CASE(OP_MUL_REAL_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, *, OP_MUL);
+				DISPATCH_TOS();
+			}
+			CASE(OP_LESS_INT_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, <, OP_LESS);
+				DISPATCH_TOS();
+			}
+			CASE(OP_LESS_REAL_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, <, OP_LESS);
+				DISPATCH_TOS();
+			}
+			CASE(OP_GREATER_INT_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, >, OP_GREATER);
+				DISPATCH_TOS();
+			}
+			CASE(OP_GREATER_REAL_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, >, OP_GREATER);
+				DISPATCH_TOS();
+			}
+			CASE(OP_EQUAL_INT_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, ==, OP_EQUAL);
+				DISPATCH_TOS();
+			}
+			CASE(OP_EQUAL_REAL_QUICK)
+			{
+				QUICK_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, ==, OP_EQUAL);
+				DISPATCH_TOS();
+			}
+			CASE(OP_REF_GLOBAL)
+			{
+				auto ref = CREATE_OBJECT(RefObject, globals + ins->index);
+				PUSH(ref);
+				DISPATCH();
+			}
+			CASE(OP_REF_LOCAL)
+			{
+				auto ref = CREATE_OBJECT(RefObject, frame->slots + ins->index);
+				PUSH(ref);
+				DISPATCH();
+			}
+			CASE(OP_REF_UPVALUE)
+			{
+				auto upvalue = frame->closure->upvalues[ins->index];
+				auto ref = CREATE_OBJECT(RefObject, upvalue->location, upvalue);
+				PUSH(ref);
+				DISPATCH();
+			}
+			CASE(OP_REF_INDEX_GLOBAL)
+			{
+				auto index = ins->index;
+				auto idxValue = POP();
 
-				auto globalValue = GET_GLOBAL_VARIABLE(index);
+				auto globalValue = globals + index;
 
 				if (CYS_IS_DICT_VALUE(*globalValue))
-					PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(&CYS_TO_DICT_VALUE(*globalValue)->elements[idxValue]));
+				{
+					auto dict = CYS_TO_DICT_VALUE(*globalValue);
+					auto element = &dict->elements[idxValue]; // a missing key is inserted
+					WRITE_BARRIER(dict);
+					auto ref = CREATE_OBJECT(RefObject, element, dict);
+					PUSH(ref);
+				}
 				else if (CYS_IS_ARRAY_VALUE(*globalValue))
 				{
 					auto array = CYS_TO_ARRAY_VALUE(*globalValue);
 					CHECK_IDX_VALID(idxValue)
 					auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), array->elements.size());
 					CHECK_IDX_RANGE(array->elements, intIdx);
-					PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(&(array->elements[intIdx])));
+					auto ref = CREATE_OBJECT(RefObject, &array->elements[intIdx], array);
+					PUSH(ref);
 				}
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid indexed reference type:{} not a dict or array value."), globalValue->ToString());
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid indexed reference type:{} not a dict or array value."), globalValue->ToString());
+				DISPATCH();
 			}
-			case OP_REF_INDEX_LOCAL:
+			CASE(OP_REF_INDEX_LOCAL)
 			{
-				auto index = READ_INS();
-				auto idxValue = POP_STACK();
+				auto index = ins->index;
+				auto idxValue = POP();
 				Value *v = frame->slots + index;
 				if (CYS_IS_DICT_VALUE((*v)))
-					PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(&CYS_TO_DICT_VALUE((*v))->elements[idxValue]));
+				{
+					auto dict = CYS_TO_DICT_VALUE((*v));
+					auto element = &dict->elements[idxValue]; // a missing key is inserted
+					WRITE_BARRIER(dict);
+					auto ref = CREATE_OBJECT(RefObject, element, dict);
+					PUSH(ref);
+				}
 				else if (CYS_IS_ARRAY_VALUE((*v)))
 				{
 					auto array = CYS_TO_ARRAY_VALUE((*v));
 					CHECK_IDX_VALID(idxValue)
 					auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), array->elements.size());
 					CHECK_IDX_RANGE(array->elements, intIdx);
-					PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(&array->elements[intIdx]));
+					auto ref = CREATE_OBJECT(RefObject, &array->elements[intIdx], array);
+					PUSH(ref);
 				}
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid indexed reference type:{} not a dict or array value."), v->ToString());
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid indexed reference type:{} not a dict or array value."), v->ToString());
+				DISPATCH();
 			}
-			case OP_REF_INDEX_UPVALUE:
+			CASE(OP_REF_INDEX_UPVALUE)
 			{
-				auto index = READ_INS();
-				auto idxValue = POP_STACK();
+				auto index = ins->index;
+				auto idxValue = POP();
 				Value *v = frame->closure->upvalues[index]->location;
 				if (CYS_IS_DICT_VALUE((*v)))
-					PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(&CYS_TO_DICT_VALUE((*v))->elements[idxValue]));
+				{
+					auto dict = CYS_TO_DICT_VALUE((*v));
+					auto element = &dict->elements[idxValue]; // a missing key is inserted
+					WRITE_BARRIER(dict);
+					auto ref = CREATE_OBJECT(RefObject, element, dict);
+					PUSH(ref);
+				}
 				else if (CYS_IS_ARRAY_VALUE((*v)))
 				{
 					auto array = CYS_TO_ARRAY_VALUE((*v));
 					CHECK_IDX_VALID(idxValue)
 					auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), array->elements.size());
 					CHECK_IDX_RANGE(array->elements, intIdx)
-					PUSH_STACK(Allocator::GetInstance()->CreateObject<RefObject>(&array->elements[intIdx]));
+					auto ref = CREATE_OBJECT(RefObject, &array->elements[intIdx], array);
+					PUSH(ref);
 				}
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid indexed reference type: {}  not a dict or array value."), v->ToString());
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid indexed reference type: {}  not a dict or array value."), v->ToString());
+				DISPATCH();
 			}
-			case OP_CALL:
+			CASE(OP_CALL)
+			CASE(OP_TAIL_CALL)
 			{
-				auto argCount = READ_INS();
-				auto callee = PEEK_STACK(argCount);
+				BURN_FUEL();
+				SAMPLE_CALL_STACK();
+				auto argCount = ins->operands[0];
+				auto callee = PEEK(argCount);
 				if (CYS_IS_CLOSURE_VALUE(callee) || CYS_IS_CLASS_CLOSURE_BIND_VALUE(callee)) // normal function or class member function
 				{
 					if (CYS_IS_CLASS_CLOSURE_BIND_VALUE(callee))
 					{
 						auto binding = CYS_TO_CLASS_CLOSURE_BIND_VALUE(callee);
 
-						SET_VALUE_FROM_STACK_TOP_OFFSET(-(argCount + 1), binding->receiver);
+						stackTop[-(argCount + 1)] = binding->receiver;
 						callee = binding->closure;
 					}
 
+					// before the var arg array below,it may be pushed on top of the arguments
+					RESERVE_STACK(CYS_TO_CLOSURE_VALUE(callee)->function->maxStackDepth);
+
 					if (CYS_TO_CLOSURE_VALUE(callee)->function->varArg > VarArg::NONE)
 					{
 						auto arity = CYS_TO_CLOSURE_VALUE(callee)->function->arity;
@@ -600,61 +1463,82 @@ namespace CynicScript
 							{
 								if (CYS_TO_CLOSURE_VALUE(callee)->function->varArg == VarArg::WITH_NAME)
 								{
-									PUSH_STACK(new ArrayObject());
+									auto varArgArray = CREATE_OBJECT(ArrayObject);
+									PUSH(varArgArray);
 									argCount = arity;
 								}
 								else
 									argCount = arity - 1;
 							}
 							else
-								CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No matching argument count."));
+								CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No matching argument count."));
 						}
 						else if (argCount >= arity)
 						{
 							auto diff = argCount - arity + 1;
 							if (CYS_TO_CLOSURE_VALUE(callee)->function->varArg == VarArg::WITH_NAME)
 							{
-								std::vector<Value> varArgs;
-								for (int32_t i = 0; i < diff; ++i)
-									varArgs.insert(varArgs.begin(), POP_STACK());
-								PUSH_STACK(new ArrayObject(varArgs));
+								// created while the arguments are still on the stack,a collection keeps them alive
+								auto varArgArray = CREATE_OBJECT(ArrayObject, std::vector<Value>(stackTop - diff, stackTop));
+								stackTop -= diff;
+								PUSH(varArgArray);
 								argCount = arity;
 							}
 							else
 							{
 								for (int32_t i = 0; i < diff; ++i)
-									POP_STACK();
+									DROP();
 								argCount = arity - 1;
 							}
 						}
 					}
 					else if (argCount != CYS_TO_CLOSURE_VALUE(callee)->function->arity)
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No matching argument count."));
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No matching argument count."));
 
-					auto argsHash = HashValueList(STACK_TOP() - argCount, STACK_TOP());
+					auto argsHash = HashValueList(stackTop - argCount, stackTop);
 					std::vector<Value> rets;
 					// ++ Function cache relative
 					if (Config::GetInstance()->IsUseFunctionCache() && CYS_TO_CLOSURE_VALUE(callee)->function->GetCache(argsHash, rets))
 					{
-						MOVE_STACK_TOP(-(argCount + 1));
+						stackTop -= argCount + 1;
 						for (int32_t i = 0; i < rets.size(); ++i)
-							PUSH_STACK(rets[i]);
+							PUSH(rets[i]);
 					}
 					else
 					// -- Function cache relative
 					{
+						// the cached result is keyed by the frame,so a tail call only reuses it while the function cache is off
+						if (instruction == OP_TAIL_CALL && !Config::GetInstance()->IsUseFunctionCache())
+						{
+							// close the caller's upvalues before its slots are overwritten,then slide callee and arguments down
+							CLOSED_UPVALUES(frame->slots);
+							std::copy(stackTop - argCount - 1, stackTop, frame->slots);
+							stackTop = frame->slots + argCount + 1;
+
+							frame->closure = CYS_TO_CLOSURE_VALUE(callee);
+							frame->depth++;
+							pc = frame->closure->function->decodedInstructions.data();
+							constants = frame->closure->function->chunk.constants.data();
+							RUN_NATIVE(pc);
+							DISPATCH();
+						}
+
 						// init a new frame
 						CallFrame newframe;
 						newframe.closure = CYS_TO_CLOSURE_VALUE(callee);
 						newframe.ip = newframe.closure->function->chunk.opCodes.data();
-						newframe.slots = STACK_TOP() - argCount - 1;
+						newframe.slots = stackTop - argCount - 1;
+						newframe.depth = frame->depth + 1;
 						// ++ Function cache relative
 						if (Config::GetInstance()->IsUseFunctionCache())
 						{
 							newframe.argumentsHash = argsHash;
 						}
 						// -- Function cache relative
+						SAVE_FRAME();
 						PUSH_CALL_FRAME(newframe);
+						LOAD_FRAME();
+						RUN_NATIVE(pc);
 					}
 				}
 				else if (CYS_IS_CLASS_INSTANCE_VALUE(callee)) // class constructor(for initializing class instance)
@@ -664,127 +1548,129 @@ namespace CynicScript
 
 					auto iter = klass->constructors.find(argCount);
 					if (iter == klass->constructors.end())
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Not matching argument count of class: {}'s constructors."), klass->name);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Not matching argument count of class: {}'s constructors."), klass->name);
 
 					auto ctor = iter->second;
+					RESERVE_STACK(ctor->function->maxStackDepth);
+
 					// init a new frame
 					CallFrame newframe;
 					newframe.closure = ctor;
 					newframe.ip = newframe.closure->function->chunk.opCodes.data();
-					newframe.slots = STACK_TOP() - argCount - 1;
+					newframe.slots = stackTop - argCount - 1;
+					newframe.depth = frame->depth + 1;
 
+					SAVE_FRAME();
 					PUSH_CALL_FRAME(newframe);
+					LOAD_FRAME();
 				}
 				else if (CYS_IS_NATIVE_FUNCTION_VALUE(callee)) // native function
 				{
 
 					Value result;
-					auto hasRetV = CYS_TO_NATIVE_FUNCTION_VALUE(callee)->fn(STACK_TOP() - argCount, argCount, relatedToken, result);
+					SET_STACK_TOP(stackTop);
+					auto hasRetV = CYS_TO_NATIVE_FUNCTION_VALUE(callee)->fn(stackTop - argCount, argCount, RELATED_TOKEN(), result);
 
-					MOVE_STACK_TOP(-(argCount + 1));
+					stackTop -= argCount + 1;
 
 					if (hasRetV)
-						PUSH_STACK(result);
+						PUSH(result);
 					else
-						PUSH_STACK(Value());
+						PUSH(Value());
 				}
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid callee,Only function is available: {}"), callee.ToString());
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid callee,Only function is available: {}"), callee.ToString());
+				DISPATCH();
 			}
-			case OP_CLASS:
+			CASE(OP_CLASS)
 			{
-				auto name = PEEK_STACK(0);
-				auto constructorCount = READ_INS();
-				auto parentClassCount = READ_INS();
-				auto varCount = READ_INS();
-				auto constCount = READ_INS();
-				auto fnCount = READ_INS();
-				auto enumCount = READ_INS();
+				auto name = PEEK(0);
+				auto constructorCount = ins->operands[0];
+				auto parentClassCount = ins->operands[1];
+				auto varCount = ins->operands[2];
+				auto constCount = ins->operands[3];
+				auto fnCount = ins->operands[4];
+				auto enumCount = ins->operands[5];
 
-				auto classObj = Allocator::GetInstance()->CreateObject<ClassObject>();
+				auto classObj = CREATE_OBJECT(ClassObject);
 
 				classObj->name = CYS_TO_STR_VALUE(name)->value;
-				POP_STACK(); // pop name strobject
+				DROP(); // pop name strobject
 
 				for (int32_t i = 0; i < constructorCount; ++i)
 				{
-					auto v = CYS_TO_CLOSURE_VALUE(POP_STACK());
+					auto v = CYS_TO_CLOSURE_VALUE(POP());
 					classObj->constructors[v->function->arity] = v;
 				}
 
 				for (int32_t i = 0; i < parentClassCount; ++i)
 				{
-					name = POP_STACK();
-					auto parentClass = POP_STACK();
+					name = POP();
+					auto parentClass = POP();
 					classObj->parents[CYS_TO_STR_VALUE(name)->value] = CYS_TO_CLASS_VALUE(parentClass);
 				}
 
 				for (int32_t i = 0; i < varCount; ++i)
 				{
-					name = POP_STACK();
-					auto v = POP_STACK();
-					v.permission = Permission::MUTABLE;
-					classObj->defaultMembers[CYS_TO_STR_VALUE(name)->value] = v;
+					name = POP();
+					classObj->defaultMembers[CYS_TO_STR_VALUE(name)->value] = POP();
 				}
 
 				for (int32_t i = 0; i < constCount; ++i)
 				{
-					name = POP_STACK();
-					auto v = POP_STACK();
-					v.permission = Permission::IMMUTABLE;
-					classObj->defaultMembers[CYS_TO_STR_VALUE(name)->value] = v;
+					name = POP();
+					const auto &nameStr = CYS_TO_STR_VALUE(name)->value;
+					classObj->defaultMembers[nameStr] = POP();
+					classObj->constMembers.insert(nameStr);
 				}
 
 				for (int32_t i = 0; i < fnCount; ++i)
 				{
-					name = POP_STACK();
-					auto v = POP_STACK();
-					v.permission = Permission::IMMUTABLE;
-					classObj->functions[CYS_TO_STR_VALUE(name)->value] = v;
+					name = POP();
+					classObj->functions[CYS_TO_STR_VALUE(name)->value] = POP();
 				}
 
 				for (int32_t i = 0; i < enumCount; ++i)
 				{
-					name = POP_STACK();
-					auto v = POP_STACK();
-					v.permission = Permission::IMMUTABLE;
-					classObj->enums[CYS_TO_STR_VALUE(name)->value] = v;
+					name = POP();
+					classObj->enums[CYS_TO_STR_VALUE(name)->value] = POP();
 				}
 
-				PUSH_STACK(classObj);
-				break;
+				PUSH(classObj);
+				DISPATCH();
 			}
-			case OP_CLASS_INSTANCE:
+			CASE(OP_CLASS_INSTANCE)
 			{
-				auto classObject = CYS_TO_CLASS_VALUE(POP_STACK());
+				// the class stays on the stack while allocating,the instance is not traced until it is created
+				auto classObject = CYS_TO_CLASS_VALUE(PEEK(0));
 
-				auto instance = Allocator::GetInstance()->CreateObject<ClassInstanceObject>(classObject);
+				auto instance = CREATE_OBJECT(ClassInstanceObject, classObject);
 
-				PUSH_STACK(instance);
-				break;
+				DROP();
+				PUSH(instance);
+				DISPATCH();
 			}
-			case OP_STRUCT:
+			CASE(OP_STRUCT)
 			{
-				auto eCount = READ_INS();
-				auto structObj = Allocator::GetInstance()->CreateObject<StructObject>();
+				auto eCount = ins->operands[0];
+				auto structObj = CREATE_OBJECT(StructObject);
 				for (int64_t i = 0; i < (int64_t)eCount; ++i)
 				{
-					auto key = CYS_TO_STR_VALUE(POP_STACK())->value;
-					auto value = POP_STACK();
+					auto key = CYS_TO_STR_VALUE(POP())->value;
+					auto value = POP();
 					structObj->elements[key] = value;
 				}
-				PUSH_STACK(structObj);
-				break;
+				PUSH(structObj);
+				DISPATCH();
 			}
-			case OP_GET_PROPERTY:
+			CASE(OP_GET_PROPERTY)
 			{
-				auto peekValue = PEEK_STACK(1);
+				auto peekValue = PEEK(1);
 
 				if (CYS_IS_REF_VALUE(peekValue))
 					peekValue = *(CYS_TO_REF_VALUE(peekValue)->pointer);
 
-				auto propName = CYS_TO_STR_VALUE(POP_STACK())->value;
+				const auto &propName = CYS_TO_STR_VALUE(POP())->value;
 				if (CYS_IS_CLASS_VALUE(peekValue))
 				{
 					ClassObject *klass = CYS_TO_CLASS_VALUE(peekValue);
@@ -792,32 +1678,51 @@ namespace CynicScript
 					Value member;
 					if (klass->GetMember(propName, member))
 					{
-						POP_STACK(); // pop class object
 						if (CYS_IS_CLOSURE_VALUE(member))
-							member = Allocator::GetInstance()->CreateObject<ClassClosureBindObject>(klass, CYS_TO_CLOSURE_VALUE(member));
+							member = CREATE_OBJECT(ClassClosureBindObject, klass, CYS_TO_CLOSURE_VALUE(member));
+						DROP(); // pop class object
 
-						PUSH_STACK(member);
-						break;
+						PUSH(member);
+						DISPATCH();
 					}
 					else
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No member: {} in class object:{}"), propName, klass->name);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No member: {} in class object:{}"), propName, klass->name);
 				}
 				else if (CYS_IS_CLASS_INSTANCE_VALUE(peekValue))
 				{
 					ClassInstanceObject *classInstance = CYS_TO_CLASS_INSTANCE_VALUE(peekValue);
+					auto &cache = GetPropertyCache(frame->closure->function, ins);
 
 					Value member;
-					if (classInstance->GetMember(propName, member))
+					bool hasValue = false;
+					if (cache.klass == classInstance->klass && cache.epoch == ClassObject::sEpoch)
+					{
+						if (cache.kind == FunctionObject::PropertyCache::FIELD && classInstance->IsOwnSlot(cache.slot))
+						{
+							member = classInstance->members[cache.slot];
+							hasValue = true;
+						}
+						else if (cache.kind == FunctionObject::PropertyCache::CLASS_MEMBER && !classInstance->IsOwnSlot(cache.slot))
+						{
+							member = cache.member;
+							hasValue = true;
+						}
+					}
+
+					if (!hasValue && (hasValue = classInstance->GetMember(propName, member)))
+						UpdatePropertyCache(cache, classInstance, propName, false);
+
+					if (hasValue)
 					{
-						POP_STACK(); // pop class object
 						if (CYS_IS_CLOSURE_VALUE(member))
-							member = Allocator::GetInstance()->CreateObject<ClassClosureBindObject>(classInstance, CYS_TO_CLOSURE_VALUE(member));
+							member = CREATE_OBJECT(ClassClosureBindObject, classInstance, CYS_TO_CLOSURE_VALUE(member));
+						DROP(); // pop class object
 
-						PUSH_STACK(member);
-						break;
+						PUSH(member);
+						DISPATCH();
 					}
 					else
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No member: {} in class object:{}"), propName, classInstance->klass->name);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No member: {} in class object:{}"), propName, classInstance->klass->name);
 				}
 				else if (CYS_IS_ENUM_VALUE(peekValue))
 				{
@@ -826,22 +1731,22 @@ namespace CynicScript
 					Value member;
 					if (enumObj->GetMember(propName, member))
 					{
-						POP_STACK(); // pop enum object
-						PUSH_STACK(member);
-						break;
+						DROP(); // pop enum object
+						PUSH(member);
+						DISPATCH();
 					}
 					else
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No member: {} in enum object: {}"), propName, enumObj->name);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No member: {} in enum object: {}"), propName, enumObj->name);
 				}
 				else if (CYS_IS_STRUCT_VALUE(peekValue))
 				{
 					auto structObj = CYS_TO_STRUCT_VALUE(peekValue);
 					auto iter = structObj->elements.find(propName);
 					if (iter == structObj->elements.end())
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No property: {} in struct object:{}."), propName, structObj->ToString());
-					POP_STACK(); // pop struct object
-					PUSH_STACK(iter->second);
-					break;
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No property: {} in struct object:{}."), propName, structObj->ToString());
+					DROP(); // pop struct object
+					PUSH(iter->second);
+					DISPATCH();
 				}
 				else if (CYS_IS_MODULE_VALUE(peekValue))
 				{
@@ -849,117 +1754,144 @@ namespace CynicScript
 					Value member;
 					if (moduleObj->GetMember(propName, member))
 					{
-						POP_STACK(); // pop module object
-						PUSH_STACK(member);
-						break;
+						DROP(); // pop module object
+						PUSH(member);
+						DISPATCH();
 					}
 					else
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No member: {} in module: {}"), propName, moduleObj->name);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No member: {} in module: {}"), propName, moduleObj->name);
 				}
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid call:not a valid class,enum or struct object instance: {}"), peekValue.ToString());
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid call:not a valid class,enum or struct object instance: {}"), peekValue.ToString());
 
-				break;
+				DISPATCH();
 			}
-			case OP_SET_PROPERTY:
+			CASE(OP_SET_PROPERTY)
 			{
-				auto peekValue = PEEK_STACK(1);
+				auto peekValue = PEEK(1);
 
 				if (CYS_IS_REF_VALUE(peekValue))
 					peekValue = *(CYS_TO_REF_VALUE(peekValue)->pointer);
 
-				auto propName = CYS_TO_STR_VALUE(POP_STACK())->value;
+				const auto &propName = CYS_TO_STR_VALUE(POP())->value;
 				if (CYS_IS_CLASS_VALUE(peekValue))
 				{
 					auto klass = CYS_TO_CLASS_VALUE(peekValue);
-					POP_STACK(); // pop class value
+					DROP(); // pop class value
 
 					Value member;
 					if (klass->GetMember(propName, member))
 					{
-						if (member.permission == Permission::IMMUTABLE)
-							CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Constant cannot be assigned twice: {}'s member: {} is a constant value"), klass->name, propName);
+						if (klass->IsConstMember(propName))
+							CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Constant cannot be assigned twice: {}'s member: {} is a constant value"), klass->name, propName);
 						else
-							klass->defaultMembers[propName] = PEEK_STACK(0);
+						{
+							klass->defaultMembers[propName] = PEEK(0);
+							WRITE_BARRIER(klass);
+							ClassObject::sEpoch++; // cached class-level lookups may resolve differently now
+						}
 					}
 					else
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No member named: {} in class: {}"), propName, klass->name);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No member named: {} in class: {}"), propName, klass->name);
 				}
 				else if (CYS_IS_CLASS_INSTANCE_VALUE(peekValue))
 				{
 					auto classInstance = CYS_TO_CLASS_INSTANCE_VALUE(peekValue);
-					POP_STACK(); // pop class value
+					DROP(); // pop class value
+
+					auto &cache = GetPropertyCache(frame->closure->function, ins);
+					if (cache.kind == FunctionObject::PropertyCache::FIELD &&
+						cache.klass == classInstance->klass &&
+						cache.epoch == ClassObject::sEpoch &&
+						classInstance->IsOwnSlot(cache.slot))
+					{
+						classInstance->members[cache.slot] = PEEK(0);
+						WRITE_BARRIER(classInstance);
+						DISPATCH();
+					}
 
 					Value member;
 					if (classInstance->GetMember(propName, member))
 					{
-						if (member.permission == Permission::IMMUTABLE)
-							CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Constant cannot be assigned twice: {}'s member: {} is a constant value"), classInstance->klass->name, propName);
+						if (classInstance->klass->IsConstMember(propName))
+							CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Constant cannot be assigned twice: {}'s member: {} is a constant value"), classInstance->klass->name, propName);
 						else
-							classInstance->members[propName] = PEEK_STACK(0);
+						{
+							classInstance->SetOwnMember(propName, PEEK(0));
+							WRITE_BARRIER(classInstance);
+							UpdatePropertyCache(cache, classInstance, propName, true);
+						}
 					}
 					else
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No member named: {} in class: {}"), propName, classInstance->klass->name);
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No member named: {} in class: {}"), propName, classInstance->klass->name);
 				}
 				else if (CYS_IS_STRUCT_VALUE(peekValue))
 				{
 					auto structObj = CYS_TO_STRUCT_VALUE(peekValue);
 					auto iter = structObj->elements.find(propName);
 					if (iter == structObj->elements.end())
-						CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No property: {} in struct object:{}"), propName, structObj->ToString());
-					POP_STACK(); // pop struct object
-					structObj->elements[iter->first] = PEEK_STACK(0);
-					break;
+						CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No property: {} in struct object:{}"), propName, structObj->ToString());
+					DROP(); // pop struct object
+					structObj->elements[iter->first] = PEEK(0);
+					WRITE_BARRIER(structObj);
+					DISPATCH();
 				}
 				else if (CYS_IS_ENUM_VALUE(peekValue))
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid call:cannot assign value to a enum object member."));
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid call:cannot assign value to a enum object member."));
 				else
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid call:not a valid class or struct object instance."));
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid call:not a valid class or struct object instance."));
+				DISPATCH();
 			}
-			case OP_GET_BASE:
+			CASE(OP_GET_BASE)
 			{
-				if (!CYS_IS_CLASS_VALUE(PEEK_STACK(1)))
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("Invalid class call:not a valid class instance."));
-				auto propName = CYS_TO_STR_VALUE(POP_STACK())->value;
-				auto klass = CYS_TO_CLASS_VALUE(POP_STACK());
+				if (!CYS_IS_CLASS_VALUE(PEEK(1)))
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid class call:not a valid class instance."));
+				auto propName = CYS_TO_STR_VALUE(POP())->value;
+				auto klass = CYS_TO_CLASS_VALUE(POP());
 				Value member;
 				bool hasValue = klass->GetParentMember(propName, member);
 				if (!hasValue)
-					CYS_LOG_ERROR_WITH_LOC(relatedToken, TEXT("No member: {} in class: {}'s parent class(es)."), propName, klass->name);
-				PUSH_STACK(member);
-				break;
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No member: {} in class: {}'s parent class(es)."), propName, klass->name);
+				PUSH(member);
+				DISPATCH();
 			}
-			case OP_CLOSURE:
+			CASE(OP_CLOSURE)
+			CASE(OP_CLOSURE_LONG)
 			{
-				auto pos = READ_INS();
-				auto func = CYS_TO_FUNCTION_VALUE(frame->closure->function->chunk.constants[pos]);
+				auto func = CYS_TO_FUNCTION_VALUE(*ins->constant);
+				Predecode(func);
 
-				PUSH_STACK(func); // push function object for avoiding gc
-				auto closure = Allocator::GetInstance()->CreateObject<ClosureObject>(func);
-				POP_STACK(); // pop function object
+				PUSH(func); // push function object for avoiding gc
+				auto closure = CREATE_OBJECT(ClosureObject, func);
+				DROP(); // pop function object
 
-				PUSH_STACK(closure);
+				PUSH(closure);
 
 				for (int32_t i = 0; i < closure->upvalues.size(); ++i)
 				{
-					auto index = READ_INS();
-					auto depth = READ_INS();
-					if (depth == CALL_FRAME_COUNT() - 1)
+					auto index = ins->upvalues[i * 2];
+					auto depth = ins->upvalues[i * 2 + 1];
+					if (depth == frame->depth)
 					{
+						SET_STACK_TOP(stackTop);
 						auto captured = CAPTURE_UPVALUE(frame->slots + index);
 						closure->upvalues[i] = captured;
 					}
 					else
 						closure->upvalues[i] = frame->closure->upvalues[index];
+					// capturing allocates,an earlier capture may have promoted the closure
+					WRITE_BARRIER(closure);
 				}
 
-				break;
+				DISPATCH();
 			}
-			case OP_APPREGATE_RESOLVE:
+			CASE(OP_APPREGATE_RESOLVE)
 			{
-				auto count = READ_INS();
-				auto value = POP_STACK();
+				auto count = ins->operands[0];
+				// nothing to resolve,the value stays as the result of the assignment
+				if (count == 0)
+					DISPATCH();
+				auto value = POP();
 				if (CYS_IS_ARRAY_VALUE(value))
 				{
 					auto arrayObj = CYS_TO_ARRAY_VALUE(value);
@@ -968,16 +1900,16 @@ namespace CynicScript
 						auto diff = count - arrayObj->elements.size();
 						while (diff > 0)
 						{
-							PUSH_STACK(Value());
+							PUSH(Value());
 							diff--;
 						}
 						for (int32_t i = static_cast<int32_t>(arrayObj->elements.size() - 1); i >= 0; --i)
-							PUSH_STACK(arrayObj->elements[i]);
+							PUSH(arrayObj->elements[i]);
 					}
 					else
 					{
 						for (int32_t i = count - 1; i >= 0; --i)
-							PUSH_STACK(arrayObj->elements[i]);
+							PUSH(arrayObj->elements[i]);
 					}
 				}
 				else
@@ -985,129 +1917,1055 @@ namespace CynicScript
 					auto diff = count - 1;
 					while (diff > 0)
 					{
-						PUSH_STACK(Value());
+						PUSH(Value());
 						diff--;
 					}
 
-					PUSH_STACK(value);
+					PUSH(value);
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_APPREGATE_RESOLVE_VAR_ARG:
+			CASE(OP_APPREGATE_RESOLVE_VAR_ARG)
 			{
-				auto count = READ_INS();
-				auto value = PEEK_STACK(0);
+				auto count = ins->operands[0];
+				auto value = PEEK(0);
 				if (CYS_IS_ARRAY_VALUE(value))
 				{
 					auto arrayObj = CYS_TO_ARRAY_VALUE(value);
 					if (count >= arrayObj->elements.size())
 					{
-						ArrayObject *varArgArray = Allocator::GetInstance()->CreateObject<ArrayObject>();
+						ArrayObject *varArgArray = CREATE_OBJECT(ArrayObject);
 
-						POP_STACK(); // pop value object
+						DROP(); // pop value object
 
 						auto diff = count - arrayObj->elements.size();
 						for (int32_t i = static_cast<int32_t>(diff); i > 0; --i)
 						{
 							if (i == diff)
-								PUSH_STACK(varArgArray);
+								PUSH(varArgArray);
 							else
-								PUSH_STACK(Value());
+								PUSH(Value());
 						}
 
 						for (int32_t i = static_cast<int32_t>(arrayObj->elements.size() - 1); i >= 0; --i)
-							PUSH_STACK(arrayObj->elements[i]);
+							PUSH(arrayObj->elements[i]);
 					}
 					else
 					{
-						ArrayObject *varArgArray = Allocator::GetInstance()->CreateObject<ArrayObject>();
+						ArrayObject *varArgArray = CREATE_OBJECT(ArrayObject);
 
-						POP_STACK(); // pop value object
+						DROP(); // pop value object
 
 						for (int32_t i = count - 1; i < arrayObj->elements.size(); ++i)
 							varArgArray->elements.emplace_back(arrayObj->elements[i]);
-						PUSH_STACK(varArgArray);
+						PUSH(varArgArray);
 
 						for (int32_t i = count - 2; i >= 0; --i)
-							PUSH_STACK(arrayObj->elements[i]);
+							PUSH(arrayObj->elements[i]);
 					}
 				}
 				else
 				{
-					auto arrayObj = Allocator::GetInstance()->CreateObject<ArrayObject>();
+					auto arrayObj = CREATE_OBJECT(ArrayObject);
+
+					DROP(); // pop value object
 
-					POP_STACK(); // pop value object
+					// the var arg alone takes the value,like it takes every element of an array
+					if (count == 1)
+					{
+						arrayObj->elements.emplace_back(value);
+						PUSH(arrayObj);
+						DISPATCH();
+					}
 
 					auto diff = count - 2;
 					while (diff > 0)
 					{
-						PUSH_STACK(Value());
+						PUSH(Value());
 						diff--;
 					}
 
-					PUSH_STACK(arrayObj);
-					PUSH_STACK(value);
+					PUSH(arrayObj);
+					PUSH(value);
 				}
-				break;
+				DISPATCH();
 			}
-			case OP_MODULE:
+			CASE(OP_MODULE)
 			{
-				auto name = PEEK_STACK(0);
+				auto name = PEEK(0);
 				auto nameStr = CYS_TO_STR_VALUE(name)->value;
 
-				auto varCount = READ_INS();
-				auto constCount = READ_INS();
+				auto varCount = ins->operands[0];
+				auto constCount = ins->operands[1];
 
-				auto moduleObj = Allocator::GetInstance()->CreateObject<ModuleObject>();
+				auto moduleObj = CREATE_OBJECT(ModuleObject);
 				moduleObj->name = nameStr;
-				POP_STACK(); // pop name strobject
+				DROP(); // pop name strobject
 
 				for (int32_t i = 0; i < constCount; ++i)
 				{
-					name = POP_STACK();
+					name = POP();
 					nameStr = CYS_TO_STR_VALUE(name)->value;
-					auto v = POP_STACK();
-					v.permission = Permission::IMMUTABLE;
-					moduleObj->members[nameStr] = v;
+					moduleObj->members[nameStr] = POP();
 				}
 
 				for (int32_t i = 0; i < varCount; ++i)
 				{
-					name = POP_STACK();
+					name = POP();
 					nameStr = CYS_TO_STR_VALUE(name)->value;
-					auto v = POP_STACK();
-					v.permission = Permission::MUTABLE;
-					moduleObj->members[nameStr] = v;
+					moduleObj->members[nameStr] = POP();
 				}
 
-				PUSH_STACK(moduleObj);
+				PUSH(moduleObj);
 
-				break;
+				DISPATCH();
 			}
-			case OP_INIT_VAR_ARG:
+			CASE(OP_INIT_VAR_ARG)
 			{
-				auto count = READ_INS();
+				auto count = ins->operands[0];
 				std::vector<Value> values(count);
 				std::vector<Value> keys(count);
 				for (int32_t i = count - 1; i >= 0; --i)
-					keys[i] = POP_STACK();
+					keys[i] = POP();
 				for (uint32_t i = 0; i < count; ++i)
-					values[i] = POP_STACK();
+					values[i] = POP();
 				for (uint32_t i = 0; i < count; ++i)
 				{
-					PUSH_STACK(values[i]);
-					PUSH_STACK(keys[i]);
+					PUSH(values[i]);
+					PUSH(keys[i]);
 				}
-				break;
+				DISPATCH();
 			}
+#ifdef CYS_TOS_CACHE
+			LABEL_SPILL_TOS:
+				SPILL_TOS();
+				goto *sDispatchTable[instruction];
+#endif
 			default:
-				break;
+#ifdef CYS_COMPUTED_GOTO
+			LABEL_UNKNOWN:
+#endif
+				DISPATCH();
 			}
 		}
 	}
 
+	// a generic opcode turns into its quick form after QUICKEN_THRESHOLD hits,every deoptimization of the site doubles that
+	constexpr uint16_t QUICKEN_THRESHOLD = 8;
+	constexpr uint8_t QUICKEN_MAX_BACKOFF = 12;
+
+	void VM::Quicken(FunctionObject *function, DecodedInstruction *instruction, uint8_t quickOpCode) noexcept
+	{
+		auto &site = function->quickenSites[instruction->index];
+		if (++site.counter < (QUICKEN_THRESHOLD << site.backoff))
+			return;
+
+		site.counter = 0;
+		instruction->opCode = quickOpCode;
+		function->chunk.opCodes[instruction->offset] = quickOpCode;
+		function->quickenedCount++;
+	}
+
+	void VM::Dequicken(FunctionObject *function, DecodedInstruction *instruction, uint8_t genericOpCode) noexcept
+	{
+		auto &site = function->quickenSites[instruction->index];
+		if (site.backoff < QUICKEN_MAX_BACKOFF)
+			site.backoff++;
+
+		instruction->opCode = genericOpCode;
+		function->chunk.opCodes[instruction->offset] = genericOpCode;
+		function->quickenedCount--;
+	}
+
+	// a site that saw this many different receiver classes stops caching
+	constexpr uint8_t PROPERTY_CACHE_MAX_MISS = 4;
+
+	FunctionObject::PropertyCache &VM::GetPropertyCache(FunctionObject *function, const DecodedInstruction *instruction) noexcept
+	{
+		return function->propertyCaches[instruction->index];
+	}
+
+	// called after a slow path lookup succeeded,remember where the member lives for the receiver's class
+	void VM::UpdatePropertyCache(FunctionObject::PropertyCache &cache, ClassInstanceObject *instance, const STRING &name, bool isWrite) noexcept
+	{
+		using PropertyCache = FunctionObject::PropertyCache;
+		if (cache.kind == PropertyCache::MEGAMORPHIC)
+			return;
+
+		auto klass = instance->klass;
+		if (cache.klass && cache.klass != klass && ++cache.missCount >= PROPERTY_CACHE_MAX_MISS)
+		{
+			cache = PropertyCache();
+			cache.kind = PropertyCache::MEGAMORPHIC;
+			return;
+		}
+
+		auto iter = klass->memberSlots.find(name);
+		cache.klass = klass;
+		cache.epoch = ClassObject::sEpoch;
+		cache.slot = iter == klass->memberSlots.end() ? UINT32_MAX : iter->second;
+		cache.member = Value();
+
+		if (instance->IsOwnSlot(cache.slot))
+			cache.kind = PropertyCache::FIELD;
+		else if (!isWrite && klass->GetMember(name, cache.member))
+			cache.kind = PropertyCache::CLASS_MEMBER;
+		else
+			cache.kind = PropertyCache::EMPTY;
+	}
+
 	bool VM::IsFalsey(const Value &v) noexcept
 	{
 		return CYS_IS_NULL_VALUE(v) || (CYS_IS_BOOL_VALUE(v) && !CYS_TO_BOOL_VALUE(v));
 	}
-}
\ No newline at end of file
+
+	bool VM::RunNative(CallFrame *frame, const DecodedInstruction *start, DecodedInstruction *&pc, Value *&stackTop, Value *constants, Value *globals) noexcept
+	{
+		auto function = frame->closure->function;
+		auto offset = start->offset;
+		NativeContext context{frame, stackTop, constants, globals};
+
+		// translated once on the first call,a function the register vm cannot help keeps running on the stack vm
+		if (!function->isRegisterCompiled && Config::GetInstance()->GetBackend() != Config::Backend::STACK)
+		{
+			function->isRegisterCompiled = true;
+			function->registerCode = RegisterCompiler::Compile(function, Config::GetInstance()->GetBackend() == Config::Backend::REGISTER);
+		}
+
+		if (function->aotEntry)
+			offset = function->aotEntry(&context, offset);
+		else if (auto registerCode = function->registerCode)
+		{
+			// the depth differs from the translated one after a call that returned several values
+			const auto &entry = registerCode->entries[offset];
+			if (entry.pc == -1 || stackTop - frame->slots != entry.depth || frame->slots + registerCode->maxDepth > STACK_END())
+				return false;
+			offset = ExecuteRegister(&context, registerCode, entry.pc);
+		}
+#ifdef CYS_JIT
+		else if (function->jitCode)
+			offset = function->jitCode->Run(&context, offset);
+		// the counter stops at the threshold,a function that failed to compile is not retried
+		else if (function->jitHotness < JIT_THRESHOLD && ++function->jitHotness == JIT_THRESHOLD && Config::GetInstance()->IsUseJit() &&
+				 (function->jitCode = Jit::Compile(function, GetNativeStubs())))
+			offset = function->jitCode->Run(&context, offset);
+#endif
+		else
+			return false;
+
+		pc = function->decodedInstructions.data() + function->decodedIndices[offset];
+		stackTop = context.stackTop;
+		return true;
+	}
+
+	static bool IsQuickenSite(uint8_t opCode) noexcept
+	{
+		switch (opCode)
+		{
+		case OP_ADD:
+		case OP_SUB:
+		case OP_MUL:
+		case OP_LESS:
+		case OP_GREATER:
+		case OP_EQUAL:
+		case OP_ADD_INT_QUICK:
+		case OP_ADD_REAL_QUICK:
+		case OP_SUB_INT_QUICK:
+		case OP_SUB_REAL_QUICK:
+		case OP_MUL_INT_QUICK:
+		case OP_MUL_REAL_QUICK:
+		case OP_LESS_INT_QUICK:
+		case OP_LESS_REAL_QUICK:
+		case OP_GREATER_INT_QUICK:
+		case OP_GREATER_REAL_QUICK:
+		case OP_EQUAL_INT_QUICK:
+		case OP_EQUAL_REAL_QUICK:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void VM::Predecode(FunctionObject *function) noexcept
+	{
+		if (!function->decodedInstructions.empty())
+			return;
+
+		const auto &chunk = function->chunk;
+		auto &instructions = function->decodedInstructions;
+		auto &indices = function->decodedIndices;
+		indices.assign(chunk.opCodes.size() + 1, UINT32_MAX);
+
+		// these opcodes have no operands,their index numbers the quickening and inline cache state they own
+		uint32_t quickenSiteCount = 0;
+		uint32_t propertyCacheCount = 0;
+
+		for (size_t offset = 0; offset < chunk.opCodes.size(); offset += 1 + BytecodeOptimizePass::GetOperandSize(chunk, offset))
+		{
+			DecodedInstruction instruction;
+			instruction.opCode = chunk.opCodes[offset];
+			instruction.offset = static_cast<uint32_t>(offset);
+
+			auto operandSize = std::min<size_t>(BytecodeOptimizePass::GetOperandSize(chunk, offset), sizeof(instruction.operands));
+			std::copy_n(chunk.opCodes.begin() + offset + 1, operandSize, instruction.operands);
+			instruction.index = instruction.operands[0];
+
+			switch (instruction.opCode)
+			{
+			case OP_CONSTANT_LONG:
+			case OP_SET_GLOBAL_LONG:
+			case OP_GET_GLOBAL_LONG:
+			case OP_SET_LOCAL_LONG:
+			case OP_GET_LOCAL_LONG:
+			case OP_CLOSURE_LONG:
+				instruction.index = (instruction.operands[0] << 8) | instruction.operands[1];
+				break;
+			default:
+				break;
+			}
+
+			switch (instruction.opCode)
+			{
+			case OP_CONSTANT:
+			case OP_CONSTANT_LONG:
+				instruction.constant = chunk.constants.data() + instruction.index;
+				break;
+			case OP_CLOSURE:
+			case OP_CLOSURE_LONG:
+				instruction.constant = chunk.constants.data() + instruction.index;
+				instruction.upvalues = chunk.opCodes.data() + offset + (instruction.opCode == OP_CLOSURE_LONG ? 3 : 2);
+				break;
+			case OP_INC_LOCAL:
+			case OP_LESS_LOCAL_CONST_JUMP:
+				instruction.constant = chunk.constants.data() + instruction.operands[1];
+				break;
+			case OP_GET_PROPERTY:
+			case OP_SET_PROPERTY:
+				instruction.index = propertyCacheCount++;
+				break;
+			default:
+				if (IsQuickenSite(instruction.opCode))
+					instruction.index = quickenSiteCount++;
+				break;
+			}
+
+			indices[offset] = static_cast<uint32_t>(instructions.size());
+			instructions.emplace_back(instruction);
+		}
+
+		// never runs,the verifier keeps every path inside the chunk.compiled code may stop at the end of the chunk
+		// and a frame saved after the last opcode maps here
+		indices[chunk.opCodes.size()] = static_cast<uint32_t>(instructions.size());
+		instructions.emplace_back().offset = static_cast<uint32_t>(chunk.opCodes.size());
+
+		function->quickenSites.assign(quickenSiteCount, {});
+		function->propertyCaches.assign(propertyCacheCount, {});
+
+		// the array is complete now,the target pointers stay valid
+		for (auto &instruction : instructions)
+		{
+			if (instruction.offset < chunk.opCodes.size() && BytecodeOptimizePass::IsJumpOpCode(instruction.opCode))
+				instruction.target = instructions.data() + indices[BytecodeOptimizePass::GetJumpTarget(chunk, instruction.offset)];
+		}
+	}
+
+// the stubs reuse the interpreter's macros,so they bind the same names VM::Execute keeps in local variables.
+// jumps only report whether they are taken,the compiled code branches by itself.
+// they decode their operands from the bytes,so the token is looked up by the byte ip as well
+#undef RELATED_TOKEN
+#define RELATED_TOKEN() (frame->closure->function->chunk.GetRelatedToken(static_cast<uint32_t>(ip - 1 - frame->closure->function->chunk.opCodes.data())))
+#define NATIVE_STUB(opCode) stubs[opCode] = [](NativeContext *context, [[maybe_unused]] uint8_t *ip) noexcept -> bool
+
+#define LOAD_NATIVE_CONTEXT()                             \
+	[[maybe_unused]] auto frame = context->frame;         \
+	[[maybe_unused]] auto &stackTop = context->stackTop;  \
+	[[maybe_unused]] auto constants = context->constants; \
+	[[maybe_unused]] auto globals = context->globals
+
+	const NativeStub *VM::GetNativeStubs() noexcept
+	{
+		static NativeStub stubs[UINT8_COUNT] = {};
+		static bool sIsStubTableInitialized = false;
+		if (sIsStubTableInitialized)
+			return stubs;
+
+		NATIVE_STUB(OP_CONSTANT)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(constants[READ_INS()]);
+			return false;
+		};
+		NATIVE_STUB(OP_CONSTANT_LONG)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(constants[READ_U16()]);
+			return false;
+		};
+		NATIVE_STUB(OP_NULL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(Value());
+			return false;
+		};
+		NATIVE_STUB(OP_SET_GLOBAL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto globalValue = globals + READ_INS();
+			if (CYS_IS_REF_VALUE(*globalValue))
+				STORE_TO_REF(*globalValue, PEEK(0));
+			else
+				*globalValue = PEEK(0);
+			return false;
+		};
+		NATIVE_STUB(OP_SET_GLOBAL_LONG)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto globalValue = globals + READ_U16();
+			if (CYS_IS_REF_VALUE(*globalValue))
+				STORE_TO_REF(*globalValue, PEEK(0));
+			else
+				*globalValue = PEEK(0);
+			return false;
+		};
+		NATIVE_STUB(OP_SET_GLOBAL_POP)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto globalValue = globals + READ_INS();
+			auto v = POP();
+			if (CYS_IS_REF_VALUE(*globalValue))
+				STORE_TO_REF(*globalValue, v);
+			else
+				*globalValue = v;
+			return false;
+		};
+		NATIVE_STUB(OP_GET_GLOBAL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(globals[READ_INS()]);
+			return false;
+		};
+		NATIVE_STUB(OP_GET_GLOBAL_LONG)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(globals[READ_U16()]);
+			return false;
+		};
+		NATIVE_STUB(OP_SET_LOCAL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto slot = frame->slots + READ_INS();
+			if (CYS_IS_REF_VALUE((*slot)))
+				STORE_TO_REF((*slot), PEEK(0));
+			else
+				*slot = PEEK(0);
+			return false;
+		};
+		NATIVE_STUB(OP_SET_LOCAL_LONG)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto slot = frame->slots + READ_U16();
+			if (CYS_IS_REF_VALUE((*slot)))
+				STORE_TO_REF((*slot), PEEK(0));
+			else
+				*slot = PEEK(0);
+			return false;
+		};
+		NATIVE_STUB(OP_SET_LOCAL_POP)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto slot = frame->slots + READ_INS();
+			auto value = POP();
+			if (CYS_IS_REF_VALUE((*slot)))
+				STORE_TO_REF((*slot), value);
+			else
+				*slot = value;
+			return false;
+		};
+		NATIVE_STUB(OP_SET_LOCAL_LOAD)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto slot = frame->slots + READ_INS();
+			if (CYS_IS_REF_VALUE((*slot)))
+			{
+				STORE_TO_REF((*slot), PEEK(0));
+				PEEK(0) = *slot;
+			}
+			else
+				*slot = PEEK(0);
+			return false;
+		};
+		NATIVE_STUB(OP_GET_LOCAL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(frame->slots[READ_INS()]);
+			return false;
+		};
+		NATIVE_STUB(OP_GET_LOCAL_LONG)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(frame->slots[READ_U16()]);
+			return false;
+		};
+		NATIVE_STUB(OP_SET_UPVALUE)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto upvalue = frame->closure->upvalues[READ_INS()];
+			*upvalue->location = PEEK(0);
+			WRITE_BARRIER(upvalue);
+			return false;
+		};
+		NATIVE_STUB(OP_GET_UPVALUE)
+		{
+			LOAD_NATIVE_CONTEXT();
+			PUSH(*frame->closure->upvalues[READ_INS()]->location);
+			return false;
+		};
+		NATIVE_STUB(OP_CLOSE_UPVALUE)
+		{
+			LOAD_NATIVE_CONTEXT();
+			CLOSED_UPVALUES(stackTop - 1);
+			DROP();
+			return false;
+		};
+		NATIVE_STUB(OP_POP)
+		{
+			LOAD_NATIVE_CONTEXT();
+			DROP();
+			return false;
+		};
+		NATIVE_STUB(OP_ADD)
+		{
+			LOAD_NATIVE_CONTEXT();
+			Value left = PEEK(0);
+			Value right = PEEK(1);
+			Value result;
+			ADD_VALUE(left, right, result);
+			stackTop -= 2;
+			PUSH(result);
+			return false;
+		};
+		NATIVE_STUB(OP_SUB)
+		{
+			LOAD_NATIVE_CONTEXT();
+			COMMON_BINARY(-);
+			return false;
+		};
+		NATIVE_STUB(OP_MUL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			COMMON_BINARY(*);
+			return false;
+		};
+		NATIVE_STUB(OP_DIV)
+		{
+			LOAD_NATIVE_CONTEXT();
+			COMMON_BINARY(/);
+			return false;
+		};
+		NATIVE_STUB(OP_MOD)
+		{
+			LOAD_NATIVE_CONTEXT();
+			INTEGER_BINARY(%);
+			return false;
+		};
+		NATIVE_STUB(OP_BIT_AND)
+		{
+			LOAD_NATIVE_CONTEXT();
+			INTEGER_BINARY(&);
+			return false;
+		};
+		NATIVE_STUB(OP_BIT_OR)
+		{
+			LOAD_NATIVE_CONTEXT();
+			INTEGER_BINARY(|);
+			return false;
+		};
+		NATIVE_STUB(OP_BIT_LEFT_SHIFT)
+		{
+			LOAD_NATIVE_CONTEXT();
+			INTEGER_BINARY(<<);
+			return false;
+		};
+		NATIVE_STUB(OP_BIT_RIGHT_SHIFT)
+		{
+			LOAD_NATIVE_CONTEXT();
+			INTEGER_BINARY(>>);
+			return false;
+		};
+		NATIVE_STUB(OP_LESS)
+		{
+			LOAD_NATIVE_CONTEXT();
+			COMPARE_BINARY(<);
+			return false;
+		};
+		NATIVE_STUB(OP_GREATER)
+		{
+			LOAD_NATIVE_CONTEXT();
+			COMPARE_BINARY(>);
+			return false;
+		};
+		NATIVE_STUB(OP_EQUAL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			Value left = POP();
+			Value right = POP();
+			if (CYS_IS_REF_VALUE(left))
+				left = *CYS_TO_REF_VALUE(left)->pointer;
+			if (CYS_IS_REF_VALUE(right))
+				right = *CYS_TO_REF_VALUE(right)->pointer;
+			PUSH(left == right);
+			return false;
+		};
+		NATIVE_STUB(OP_NOT)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto value = POP();
+			if (CYS_IS_REF_VALUE(value))
+				value = *CYS_TO_REF_VALUE(value)->pointer;
+			if (!CYS_IS_BOOL_VALUE(value))
+				CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:!{}, only bool type is available."), value.ToString());
+			PUSH(!CYS_TO_BOOL_VALUE(value));
+			return false;
+		};
+		NATIVE_STUB(OP_MINUS)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto value = POP();
+			if (CYS_IS_REF_VALUE(value))
+				value = *CYS_TO_REF_VALUE(value)->pointer;
+			if (CYS_IS_INT_VALUE(value))
+				PUSH(-CYS_TO_INT_VALUE(value));
+			else if (CYS_IS_REAL_VALUE(value))
+				PUSH(-CYS_TO_REAL_VALUE(value));
+			else
+				CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:-{}, only -(int||real expr) is available."), value.ToString());
+			return false;
+		};
+		NATIVE_STUB(OP_ADD_I64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, +);
+			return false;
+		};
+		NATIVE_STUB(OP_SUB_I64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, -);
+			return false;
+		};
+		NATIVE_STUB(OP_MUL_I64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, *);
+			return false;
+		};
+		NATIVE_STUB(OP_DIV_I64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, /);
+			return false;
+		};
+		NATIVE_STUB(OP_LESS_I64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, <);
+			return false;
+		};
+		NATIVE_STUB(OP_GREATER_I64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_INT_VALUE, CYS_TO_INT_VALUE, >);
+			return false;
+		};
+		NATIVE_STUB(OP_ADD_F64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, +);
+			return false;
+		};
+		NATIVE_STUB(OP_SUB_F64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, -);
+			return false;
+		};
+		NATIVE_STUB(OP_MUL_F64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, *);
+			return false;
+		};
+		NATIVE_STUB(OP_DIV_F64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, /);
+			return false;
+		};
+		NATIVE_STUB(OP_LESS_F64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, <);
+			return false;
+		};
+		NATIVE_STUB(OP_GREATER_F64)
+		{
+			LOAD_NATIVE_CONTEXT();
+			TYPED_BINARY(CYS_IS_REAL_VALUE, CYS_TO_REAL_VALUE, >);
+			return false;
+		};
+		NATIVE_STUB(OP_GET_INDEX)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto idxValue = POP();
+			auto dsValue = POP();
+			if (CYS_IS_ARRAY_VALUE(dsValue))
+			{
+				auto array = CYS_TO_ARRAY_VALUE(dsValue);
+				CHECK_IDX_VALID(idxValue);
+				auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), array->elements.size());
+				CHECK_IDX_RANGE(array->elements, intIdx);
+				PUSH(array->elements[intIdx]);
+			}
+			else if (CYS_IS_STR_VALUE(dsValue))
+			{
+				auto strObj = CYS_TO_STR_VALUE(dsValue);
+				CHECK_IDX_VALID(idxValue)
+				auto intIdx = NormalizeIdx(CYS_TO_INT_VALUE(idxValue), strObj->value.size());
+				CHECK_IDX_RANGE(strObj->value, intIdx);
+				auto subStr = CREATE_OBJECT(StrObject, strObj->value.substr(intIdx, 1));
+				PUSH(subStr);
+			}
+			else if (CYS_IS_DICT_VALUE(dsValue))
+			{
+				auto dict = CYS_TO_DICT_VALUE(dsValue);
+				auto iter = dict->elements.find(idxValue);
+				if (iter != dict->elements.end())
+					PUSH(iter->second);
+				else
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("No key in dict"));
+			}
+			return false;
+		};
+		NATIVE_STUB(OP_JUMP_IF_FALSE)
+		{
+			LOAD_NATIVE_CONTEXT();
+			return IsFalsey(PEEK(0));
+		};
+		stubs[OP_JUMP_IF_FALSE_LONG] = stubs[OP_JUMP_IF_FALSE];
+		NATIVE_STUB(OP_JUMP_IF_FALSE_POP)
+		{
+			LOAD_NATIVE_CONTEXT();
+			return IsFalsey(POP());
+		};
+		NATIVE_STUB(OP_JUMP_IF_TRUE_POP)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto value = POP();
+			if (CYS_IS_REF_VALUE(value))
+				value = *CYS_TO_REF_VALUE(value)->pointer;
+			if (!CYS_IS_BOOL_VALUE(value))
+				CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:!{}, only bool type is available."), value.ToString());
+			return CYS_TO_BOOL_VALUE(value);
+		};
+		NATIVE_STUB(OP_INC_LOCAL)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto slot = frame->slots + READ_INS();
+			Value left = constants[READ_INS()];
+			Value right = *slot;
+			Value result;
+			ADD_VALUE(left, right, result);
+			if (CYS_IS_REF_VALUE((*slot)))
+				STORE_TO_REF((*slot), result);
+			else
+				*slot = result;
+			return false;
+		};
+		NATIVE_STUB(OP_LESS_LOCAL_CONST_JUMP)
+		{
+			LOAD_NATIVE_CONTEXT();
+			Value left = frame->slots[READ_INS()];
+			Value right = constants[READ_INS()];
+			bool result;
+			COMPARE_VALUE(left, <, right, result);
+			return !result;
+		};
+		NATIVE_STUB(OP_FOR_RANGE_INT)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto state = frame->slots + READ_INS();
+			if (!CYS_IS_INT_VALUE(state[0]) || !CYS_IS_INT_VALUE(state[1]))
+				CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("range's bounds must be integers:{},{}."), state[0].ToString(), state[1].ToString());
+
+			auto counter = CYS_TO_INT_VALUE(state[0]);
+			if (counter >= CYS_TO_INT_VALUE(state[1]))
+				return true;
+			state[2] = Value(counter);
+			state[0] = Value(counter + 1);
+			return false;
+		};
+		NATIVE_STUB(OP_FOR_EACH_ARRAY)
+		{
+			LOAD_NATIVE_CONTEXT();
+			auto state = frame->slots + READ_INS();
+			auto iterable = state[0];
+			if (CYS_IS_REF_VALUE(iterable))
+				iterable = *CYS_TO_REF_VALUE(iterable)->pointer;
+			if (!CYS_IS_ARRAY_VALUE(iterable))
+				CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Only array is iterable in for-in stmt:{}."), iterable.ToString());
+
+			const auto &elements = CYS_TO_ARRAY_VALUE(iterable)->elements;
+			auto index = CYS_TO_INT_VALUE(state[1]);
+			if (index >= static_cast<int64_t>(elements.size()))
+				return true;
+			state[2] = elements[index];
+			state[1] = Value(index + 1);
+			return false;
+		};
+
+		// the compiled code never quickens,a quick opcode met at compile time runs its generic stub
+		stubs[OP_ADD_INT_QUICK] = stubs[OP_ADD_REAL_QUICK] = stubs[OP_ADD];
+		stubs[OP_SUB_INT_QUICK] = stubs[OP_SUB_REAL_QUICK] = stubs[OP_SUB];
+		stubs[OP_MUL_INT_QUICK] = stubs[OP_MUL_REAL_QUICK] = stubs[OP_MUL];
+		stubs[OP_LESS_INT_QUICK] = stubs[OP_LESS_REAL_QUICK] = stubs[OP_LESS];
+		stubs[OP_GREATER_INT_QUICK] = stubs[OP_GREATER_REAL_QUICK] = stubs[OP_GREATER];
+		stubs[OP_EQUAL_INT_QUICK] = stubs[OP_EQUAL_REAL_QUICK] = stubs[OP_EQUAL];
+
+		sIsStubTableInitialized = true;
+		return stubs;
+	}
+
+// the register vm keeps no operand stack,an instruction names its slots and constants directly
+#undef RELATED_TOKEN
+#define RELATED_TOKEN() (frame->closure->function->chunk.GetRelatedToken(pc->offset))
+#define REGISTER_OPERAND(x) ((x) & REGISTER_CONSTANT_BIT ? constants[(x) & ~REGISTER_CONSTANT_BIT] : slots[(x)])
+#define REGISTER_JUMP_IF(condition)                  \
+	if (condition)                                   \
+	{                                                \
+		pc = code->instructions.data() + pc->target; \
+		continue;                                    \
+	}
+#define REGISTER_BINARY(valueMacro, op)        \
+	{                                          \
+		Value left = REGISTER_OPERAND(pc->b);  \
+		Value right = REGISTER_OPERAND(pc->c); \
+		Value result;                          \
+		valueMacro(left, op, right, result);   \
+		slots[pc->a] = result;                 \
+		break;                                 \
+	}
+#define REGISTER_COMPARE_JUMP(op, isJumpIfTrue)   \
+	{                                             \
+		Value left = REGISTER_OPERAND(pc->b);     \
+		Value right = REGISTER_OPERAND(pc->c);    \
+		bool result;                              \
+		COMPARE_VALUE(left, op, right, result);   \
+		REGISTER_JUMP_IF(result == isJumpIfTrue); \
+		break;                                    \
+	}
+
+	uint32_t VM::ExecuteRegister(NativeContext *context, const RegisterCode *code, int32_t startPc) noexcept
+	{
+		auto frame = context->frame;
+		auto slots = frame->slots;
+		auto constants = context->constants;
+		auto globals = context->globals;
+
+		// the gc sees every slot the register code may write,the ones above the entry depth hold whatever an earlier frame left
+		auto stackTop = slots + code->maxDepth;
+		for (auto slot = context->stackTop; slot < stackTop; ++slot)
+			*slot = Value();
+
+		auto pc = code->instructions.data() + startPc;
+		while (1)
+		{
+			switch (pc->opCode)
+			{
+			case ROP_MOVE:
+				slots[pc->a] = REGISTER_OPERAND(pc->b);
+				break;
+			case ROP_LOAD_NULL:
+				slots[pc->a] = Value();
+				break;
+			case ROP_STORE_LOCAL:
+			{
+				auto value = REGISTER_OPERAND(pc->b);
+				auto slot = slots + pc->a;
+				if (CYS_IS_REF_VALUE((*slot)))
+					STORE_TO_REF((*slot), value);
+				else
+					*slot = value;
+				break;
+			}
+			case ROP_GET_GLOBAL:
+				slots[pc->a] = globals[pc->b];
+				break;
+			case ROP_SET_GLOBAL:
+			{
+				auto value = REGISTER_OPERAND(pc->b);
+				auto globalValue = globals + pc->a;
+				if (CYS_IS_REF_VALUE(*globalValue))
+					STORE_TO_REF(*globalValue, value);
+				else
+					*globalValue = value;
+				break;
+			}
+			case ROP_GET_UPVALUE:
+				slots[pc->a] = *frame->closure->upvalues[pc->b]->location;
+				break;
+			case ROP_SET_UPVALUE:
+			{
+				auto upvalue = frame->closure->upvalues[pc->a];
+				*upvalue->location = REGISTER_OPERAND(pc->b);
+				WRITE_BARRIER(upvalue);
+				break;
+			}
+			case ROP_ADD:
+			{
+				// same operand order as OP_ADD,which adds the top of the stack to the value below it
+				Value left = REGISTER_OPERAND(pc->c);
+				Value right = REGISTER_OPERAND(pc->b);
+				Value result;
+				ADD_VALUE(left, right, result);
+				slots[pc->a] = result;
+				break;
+			}
+			case ROP_SUB:
+				REGISTER_BINARY(COMMON_VALUE, -);
+			case ROP_MUL:
+				REGISTER_BINARY(COMMON_VALUE, *);
+			case ROP_DIV:
+				REGISTER_BINARY(COMMON_VALUE, /);
+			case ROP_MOD:
+				REGISTER_BINARY(INTEGER_VALUE, %);
+			case ROP_BIT_AND:
+				REGISTER_BINARY(INTEGER_VALUE, &);
+			case ROP_BIT_OR:
+				REGISTER_BINARY(INTEGER_VALUE, |);
+			case ROP_BIT_LEFT_SHIFT:
+				REGISTER_BINARY(INTEGER_VALUE, <<);
+			case ROP_BIT_RIGHT_SHIFT:
+				REGISTER_BINARY(INTEGER_VALUE, >>);
+			case ROP_LESS:
+			{
+				Value left = REGISTER_OPERAND(pc->b);
+				Value right = REGISTER_OPERAND(pc->c);
+				bool result;
+				COMPARE_VALUE(left, <, right, result);
+				slots[pc->a] = result;
+				break;
+			}
+			case ROP_GREATER:
+			{
+				Value left = REGISTER_OPERAND(pc->b);
+				Value right = REGISTER_OPERAND(pc->c);
+				bool result;
+				COMPARE_VALUE(left, >, right, result);
+				slots[pc->a] = result;
+				break;
+			}
+			case ROP_EQUAL:
+			{
+				Value left = REGISTER_OPERAND(pc->c);
+				Value right = REGISTER_OPERAND(pc->b);
+				if (CYS_IS_REF_VALUE(left))
+					left = *CYS_TO_REF_VALUE(left)->pointer;
+				if (CYS_IS_REF_VALUE(right))
+					right = *CYS_TO_REF_VALUE(right)->pointer;
+				slots[pc->a] = left == right;
+				break;
+			}
+			case ROP_NOT:
+			{
+				auto value = REGISTER_OPERAND(pc->b);
+				if (CYS_IS_REF_VALUE(value))
+					value = *CYS_TO_REF_VALUE(value)->pointer;
+				if (!CYS_IS_BOOL_VALUE(value))
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:!{}, only bool type is available."), value.ToString());
+				slots[pc->a] = !CYS_TO_BOOL_VALUE(value);
+				break;
+			}
+			case ROP_MINUS:
+			{
+				auto value = REGISTER_OPERAND(pc->b);
+				if (CYS_IS_REF_VALUE(value))
+					value = *CYS_TO_REF_VALUE(value)->pointer;
+				if (CYS_IS_INT_VALUE(value))
+					slots[pc->a] = -CYS_TO_INT_VALUE(value);
+				else if (CYS_IS_REAL_VALUE(value))
+					slots[pc->a] = -CYS_TO_REAL_VALUE(value);
+				else
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:-{}, only -(int||real expr) is available."), value.ToString());
+				break;
+			}
+			case ROP_INC_LOCAL:
+			{
+				auto slot = slots + pc->a;
+				Value left = REGISTER_OPERAND(pc->b);
+				Value right = *slot;
+				Value result;
+				ADD_VALUE(left, right, result);
+				if (CYS_IS_REF_VALUE((*slot)))
+					STORE_TO_REF((*slot), result);
+				else
+					*slot = result;
+				break;
+			}
+			case ROP_JUMP:
+				pc = code->instructions.data() + pc->target;
+				continue;
+			case ROP_JUMP_IF_FALSE:
+				REGISTER_JUMP_IF(IsFalsey(REGISTER_OPERAND(pc->b)));
+				break;
+			case ROP_JUMP_IF_TRUE:
+			{
+				auto value = REGISTER_OPERAND(pc->b);
+				if (CYS_IS_REF_VALUE(value))
+					value = *CYS_TO_REF_VALUE(value)->pointer;
+				if (!CYS_IS_BOOL_VALUE(value))
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("Invalid op:!{}, only bool type is available."), value.ToString());
+				REGISTER_JUMP_IF(CYS_TO_BOOL_VALUE(value));
+				break;
+			}
+			case ROP_JUMP_IF_LESS:
+				REGISTER_COMPARE_JUMP(<, true);
+			case ROP_JUMP_IF_NOT_LESS:
+				REGISTER_COMPARE_JUMP(<, false);
+			case ROP_JUMP_IF_GREATER:
+				REGISTER_COMPARE_JUMP(>, true);
+			case ROP_JUMP_IF_NOT_GREATER:
+				REGISTER_COMPARE_JUMP(>, false);
+			case ROP_JUMP_IF_EQUAL:
+			case ROP_JUMP_IF_NOT_EQUAL:
+			{
+				Value left = REGISTER_OPERAND(pc->c);
+				Value right = REGISTER_OPERAND(pc->b);
+				if (CYS_IS_REF_VALUE(left))
+					left = *CYS_TO_REF_VALUE(left)->pointer;
+				if (CYS_IS_REF_VALUE(right))
+					right = *CYS_TO_REF_VALUE(right)->pointer;
+				REGISTER_JUMP_IF((left == right) == (pc->opCode == ROP_JUMP_IF_EQUAL));
+				break;
+			}
+			case ROP_FOR_RANGE_INT:
+			{
+				// counter,end,loop variable
+				auto state = slots + pc->a;
+				if (!CYS_IS_INT_VALUE(state[0]) || !CYS_IS_INT_VALUE(state[1]))
+					CYS_LOG_ERROR_WITH_LOC(RELATED_TOKEN(), TEXT("range's bounds must be integers:{},{}."), state[0].ToString(), state[1].ToString());
+
+				auto counter = CYS_TO_INT_VALUE(state[0]);
+				REGISTER_JUMP_IF(counter >= CYS_TO_INT_VALUE(state[1]));
+				state[2] = Value(counter);
+				state[0] = Value(counter + 1);
+				break;
+			}
+			case ROP_EXIT:
+			default:
+				context->stackTop = slots + pc->a;
+				return pc->offset;
+			}
+			++pc;
+		}
+	}
+}
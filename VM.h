@@ -3,20 +3,88 @@
 #include <vector>
 #include "Chunk.h"
 #include "Object.h"
+#include "Allocator.h"
 #include "LibraryManager.h"
+#include "OpCodeProfiler.h"
 namespace CynicScript
 {
+    // the interpreter state handed to compiled code(jit or aot),so either side can continue where the other stopped
+    struct NativeContext
+    {
+        CallFrame *frame{nullptr};
+        Value *stackTop{nullptr};
+        Value *constants{nullptr};
+        Value *globals{nullptr};
+    };
+
+    struct RegisterCode;
+
+    // runs one opcode,ip points past the opcode byte at its operands.
+    // conditional jump stubs return whether the jump is taken,other stubs return false
+    using NativeStub = bool (*)(NativeContext *context, uint8_t *ip);
+
     class CYS_API VM
     {
     public:
+#ifdef CYS_OPCODE_PROFILE
+        VM() noexcept = default;
+        ~VM() noexcept; // writes the opcode profile
+#else
         constexpr VM() noexcept = default;
         constexpr ~VM() noexcept = default;
+#endif
+
+        enum class Status : uint8_t
+        {
+            FINISHED,
+            SUSPENDED, // the fuel budget ran out,Resume() continues where the script stopped
+        };
 
+        // the return values of the main function,empty if the script is suspended
         std::vector<Value> Run(FunctionObject *mainFunc) noexcept;
+        std::vector<Value> Resume() noexcept;
+        Status GetStatus() const noexcept;
+
+        // fuel every Run() and Resume() gets,one unit burns at each loop back edge and each call,0 means no limit.
+        // a suspended script's stacks are parked in the vm,so every vm can hold one suspended script while others run.
+        // Run() refuses to start while the script of this vm is suspended.
+        // while a budget is set,functions always run on the stack vm:compiled code(aot,jit,register) does not burn fuel
+        void SetFuelBudget(uint64_t fuel) noexcept;
+        uint64_t GetFuelBudget() const noexcept;
+
+        // indexed by opcode,nullptr for opcodes compiled code must leave to the interpreter(calls,returns,classes...)
+        static const NativeStub *GetNativeStubs() noexcept;
 
     private:
         void Execute();
+        std::vector<Value> PopReturnValues() noexcept;
+
+        static bool IsFalsey(const Value &v) noexcept;
+
+        // fills function->decodedInstructions,the chunk has to be verified
+        static void Predecode(FunctionObject *function) noexcept;
+
+        // rewrite the decoded opcode and its byte,so compiled code and the quicken stats see the quick form too
+        static void Quicken(FunctionObject *function, DecodedInstruction *instruction, uint8_t quickOpCode) noexcept;
+        static void Dequicken(FunctionObject *function, DecodedInstruction *instruction, uint8_t genericOpCode) noexcept;
+
+        static FunctionObject::PropertyCache &GetPropertyCache(FunctionObject *function, const DecodedInstruction *instruction) noexcept;
+        static void UpdatePropertyCache(FunctionObject::PropertyCache &cache, ClassInstanceObject *instance, const STRING &name, bool isWrite) noexcept;
+
+        // runs the compiled code of the frame's function from start,with CYS_JIT a hot function is compiled first.
+        // returns false if the function has no compiled code,otherwise pc and stackTop are where the compiled code stopped
+        static bool RunNative(CallFrame *frame, const DecodedInstruction *start, DecodedInstruction *&pc, Value *&stackTop, Value *constants, Value *globals) noexcept;
+
+        // the register vm,runs the frame's register code from pc and returns the offset of the opcode the stack vm continues with
+        static uint32_t ExecuteRegister(NativeContext *context, const RegisterCode *code, int32_t pc) noexcept;
+
+        uint64_t mFuelBudget{0};
+        uint64_t mFuel{0};
+        Status mStatus{Status::FINISHED};
+        ExecutionContext mContext; // the stacks of the suspended script
 
-        bool IsFalsey(const Value &v) noexcept;
+#ifdef CYS_OPCODE_PROFILE
+        OpCodeProfiler mOpCodeProfiler;
+#endif
     };
 }
\ No newline at end of file
@@ -1,7 +1,34 @@
 #include "Value.h"
 #include "Object.h"
+#include "Allocator.h"
 namespace CynicScript
 {
+#ifdef CYS_NAN_BOXING
+    uint64_t Value::BoxInteger(int64_t integer) noexcept
+    {
+        // never collect here,the vm may not have synced its stack top when an arithmetic result overflows
+        auto object = Allocator::GetInstance()->CreateObjectWithoutGC<BoxedIntObject>(integer);
+        return NanBox::SIGN_BIT | NanBox::QNAN | NanBox::INT_TAG | reinterpret_cast<uint64_t>(object);
+    }
+
+    int64_t Value::UnboxInteger() const noexcept
+    {
+        return CYS_TO_BOXED_INT_OBJ(bits & NanBox::PAYLOAD_MASK)->value;
+    }
+
+    ValueKind Value::GetKind() const noexcept
+    {
+        if (IsReal())
+            return ValueKind::REAL;
+        if (IsInteger())
+            return ValueKind::INT;
+        if (IsObject())
+            return ValueKind::OBJECT;
+        if (IsBool())
+            return ValueKind::BOOL;
+        return ValueKind::NIL;
+    }
+#else
     Value::Value() noexcept
         : kind(ValueKind::NIL), object(nullptr)
     {
@@ -24,21 +51,22 @@ namespace CynicScript
         : object(object), kind(ValueKind::OBJECT)
     {
     }
+#endif
 
     STRING Value::ToString() const
     {
-        switch (kind)
+        switch (CYS_GET_VALUE_KIND(*this))
         {
         case ValueKind::INT:
-            return CYS_TO_STRING(integer);
+            return CYS_TO_STRING(CYS_TO_INT_VALUE(*this));
         case ValueKind::REAL:
-            return CYS_TO_STRING(realnum);
+            return CYS_TO_STRING(CYS_TO_REAL_VALUE(*this));
         case ValueKind::BOOL:
-            return boolean ? TEXT("true") : TEXT("false");
+            return CYS_TO_BOOL_VALUE(*this) ? TEXT("true") : TEXT("false");
         case ValueKind::NIL:
             return TEXT("null");
         case ValueKind::OBJECT:
-            return object->ToString();
+            return CYS_TO_OBJECT_VALUE(*this)->ToString();
         default:
             return TEXT("null");
         }
@@ -46,25 +74,46 @@ namespace CynicScript
     }
     void Value::Mark() const
     {
+#ifdef CYS_NAN_BOXING
+        if ((bits & (NanBox::SIGN_BIT | NanBox::QNAN)) == (NanBox::SIGN_BIT | NanBox::QNAN)) // objects and boxed ints
+            reinterpret_cast<Object *>(bits & NanBox::PAYLOAD_MASK)->Mark();
+#else
         if (kind == ValueKind::OBJECT)
             object->Mark();
+#endif
     }
     void Value::UnMark() const
     {
+#ifdef CYS_NAN_BOXING
+        if ((bits & (NanBox::SIGN_BIT | NanBox::QNAN)) == (NanBox::SIGN_BIT | NanBox::QNAN))
+            reinterpret_cast<Object *>(bits & NanBox::PAYLOAD_MASK)->UnMark();
+#else
         if (kind == ValueKind::OBJECT)
             object->UnMark();
+#endif
     }
 
     std::vector<uint8_t> Value::Serialize() const
     {
         std::vector<uint8_t> result;
 
-        result.emplace_back(kind);
-        result.emplace_back(static_cast<uint8_t>(std::underlying_type<Permission>::type(permission)));
+        result.emplace_back(CYS_GET_VALUE_KIND(*this));
+        result.emplace_back(0); // reserved,values no longer carry a permission
+
+        int64_t payload = 0;
+        if (CYS_IS_INT_VALUE(*this))
+            payload = CYS_TO_INT_VALUE(*this);
+        else if (CYS_IS_REAL_VALUE(*this))
+        {
+            auto realnum = CYS_TO_REAL_VALUE(*this);
+            std::memcpy(&payload, &realnum, sizeof(double));
+        }
+        else if (CYS_IS_BOOL_VALUE(*this))
+            payload = CYS_TO_BOOL_VALUE(*this) ? 1 : 0;
 
         if (CYS_IS_INT_VALUE(*this) || CYS_IS_REAL_VALUE(*this) || CYS_IS_BOOL_VALUE(*this))
         {
-            auto byteList = ByteConverter::ToU64ByteList(integer);
+            auto byteList = ByteConverter::ToU64ByteList(payload);
             result.insert(result.end(), byteList.begin(), byteList.end());
         }
 
@@ -75,18 +124,38 @@ namespace CynicScript
 
     void Value::Deserialize(const std::vector<uint8_t> &data)
     {
-        kind = (ValueKind)data[0];
-        permission = (Permission)data[1];
+        auto kind = (ValueKind)data[0];
 
-        if (CYS_IS_INT_VALUE(*this) || CYS_IS_REAL_VALUE(*this) || CYS_IS_BOOL_VALUE(*this))
-            integer = ByteConverter::GetU64Integer(data, 2);
+        int64_t payload = 0;
+        if (kind == ValueKind::INT || kind == ValueKind::REAL || kind == ValueKind::BOOL)
+            payload = ByteConverter::GetU64Integer(data, 2);
+
+        switch (kind)
+        {
+        case ValueKind::INT:
+            *this = Value(payload);
+            break;
+        case ValueKind::REAL:
+        {
+            double realnum;
+            std::memcpy(&realnum, &payload, sizeof(double));
+            *this = Value(realnum);
+            break;
+        }
+        case ValueKind::BOOL:
+            *this = Value(payload != 0);
+            break;
+        default:
+            *this = Value();
+            break;
+        }
 
         // TODO: Not finished yet, need to handle object deserialization
     }
 
     bool operator==(const Value &left, const Value &right)
     {
-        switch (left.kind)
+        switch (CYS_GET_VALUE_KIND(left))
         {
         case ValueKind::INT:
         {
@@ -135,20 +204,21 @@ namespace CynicScript
 
     size_t ValueHash::operator()(const Value *v) const
     {
-        switch (v->kind)
+        auto kind = CYS_GET_VALUE_KIND(*v);
+        switch (kind)
         {
         case ValueKind::NIL:
-            return std::hash<ValueKind>()(v->kind);
+            return std::hash<ValueKind>()(kind);
         case ValueKind::INT:
-            return std::hash<ValueKind>()(v->kind) ^ std::hash<int64_t>()(v->integer);
+            return std::hash<ValueKind>()(kind) ^ std::hash<int64_t>()(CYS_TO_INT_VALUE(*v));
         case ValueKind::REAL:
-            return std::hash<ValueKind>()(v->kind) ^ std::hash<double>()(v->realnum);
+            return std::hash<ValueKind>()(kind) ^ std::hash<double>()(CYS_TO_REAL_VALUE(*v));
         case ValueKind::BOOL:
-            return std::hash<ValueKind>()(v->kind) ^ std::hash<bool>()(v->boolean);
+            return std::hash<ValueKind>()(kind) ^ std::hash<bool>()(CYS_TO_BOOL_VALUE(*v));
         case ValueKind::OBJECT:
-            return std::hash<ValueKind>()(v->kind) ^ std::hash<Object *>()(v->object);
+            return std::hash<ValueKind>()(kind) ^ std::hash<Object *>()(CYS_TO_OBJECT_VALUE(*v));
         default:
-            return std::hash<ValueKind>()(v->kind);
+            return std::hash<ValueKind>()(kind);
         }
     }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <cstring>
 #include <unordered_map>
 #include "Common.h"
 namespace CynicScript
@@ -13,6 +14,99 @@ namespace CynicScript
 		OBJECT,
 	};
 
+#ifdef CYS_NAN_BOXING
+	// every value is packed into 8 bytes:
+	//   real       any double,nan is canonicalized so it never collides with the tagged forms below
+	//   nil,bool   QNAN | 1,2,3
+	//   int        QNAN | INT_TAG | 48 bit two's complement payload
+	//   object     SIGN_BIT | QNAN | 48 bit pointer
+	//   boxed int  SIGN_BIT | QNAN | INT_TAG | pointer to a BoxedIntObject,for integers outside the 48 bit range
+	namespace NanBox
+	{
+		constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+		constexpr uint64_t QNAN = 0x7ffc000000000000;
+		constexpr uint64_t TAG_MASK = 0x0003000000000000;
+		constexpr uint64_t INT_TAG = 0x0001000000000000;
+		constexpr uint64_t PAYLOAD_MASK = 0x0000ffffffffffff;
+		constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+
+		constexpr uint64_t NIL_BITS = QNAN | 1;
+		constexpr uint64_t FALSE_BITS = QNAN | 2;
+		constexpr uint64_t TRUE_BITS = QNAN | 3;
+
+		constexpr int64_t MIN_INLINE_INT = -(int64_t(1) << 47);
+		constexpr int64_t MAX_INLINE_INT = (int64_t(1) << 47) - 1;
+	}
+
+	struct CYS_API Value
+	{
+		Value() noexcept
+			: bits(NanBox::NIL_BITS)
+		{
+		}
+		Value(int64_t integer) noexcept
+		{
+			if (integer >= NanBox::MIN_INLINE_INT && integer <= NanBox::MAX_INLINE_INT)
+				bits = NanBox::QNAN | NanBox::INT_TAG | (static_cast<uint64_t>(integer) & NanBox::PAYLOAD_MASK);
+			else
+				bits = BoxInteger(integer);
+		}
+		Value(double number) noexcept
+		{
+			if (number != number)
+				bits = NanBox::CANONICAL_NAN;
+			else
+				std::memcpy(&bits, &number, sizeof(double));
+		}
+		Value(bool boolean) noexcept
+			: bits(boolean ? NanBox::TRUE_BITS : NanBox::FALSE_BITS)
+		{
+		}
+		Value(struct Object *object) noexcept
+			: bits(NanBox::SIGN_BIT | NanBox::QNAN | reinterpret_cast<uint64_t>(object))
+		{
+		}
+		~Value() noexcept = default;
+
+		STRING ToString() const;
+		void Mark() const;
+		void UnMark() const;
+
+		std::vector<uint8_t> Serialize() const;
+		void Deserialize(const std::vector<uint8_t> &data);
+
+		bool IsNil() const noexcept { return bits == NanBox::NIL_BITS; }
+		bool IsInteger() const noexcept { return (bits & (NanBox::QNAN | NanBox::TAG_MASK)) == (NanBox::QNAN | NanBox::INT_TAG); }
+		bool IsReal() const noexcept { return (bits & NanBox::QNAN) != NanBox::QNAN; }
+		bool IsBool() const noexcept { return (bits | 1) == NanBox::TRUE_BITS; }
+		bool IsObject() const noexcept { return (bits & (NanBox::SIGN_BIT | NanBox::QNAN | NanBox::TAG_MASK)) == (NanBox::SIGN_BIT | NanBox::QNAN); }
+
+		int64_t AsInteger() const noexcept
+		{
+			if (bits & NanBox::SIGN_BIT)
+				return UnboxInteger();
+			return static_cast<int64_t>(bits << 16) >> 16;
+		}
+		double AsReal() const noexcept
+		{
+			double result;
+			std::memcpy(&result, &bits, sizeof(double));
+			return result;
+		}
+		bool AsBool() const noexcept { return bits == NanBox::TRUE_BITS; }
+		struct Object *AsObject() const noexcept { return reinterpret_cast<struct Object *>(bits & NanBox::PAYLOAD_MASK); }
+
+		ValueKind GetKind() const noexcept;
+
+		uint64_t bits;
+
+	private:
+		static uint64_t BoxInteger(int64_t integer) noexcept;
+		int64_t UnboxInteger() const noexcept;
+	};
+
+	static_assert(sizeof(Value) == 8, "nan boxed value must fit in 8 bytes");
+#else
 	struct CYS_API Value
 	{
 		Value() noexcept;
@@ -30,7 +124,6 @@ namespace CynicScript
 		void Deserialize(const std::vector<uint8_t> &data);
 
 		ValueKind kind;
-		Permission permission = Permission::MUTABLE;
 
 		union
 		{
@@ -40,6 +133,7 @@ namespace CynicScript
 			struct Object *object;
 		};
 	};
+#endif
 
 	CYS_API bool operator==(const Value &left, const Value &right);
 	CYS_API bool operator!=(const Value &left, const Value &right);
@@ -54,4 +148,4 @@ namespace CynicScript
 
 	size_t HashValueList(Value *start, size_t count);
 	size_t HashValueList(Value *start, Value *end);
-}
\ No newline at end of file
+}
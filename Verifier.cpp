@@ -0,0 +1,339 @@
+#include "Verifier.h"
+#include <algorithm>
+#include "Allocator.h"
+#include "BytecodeOptimizePass.h"
+#include "Logger.h"
+namespace CynicScript
+{
+	constexpr int32_t UNKNOWN_DEPTH = -1;
+
+#define VERIFY(condition, fmt, ...)                                                                                     \
+	do                                                                                                                  \
+	{                                                                                                                   \
+		if (!(condition))                                                                                               \
+			CYS_LOG_ERROR(TEXT("Invalid bytecode in {} at offset {}:") fmt, function->ToString(), offset, ##__VA_ARGS__); \
+	} while (false)
+
+	static uint16_t ReadU16(const Chunk &chunk, size_t offset)
+	{
+		return static_cast<uint16_t>((chunk.opCodes[offset] << 8) | chunk.opCodes[offset + 1]);
+	}
+
+	void Verifier::Verify(FunctionObject *function)
+	{
+		std::vector<FunctionObject *> worklist{function};
+		while (!worklist.empty())
+		{
+			auto current = worklist.back();
+			worklist.pop_back();
+			if (current->isVerified)
+				continue;
+
+			VerifyFunction(current);
+			current->isVerified = true;
+
+			for (const auto &constant : current->chunk.constants)
+			{
+				if (CYS_IS_FUNCTION_VALUE(constant))
+					worklist.emplace_back(CYS_TO_FUNCTION_VALUE(constant));
+			}
+		}
+	}
+
+	bool Verifier::GetStackEffect(const Chunk &chunk, size_t offset, StackEffect &effect)
+	{
+		auto operand = [&](size_t i)
+		{
+			return static_cast<int32_t>(chunk.opCodes[offset + 1 + i]);
+		};
+
+		switch (chunk.opCodes[offset])
+		{
+		case OP_CONSTANT:
+		case OP_CONSTANT_LONG:
+		case OP_NULL:
+		case OP_GET_GLOBAL:
+		case OP_GET_GLOBAL_LONG:
+		case OP_GET_LOCAL:
+		case OP_GET_LOCAL_LONG:
+		case OP_GET_UPVALUE:
+		case OP_REF_GLOBAL:
+		case OP_REF_LOCAL:
+		case OP_REF_UPVALUE:
+		case OP_CLOSURE:
+		case OP_CLOSURE_LONG:
+			effect = {0, 1};
+			return true;
+		case OP_SET_GLOBAL:
+		case OP_SET_GLOBAL_LONG:
+		case OP_SET_LOCAL:
+		case OP_SET_LOCAL_LONG:
+		case OP_SET_LOCAL_LOAD:
+		case OP_SET_UPVALUE:
+		case OP_NOT:
+		case OP_MINUS:
+		case OP_BIT_NOT:
+		case OP_FACTORIAL:
+		case OP_CLASS_INSTANCE:
+		case OP_REF_INDEX_GLOBAL:
+		case OP_REF_INDEX_LOCAL:
+		case OP_REF_INDEX_UPVALUE:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_FALSE_LONG:
+			effect = {1, 1};
+			return true;
+		case OP_JUMP:
+		case OP_JUMP_LONG:
+		case OP_LOOP:
+		case OP_LOOP_LONG:
+		case OP_INC_LOCAL:
+		case OP_LESS_LOCAL_CONST_JUMP:
+		case OP_FOR_RANGE_INT:
+		case OP_FOR_EACH_ARRAY:
+			effect = {0, 0};
+			return true;
+		case OP_ADD:
+		case OP_SUB:
+		case OP_MUL:
+		case OP_DIV:
+		case OP_MOD:
+		case OP_BIT_AND:
+		case OP_BIT_OR:
+		case OP_BIT_LEFT_SHIFT:
+		case OP_BIT_RIGHT_SHIFT:
+		case OP_LESS:
+		case OP_GREATER:
+		case OP_EQUAL:
+		case OP_ADD_I64:
+		case OP_SUB_I64:
+		case OP_MUL_I64:
+		case OP_DIV_I64:
+		case OP_LESS_I64:
+		case OP_GREATER_I64:
+		case OP_ADD_F64:
+		case OP_SUB_F64:
+		case OP_MUL_F64:
+		case OP_DIV_F64:
+		case OP_LESS_F64:
+		case OP_GREATER_F64:
+		case OP_ADD_INT_QUICK:
+		case OP_ADD_REAL_QUICK:
+		case OP_SUB_INT_QUICK:
+		case OP_SUB_REAL_QUICK:
+		case OP_MUL_INT_QUICK:
+		case OP_MUL_REAL_QUICK:
+		case OP_LESS_INT_QUICK:
+		case OP_LESS_REAL_QUICK:
+		case OP_GREATER_INT_QUICK:
+		case OP_GREATER_REAL_QUICK:
+		case OP_EQUAL_INT_QUICK:
+		case OP_EQUAL_REAL_QUICK:
+		case OP_GET_INDEX:
+		case OP_GET_PROPERTY:
+		case OP_GET_BASE:
+			effect = {2, 1};
+			return true;
+		case OP_SET_GLOBAL_POP:
+		case OP_SET_LOCAL_POP:
+		case OP_JUMP_IF_FALSE_POP:
+		case OP_JUMP_IF_TRUE_POP:
+		case OP_POP:
+		case OP_CLOSE_UPVALUE:
+			effect = {1, 0};
+			return true;
+		case OP_SET_INDEX:
+		case OP_SET_PROPERTY:
+			effect = {3, 1};
+			return true;
+		case OP_ARRAY:
+			effect = {operand(0), 1};
+			return true;
+		case OP_DICT:
+		case OP_STRUCT:
+			effect = {operand(0) * 2, 1};
+			return true;
+		case OP_CALL:
+		case OP_TAIL_CALL:
+			effect = {operand(0) + 1, 1};
+			return true;
+		case OP_RETURN:
+			effect = {operand(0), 0};
+			return true;
+		case OP_CLASS:
+			// name,constructors,then a name value pair for every parent class,variable,constant,function and enum
+			effect = {1 + operand(0) + (operand(1) + operand(2) + operand(3) + operand(4) + operand(5)) * 2, 1};
+			return true;
+		case OP_MODULE:
+			effect = {1 + (operand(0) + operand(1)) * 2, 1};
+			return true;
+		case OP_APPREGATE_RESOLVE:
+			// a count of 0 leaves the value as the result of the assignment
+			effect = {1, std::max(operand(0), 1)};
+			return true;
+		case OP_APPREGATE_RESOLVE_VAR_ARG:
+			effect = {1, operand(0)};
+			return true;
+		case OP_INIT_VAR_ARG:
+			effect = {operand(0) * 2, operand(0) * 2};
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void Verifier::VerifyFunction(FunctionObject *function)
+	{
+		const auto &chunk = function->chunk;
+		const auto size = chunk.opCodes.size();
+		const auto globalCount = Allocator::GetInstance()->GlobalVariableCount();
+
+		size_t offset = 0;
+		VERIFY(size > 0, TEXT("empty chunk."));
+
+		// opcodes have to be known and complete before their operand sizes(and jump targets) can be trusted
+		std::vector<bool> isOpCodeStart(size, false);
+		for (; offset < size; offset += 1 + BytecodeOptimizePass::GetOperandSize(chunk, offset))
+		{
+			auto opCode = chunk.opCodes[offset];
+			if (opCode == OP_CLOSURE || opCode == OP_CLOSURE_LONG)
+			{
+				VERIFY(offset + (opCode == OP_CLOSURE_LONG ? 2 : 1) < size, TEXT("truncated {}."), GetOpCodeName(opCode));
+				size_t index = opCode == OP_CLOSURE_LONG ? ReadU16(chunk, offset + 1) : chunk.opCodes[offset + 1];
+				VERIFY(index < chunk.constants.size() && CYS_IS_FUNCTION_VALUE(chunk.constants[index]), TEXT("closure constant {} is not a function."), index);
+			}
+
+			VERIFY(offset + BytecodeOptimizePass::GetOperandSize(chunk, offset) < size, TEXT("truncated {}."), GetOpCodeName(opCode));
+
+			StackEffect effect;
+			VERIFY(GetStackEffect(chunk, offset, effect), TEXT("{}({}) is not an opcode the vm runs."), GetOpCodeName(opCode), opCode);
+			isOpCodeStart[offset] = true;
+		}
+
+		for (offset = 0; offset < size; offset += 1 + BytecodeOptimizePass::GetOperandSize(chunk, offset))
+		{
+			if (!BytecodeOptimizePass::IsJumpOpCode(chunk.opCodes[offset]))
+				continue;
+			auto target = BytecodeOptimizePass::GetJumpTarget(chunk, offset);
+			VERIFY(target < size && isOpCodeStart[target], TEXT("jump target {} is not an opcode."), target);
+		}
+
+		// stack depth before each opcode,counted from the frame's first slot(the callee)
+		std::vector<int32_t> depths(size, UNKNOWN_DEPTH);
+		std::vector<size_t> worklist;
+		int32_t maxDepth = function->arity + 1;
+		auto propagate = [&](size_t to, int32_t depth)
+		{
+			VERIFY(to < size, TEXT("runs past the end of the chunk."));
+			VERIFY(depths[to] == UNKNOWN_DEPTH || depths[to] == depth, TEXT("reaches offset {} with stack depth {} instead of {}."), to, depth, depths[to]);
+			if (depths[to] == UNKNOWN_DEPTH)
+			{
+				depths[to] = depth;
+				worklist.emplace_back(to);
+			}
+		};
+
+		depths[0] = maxDepth;
+		worklist.emplace_back(0);
+		while (!worklist.empty())
+		{
+			offset = worklist.back();
+			worklist.pop_back();
+
+			auto opCode = chunk.opCodes[offset];
+			auto depth = depths[offset];
+			StackEffect effect;
+			GetStackEffect(chunk, offset, effect);
+			VERIFY(effect.pops <= depth - 1, TEXT("{} pops {} value(s) with {} on the stack."), GetOpCodeName(opCode), effect.pops, depth - 1);
+
+			auto u8 = [&](size_t i)
+			{
+				return static_cast<uint32_t>(chunk.opCodes[offset + 1 + i]);
+			};
+			auto checkConstant = [&](uint32_t index)
+			{
+				VERIFY(index < chunk.constants.size(), TEXT("constant {} out of range."), index);
+			};
+			// a local has to be on the stack already,the slot the opcode itself reads or writes included
+			auto checkLocal = [&](uint32_t slot)
+			{
+				VERIFY(slot < static_cast<uint32_t>(depth), TEXT("local {} out of range."), slot);
+			};
+			auto checkGlobal = [&](uint32_t index)
+			{
+				VERIFY(index < globalCount, TEXT("global {} out of range."), index);
+			};
+			auto checkUpValue = [&](uint32_t index)
+			{
+				VERIFY(index < static_cast<uint32_t>(std::max<int32_t>(function->upValueCount, 0)), TEXT("upvalue {} out of range."), index);
+			};
+
+			switch (opCode)
+			{
+			case OP_CONSTANT:
+				checkConstant(u8(0));
+				break;
+			case OP_CONSTANT_LONG:
+				checkConstant(ReadU16(chunk, offset + 1));
+				break;
+			case OP_GET_GLOBAL:
+			case OP_SET_GLOBAL:
+			case OP_SET_GLOBAL_POP:
+			case OP_REF_GLOBAL:
+			case OP_REF_INDEX_GLOBAL:
+				checkGlobal(u8(0));
+				break;
+			case OP_GET_GLOBAL_LONG:
+			case OP_SET_GLOBAL_LONG:
+				checkGlobal(ReadU16(chunk, offset + 1));
+				break;
+			case OP_GET_LOCAL:
+			case OP_SET_LOCAL:
+			case OP_SET_LOCAL_POP:
+			case OP_SET_LOCAL_LOAD:
+			case OP_REF_LOCAL:
+			case OP_REF_INDEX_LOCAL:
+				checkLocal(u8(0));
+				break;
+			case OP_GET_LOCAL_LONG:
+			case OP_SET_LOCAL_LONG:
+				checkLocal(ReadU16(chunk, offset + 1));
+				break;
+			case OP_INC_LOCAL:
+			case OP_LESS_LOCAL_CONST_JUMP:
+				checkLocal(u8(0));
+				checkConstant(u8(1));
+				break;
+			case OP_FOR_RANGE_INT:
+			case OP_FOR_EACH_ARRAY:
+				checkLocal(u8(0) + 2);
+				break;
+			case OP_GET_UPVALUE:
+			case OP_SET_UPVALUE:
+			case OP_REF_UPVALUE:
+			case OP_REF_INDEX_UPVALUE:
+				checkUpValue(u8(0));
+				break;
+			case OP_APPREGATE_RESOLVE_VAR_ARG:
+				VERIFY(u8(0) >= 1, TEXT("resolves no var arg."));
+				break;
+			case OP_RETURN:
+				VERIFY(u8(0) <= 1, TEXT("returns {} values,at most 1 is supported."), u8(0));
+				break;
+			default:
+				break;
+			}
+
+			auto next = depth - effect.pops + effect.pushes;
+			maxDepth = std::max(maxDepth, next);
+
+			if (opCode == OP_RETURN)
+				continue;
+			if (BytecodeOptimizePass::IsJumpOpCode(opCode))
+				propagate(BytecodeOptimizePass::GetJumpTarget(chunk, offset), next);
+			if (opCode != OP_JUMP && opCode != OP_JUMP_LONG && opCode != OP_LOOP && opCode != OP_LOOP_LONG)
+				propagate(offset + 1 + BytecodeOptimizePass::GetOperandSize(chunk, offset), next);
+		}
+
+		function->maxStackDepth = static_cast<uint32_t>(maxDepth);
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Chunk.h"
+#include "Object.h"
+namespace CynicScript
+{
+    // how many values an opcode takes off the stack and how many it leaves there
+    struct StackEffect
+    {
+        int32_t pops{0};
+        int32_t pushes{0};
+    };
+
+    // checks a function and every function in its constants once before they run:every opcode is known and complete,
+    // jumps land on an opcode,constant,local,global and upvalue indices are in range,every path reaches an opcode with
+    // the same stack depth and no opcode pops below the frame.the deepest stack a frame reaches is kept in maxStackDepth,
+    // so a call checks the stack capacity once for the whole frame and the pushes inside the frame need no checks
+    class CYS_API Verifier
+    {
+    public:
+        static void Verify(FunctionObject *function);
+
+        // false if the byte at offset is not an opcode the vm runs.
+        // a call leaves exactly one value,the compiler never returns more than one
+        static bool GetStackEffect(const Chunk &chunk, size_t offset, StackEffect &effect);
+
+    private:
+        static void VerifyFunction(FunctionObject *function);
+    };
+}